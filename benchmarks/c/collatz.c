@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdint.h>
+
+uint64_t collatz_length(uint64_t x) {
+    uint64_t length = 0;
+    while(x != 1) {
+        if(x % 2 == 0) {
+            x /= 2;
+        } else {
+            x = 3 * x + 1;
+        }
+        length += 1;
+    }
+    return length;
+}
+
+int main() {
+    uint64_t longest = 0;
+    uint64_t longest_start = 0;
+    uint64_t i = 1;
+    while(i < 1000000) {
+        uint64_t length = collatz_length(i);
+        if(length > longest) {
+            longest = length;
+            longest_start = i;
+        }
+        i += 1;
+    }
+    printf("%lu %lu\n", longest_start, longest);
+    return 0;
+}
\ No newline at end of file
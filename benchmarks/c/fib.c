@@ -0,0 +1,12 @@
+#include <stdio.h>
+#include <stdint.h>
+
+uint64_t fib(uint64_t n) {
+    if(n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int main() {
+    printf("%lu\n", fib(32));
+    return 0;
+}
\ No newline at end of file
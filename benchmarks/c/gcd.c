@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stdint.h>
+
+uint64_t gcd(uint64_t a, uint64_t b) {
+    while(b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int main() {
+    uint64_t sum = 0;
+    uint64_t i = 1;
+    while(i < 2000) {
+        uint64_t j = 1;
+        while(j < 2000) {
+            sum += gcd(i, j);
+            j += 1;
+        }
+        i += 1;
+    }
+    printf("%lu\n", sum);
+    return 0;
+}
\ No newline at end of file
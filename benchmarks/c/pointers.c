@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+void swap(uint64_t *a, uint64_t *b) {
+    uint64_t t = *a;
+    *a = *b;
+    *b = t;
+}
+
+void accumulate(uint64_t *total, uint64_t *value) {
+    *total += *value;
+    *value = *value * 3 + 1;
+    *value %= 1000003;
+}
+
+int main() {
+    uint64_t *total = malloc(8);
+    *total = 0;
+    uint64_t x = 1;
+    uint64_t y = 2;
+    uint64_t i = 0;
+    while(i < 20000000) {
+        swap(&x, &y);
+        accumulate(total, &x);
+        i += 1;
+    }
+    printf("%lu %lu %lu\n", *total, x, y);
+    free(total);
+    return 0;
+}
\ No newline at end of file
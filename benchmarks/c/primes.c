@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+bool is_prime(uint64_t n) {
+    if(n < 2) return false;
+    uint64_t d = 2;
+    while(d * d <= n) {
+        if(n % d == 0) return false;
+        d += 1;
+    }
+    return true;
+}
+
+int main() {
+    uint64_t count = 0;
+    uint64_t n = 0;
+    while(n < 1000000) {
+        if(is_prime(n)) count += 1;
+        n += 1;
+    }
+    printf("%lu\n", count);
+    return 0;
+}
\ No newline at end of file
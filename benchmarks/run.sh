@@ -0,0 +1,61 @@
+#!/bin/bash
+# Compiles every benchmark at -O0..-O3, runs it and compares against the C baseline built by clang.
+# RUNNER=lli interprets/JITs the emitted IR, RUNNER=native links it with clang first.
+set -e
+
+CHARON=${CHARON:-build/charon}
+CLANG=${CLANG:-clang}
+LLI=${LLI:-lli}
+RUNNER=${RUNNER:-lli}
+LEVELS=${LEVELS:-0 1 2 3}
+OUT=${OUT:-build/benchmarks}
+DIR=$(dirname "$0")
+
+mkdir -p "$OUT"
+has_clang=$(command -v "$CLANG" > /dev/null && echo 1 || true)
+if [ "$RUNNER" = native ] && [ -z "$has_clang" ]; then echo "native runner requires $CLANG" >&2; exit 1; fi
+if [ -z "$has_clang" ]; then echo "$CLANG not found, skipping C baselines" >&2; fi
+
+now() { date +%s%N; }
+
+# run <label> <command...>: runs the command, checks the output against the first run of this benchmark and prints the elapsed ms
+run() {
+    local label=$1; shift
+    local start=$(now)
+    "$@" > "$OUT/$label.stdout" || { echo "$label: exited with $?" >&2; exit 1; }
+    local elapsed=$(( ($(now) - start) / 1000000 ))
+    if [ -n "$expected" ] && ! cmp -s "$expected" "$OUT/$label.stdout"; then echo "$label: output differs from $expected" >&2; exit 1; fi
+    echo $elapsed
+}
+
+echo "benchmark,level,charon_ms,c_ms,ratio" > "$OUT/results.csv"
+printf "%-12s %-6s %10s %10s %8s\n" benchmark level charon c ratio
+for source in "$DIR"/*.charon; do
+    name=$(basename "$source" .charon)
+    expected=
+    for level in $LEVELS; do
+        "$CHARON" -O$level -o "$OUT/$name.O$level.ll" "$source" > /dev/null
+        if [ "$RUNNER" = native ]; then
+            "$CLANG" -O0 -o "$OUT/$name.O$level" "$OUT/$name.O$level.ll"
+            charon_ms=$(run "$name.O$level" "$OUT/$name.O$level")
+        else
+            charon_ms=$(run "$name.O$level" $LLI "$OUT/$name.O$level.ll")
+        fi
+        expected=${expected:-$OUT/$name.O$level.stdout}
+
+        c_ms=- ratio=-
+        if [ -n "$has_clang" ]; then
+            if [ "$RUNNER" = native ]; then
+                "$CLANG" -O$level -o "$OUT/$name.c.O$level" "$DIR/c/$name.c"
+                c_ms=$(run "$name.c.O$level" "$OUT/$name.c.O$level")
+            else
+                "$CLANG" -O$level -S -emit-llvm -o "$OUT/$name.c.O$level.ll" "$DIR/c/$name.c"
+                c_ms=$(run "$name.c.O$level" $LLI "$OUT/$name.c.O$level.ll")
+            fi
+            ratio=$(awk "BEGIN { printf \"%.2f\", $charon_ms / ($c_ms > 0 ? $c_ms : 1) }")
+        fi
+
+        printf "%-12s -O%-4s %10s %10s %8s\n" "$name" "$level" "$charon_ms" "$c_ms" "$ratio"
+        echo "$name,$level,$charon_ms,$c_ms,$ratio" >> "$OUT/results.csv"
+    done
+done
\ No newline at end of file
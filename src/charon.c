@@ -1,13 +1,28 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <libgen.h>
+#include <getopt.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
 #include "ir/node.h"
+#include "ir/callgraph.h"
 #include "lexer/token.h"
 #include "lexer/tokenizer.h"
 #include "parser/parser.h"
 #include "semantics/semantics.h"
 #include "gen/gen.h"
+#include "vm/vm.h"
+#include "trace.h"
+#include "mem.h"
+#include "repl.h"
+#include "pipeline.h"
+#include "server/server.h"
+#include "server/protocol.h"
 
 [[noreturn]] void exit_perror() {
     perror("ERROR(main): ");
@@ -42,8 +57,11 @@ static void print_node(ir_node_t *node, int depth) {
     switch(node->type) {
         case IR_NODE_TYPE_PROGRAM: printf("(program)"); break;
 
-        case IR_NODE_TYPE_GLOBAL_FUNCTION: printf("(function %s)", node->global_function.decl.name); break;
+        case IR_NODE_TYPE_GLOBAL_FUNCTION: printf("(%sfunction %s)", node->global_function.is_comptime ? "comptime " : "", node->global_function.decl.name); break;
         case IR_NODE_TYPE_GLOBAL_EXTERN: printf("(extern %s)", node->global_extern.decl.name); break;
+        case IR_NODE_TYPE_GLOBAL_IMPORT: printf("(import %s)", node->global_import.name); break;
+        case IR_NODE_TYPE_GLOBAL_VARIABLE: printf("(variable %s)", node->global_variable.name); break;
+        case IR_NODE_TYPE_GLOBAL_STRUCT: printf("(struct %s)", node->global_struct.type->structure.name); break;
 
         case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC: printf("(literal_numeric %lu)", node->expr_literal.numeric_value); break;
         case IR_NODE_TYPE_EXPR_LITERAL_STRING: printf("(literal_string \""); print_string(node->expr_literal.string_value); printf("\")"); break;
@@ -54,6 +72,9 @@ static void print_node(ir_node_t *node, int depth) {
         case IR_NODE_TYPE_EXPR_VAR: printf("(var %s)", node->expr_var.name); break;
         case IR_NODE_TYPE_EXPR_CALL: printf("(call %s)", node->expr_call.name); break;
         case IR_NODE_TYPE_EXPR_CAST: printf("(cast)"); break;
+        case IR_NODE_TYPE_EXPR_COMPTIME: printf("(comptime)"); break;
+        case IR_NODE_TYPE_EXPR_INDEX: printf("(index)"); break;
+        case IR_NODE_TYPE_EXPR_MEMBER: printf("(member %s)", node->expr_member.name); break;
 
         case IR_NODE_TYPE_STMT_BLOCK: printf("(block)"); break;
         case IR_NODE_TYPE_STMT_RETURN: printf("(return)"); break;
@@ -70,6 +91,9 @@ static void print_node(ir_node_t *node, int depth) {
             break;
         case IR_NODE_TYPE_GLOBAL_FUNCTION: print_node(node->global_function.body, depth); break;
         case IR_NODE_TYPE_GLOBAL_EXTERN: break;
+        case IR_NODE_TYPE_GLOBAL_IMPORT: break;
+        case IR_NODE_TYPE_GLOBAL_VARIABLE: if(node->global_variable.initial != NULL) print_node(node->global_variable.initial, depth); break;
+        case IR_NODE_TYPE_GLOBAL_STRUCT: break;
 
         case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC: break;
         case IR_NODE_TYPE_EXPR_LITERAL_STRING: break;
@@ -87,6 +111,12 @@ static void print_node(ir_node_t *node, int depth) {
         case IR_NODE_TYPE_EXPR_CAST:
             print_node(node->expr_cast.value, depth);
             break;
+        case IR_NODE_TYPE_EXPR_COMPTIME: print_node(node->expr_comptime.value, depth); break;
+        case IR_NODE_TYPE_EXPR_INDEX:
+            print_node(node->expr_index.value, depth);
+            print_node(node->expr_index.index, depth);
+            break;
+        case IR_NODE_TYPE_EXPR_MEMBER: print_node(node->expr_member.value, depth); break;
 
         case IR_NODE_TYPE_STMT_BLOCK:
             for(size_t i = 0; i < node->stmt_block.statement_count; i++) print_node(node->stmt_block.statements[i], depth);
@@ -105,35 +135,572 @@ static void print_node(ir_node_t *node, int depth) {
     }
 }
 
-int main(int argc, char **argv) {
-    printf("Charon (dev)\n");
+// Offsets, sizes and the holes padding leaves, to see what packed, align and reorder did
+static void print_layouts(ir_node_t *program) {
+    for(size_t i = 0; i < program->program.global_count; i++) {
+        ir_node_t *node = program->program.globals[i];
+        if(node->type != IR_NODE_TYPE_GLOBAL_STRUCT || !node->global_struct.type->structure.is_complete) continue;
+        ir_type_t *type = node->global_struct.type;
+        // A declaration ahead of the definition shares its type
+        bool is_printed = false;
+        for(size_t j = 0; j < i; j++) if(program->program.globals[j]->type == IR_NODE_TYPE_GLOBAL_STRUCT && program->program.globals[j]->global_struct.type == type) is_printed = true;
+        if(is_printed) continue;
+        printf("struct %s: size %lu, align %lu\n", type->structure.name, type->structure.size, type->structure.align);
+        size_t end = 0, padding = 0;
+        for(size_t j = 0; j < type->structure.field_count; j++) {
+            ir_type_field_t *field = &type->structure.fields[j];
+            if(field->offset > end) printf("  %4lu  (%lu bytes of padding)\n", end, field->offset - end);
+            padding += field->offset - end;
+            printf("  %4lu  %s: ", field->offset, field->name);
+            ir_type_print(field->type);
+            printf(", size %lu, align %lu\n", ir_type_size(field->type), field->align);
+            end = field->offset + ir_type_size(field->type);
+        }
+        if(type->structure.size > end) printf("  %4lu  (%lu bytes of padding)\n", end, type->structure.size - end);
+        padding += type->structure.size - end;
+        printf("  %lu of %lu bytes are padding\n", padding, type->structure.size);
+    }
+}
+
+// Instrumented objects only reference the profile runtime through the driver, which has to be clang's then
+static bool link_executable(const char *linker, const char **objects, size_t object_count, const char *dest_path, bool profile_generate) {
+    trace_begin("link", NULL);
+    const char *args[object_count + 5];
+    size_t count = 0;
+    args[count++] = linker;
+    if(profile_generate) args[count++] = "-fprofile-instr-generate";
+    args[count++] = "-o";
+    args[count++] = dest_path;
+    for(size_t i = 0; i < object_count; i++) args[count++] = objects[i];
+    args[count] = NULL;
 
-    char *source_path = "tests/00.charon";
-    char *source_filename = basename(source_path);
+    pid_t pid = fork();
+    if(pid < 0) exit_perror();
+    if(pid == 0) {
+        execvp(linker, (char **) args);
+        perror("ERROR(main): failed to run the linker");
+        _exit(EXIT_FAILURE);
+    }
+
+    int status;
+    if(waitpid(pid, &status, 0) < 0) exit_perror();
+    trace_end("link", NULL);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Only a dot after the last slash starts an extension, `../lib` has none
+static char *replace_extension(const char *name, const char *extension) {
+    const char *dot = strrchr(name, '.');
+    if(dot != NULL && strchr(dot, '/') != NULL) dot = NULL;
+    size_t stem_length = dot != NULL ? (size_t) (dot - name) : strlen(name);
+    char *path = malloc(stem_length + strlen(extension) + 1);
+    memcpy(path, name, stem_length);
+    strcpy(path + stem_length, extension);
+    return path;
+}
 
-    FILE *file = fopen(source_path, "r");
+typedef struct {
+    const char *path;
+    char *dest_path;
+    char *cache_path; // OPTIONAL, where the object is moved once it is complete
+    source_t *source;
+    size_t line_count;
+    ir_node_t *ast;
+} unit_t;
+
+typedef struct {
+    unit_t *units;
+    size_t unit_count;
+    atomic_size_t next;
+    void (*work)(unit_t *unit, void *data);
+    void *data;
+} workers_t;
+
+static void *worker(void *arg) {
+    workers_t *workers = arg;
+    for(size_t i; (i = atomic_fetch_add(&workers->next, 1)) < workers->unit_count;) workers->work(&workers->units[i], workers->data);
+    return NULL;
+}
+
+// Hands the units out to up to `jobs` threads, the calling thread being one of them
+static void run_parallel(size_t jobs, unit_t *units, size_t unit_count, void (*work)(unit_t *unit, void *data), void *data) {
+    workers_t workers = { .units = units, .unit_count = unit_count, .next = 0, .work = work, .data = data };
+    if(jobs > unit_count) jobs = unit_count;
+    pthread_t threads[jobs];
+    for(size_t i = 1; i < jobs; i++) if(pthread_create(&threads[i], NULL, worker, &workers) != 0) exit_message("failed to create a worker thread");
+    worker(&workers);
+    for(size_t i = 1; i < jobs; i++) pthread_join(threads[i], NULL);
+}
+
+static void read_unit(unit_t *unit, void *data) {
+    char *source_filename = basename(strdup(unit->path));
+    char *source_directory = realpath(unit->path, NULL);
+    if(source_directory != NULL) source_directory = dirname(source_directory);
+
+    trace_begin("read", NULL);
+    FILE *file = fopen(unit->path, "r");
     struct stat s;
     if(file == NULL || fstat(fileno(file), &s) != 0) exit_perror();
 
-    void *data = malloc(s.st_size);
-    if(fread(data, 1, s.st_size, file) != s.st_size) exit_perror();
+    char *data_buffer = malloc(s.st_size);
+    if(fread(data_buffer, 1, s.st_size, file) != s.st_size) exit_perror();
     fclose(file);
+    trace_end("read", NULL);
 
-    source_t *source = malloc(sizeof(source_t));
-    source->name = source_filename;
-    source->data = data;
-    source->data_length = s.st_size;
+    unit->line_count = s.st_size > 0 ? 1 : 0;
+    for(off_t i = 0; i < s.st_size; i++) if(data_buffer[i] == '\n') unit->line_count++;
 
-    tokenizer_t *tokenizer = tokenizer_make(source);
+    unit->source = malloc(sizeof(source_t));
+    unit->source->name = source_filename;
+    unit->source->directory = source_directory;
+    unit->source->data = data_buffer;
+    unit->source->data_length = s.st_size;
+}
+
+static void parse_unit(unit_t *unit, void *data) {
+    read_unit(unit, data);
+    tokenizer_t *tokenizer = tokenizer_make(unit->source);
     if(tokenizer == NULL) exit_message("failed to initialize the tokenizer");
-    ir_node_t *ast = parser_parse(tokenizer);
+    trace_begin("parse", NULL);
+    unit->ast = parser_parse(tokenizer);
     tokenizer_free(tokenizer);
+    trace_end("parse", NULL);
+}
+
+static void gen_unit(unit_t *unit, void *data) {
+    gen(unit->ast, unit->source, unit->dest_path, (gen_options_t *) data);
+    // Renaming is atomic, a concurrent or interrupted build never sees half an object
+    if(unit->cache_path != NULL && rename(unit->dest_path, unit->cache_path) != 0) exit_perror();
+}
+
+static void pipeline_unit(unit_t *unit, void *data) {
+    unit->ast = pipeline_gen(unit->source, unit->dest_path, (gen_options_t *) data);
+}
+
+// Every function and global variable becomes a unit of its own, those whose key is already in the cache are not generated again
+static unit_t *cache_units(unit_t *units, size_t unit_count, const char *cache_dir, gen_options_t *options, size_t *miss_count, char ***objects, size_t *object_count) {
+    trace_begin("cache_lookup", NULL);
+    if(mkdir(cache_dir, 0777) != 0 && errno != EEXIST) exit_perror();
+
+    size_t function_count = 0;
+    for(size_t i = 0; i < unit_count; i++) {
+        for(size_t j = 0; j < units[i].ast->program.global_count; j++) {
+            ir_node_type_t type = units[i].ast->program.globals[j]->type;
+            if(type == IR_NODE_TYPE_GLOBAL_FUNCTION || type == IR_NODE_TYPE_GLOBAL_VARIABLE) function_count++;
+        }
+    }
+    unit_t *misses = calloc(function_count, sizeof(unit_t));
+    *objects = malloc(sizeof(char *) * function_count);
+    *miss_count = 0;
+    *object_count = 0;
+
+    for(size_t i = 0; i < unit_count; i++) {
+        for(size_t j = 0; j < units[i].ast->program.global_count; j++) {
+            ir_node_t *node = units[i].ast->program.globals[j];
+            if(node->type == IR_NODE_TYPE_GLOBAL_FUNCTION ? node->global_function.is_comptime : node->type != IR_NODE_TYPE_GLOBAL_VARIABLE) continue;
+
+            char key[GEN_CACHE_KEY_LENGTH + 1];
+            gen_cache_key(node, units[i].source, options, key);
+            char *cache_path;
+            if(asprintf(&cache_path, "%s/%s.o", cache_dir, key) < 0) exit_perror();
+            (*objects)[(*object_count)++] = cache_path;
+            if(access(cache_path, R_OK) == 0) continue;
+
+            char *dest_path;
+            if(asprintf(&dest_path, "%s/%s.XXXXXX", cache_dir, key) < 0) exit_perror();
+            int fd = mkstemp(dest_path);
+            if(fd < 0) exit_perror();
+            close(fd);
+
+            // Externs, functions and variables in other units are declared through the summary on first use
+            ir_node_t **globals = mem_alloc(MEM_SUBSYSTEM_NODES, sizeof(ir_node_t *));
+            globals[0] = node;
+            misses[(*miss_count)++] = (unit_t) { .path = units[i].path, .source = units[i].source, .ast = ir_node_make_program(1, globals, node->diag_loc), .dest_path = dest_path, .cache_path = cache_path };
+        }
+    }
+    fprintf(stderr, "cache: reused %lu of %lu globals\n", *object_count - *miss_count, *object_count);
+    trace_end("cache_lookup", NULL);
+    return misses;
+}
+
+// Drops every global that main and the exported symbols never reach, looking at all files of the program at once
+static void prune_units(unit_t *units, size_t unit_count, const char **roots, size_t root_count) {
+    trace_begin("prune", NULL);
+    size_t global_count = 0;
+    for(size_t i = 0; i < unit_count; i++) global_count += units[i].ast->program.global_count;
+    ir_node_t **globals = malloc(sizeof(ir_node_t *) * global_count);
+    for(size_t i = 0, offset = 0; i < unit_count; offset += units[i++].ast->program.global_count) {
+        memcpy(&globals[offset], units[i].ast->program.globals, sizeof(ir_node_t *) * units[i].ast->program.global_count);
+    }
+
+    ir_callgraph_t callgraph;
+    ir_callgraph_build(&callgraph, &(ir_node_t) { .type = IR_NODE_TYPE_PROGRAM, .program = { .global_count = global_count, .globals = globals } });
+    bool *reachable = ir_callgraph_reachable(&callgraph, roots, root_count);
+
+    size_t skipped_functions = 0, skipped_externs = 0, skipped_variables = 0;
+    for(size_t i = 0, index = 0; i < unit_count; i++) {
+        ir_node_t *program = units[i].ast;
+        size_t kept = 0;
+        for(size_t j = 0; j < program->program.global_count; j++, index++) {
+            // Imports and structs were resolved already, keeping them costs nothing
+            ir_node_type_t type = program->program.globals[j]->type;
+            if(reachable[index] || type == IR_NODE_TYPE_GLOBAL_IMPORT || type == IR_NODE_TYPE_GLOBAL_STRUCT) {
+                program->program.globals[kept++] = program->program.globals[j];
+                continue;
+            }
+            switch(type) {
+                case IR_NODE_TYPE_GLOBAL_FUNCTION: skipped_functions++; break;
+                case IR_NODE_TYPE_GLOBAL_VARIABLE: skipped_variables++; break;
+                default: skipped_externs++; break;
+            }
+        }
+        program->program.global_count = kept;
+    }
+    fprintf(stderr, "skipped %zu unreachable functions, %zu unused externs and %zu unused variables\n", skipped_functions, skipped_externs, skipped_variables);
+
+    mem_free(MEM_SUBSYSTEM_NODES, reachable);
+    ir_callgraph_free(&callgraph);
+    free(globals);
+    trace_end("prune", NULL);
+}
+
+// Interfaces are looked up next to the importing source first, then in every -I directory
+static void resolve_imports(unit_t *unit, gen_summary_t *summary, const char **import_paths, size_t import_path_count, const char ***imported, size_t *imported_count) {
+    for(size_t i = 0; i < unit->ast->program.global_count; i++) {
+        ir_node_t *node = unit->ast->program.globals[i];
+        if(node->type != IR_NODE_TYPE_GLOBAL_IMPORT) continue;
+        bool is_imported = false;
+        for(size_t j = 0; j < *imported_count; j++) if(strcmp((*imported)[j], node->global_import.name) == 0) is_imported = true;
+        if(is_imported) continue;
+
+        trace_begin("import", node->global_import.name);
+        gen_interface_t *interface = NULL;
+        for(size_t j = 0; interface == NULL && j <= import_path_count; j++) {
+            const char *directory = j == 0 ? unit->source->directory : import_paths[j - 1];
+            if(directory == NULL) continue;
+            char *path;
+            if(asprintf(&path, "%s/%s.chi", directory, node->global_import.name) < 0) exit_perror();
+            if(access(path, F_OK) == 0) {
+                interface = gen_interface_open(path);
+                if(interface == NULL) diag_error(node->diag_loc, "invalid interface file '%s'", path);
+            }
+            free(path);
+        }
+        if(interface == NULL) diag_error(node->diag_loc, "no interface found for module '%s'", node->global_import.name);
+        gen_summary_add_interface(summary, interface);
+        *imported = realloc(*imported, sizeof(const char *) * ++*imported_count);
+        (*imported)[*imported_count - 1] = node->global_import.name;
+        trace_end("import", node->global_import.name);
+    }
+}
+
+static struct option g_options[] = {
+    { "output", required_argument, NULL, 'o' },
+    { "debug", no_argument, NULL, 'g' },
+    { "passes", required_argument, NULL, 'p' },
+    { "profile-generate", no_argument, NULL, 'G' },
+    { "profile-use", required_argument, NULL, 'U' },
+    { "time-report", optional_argument, NULL, 'T' },
+    { "trace", required_argument, NULL, 'R' },
+    { "mem-report", no_argument, NULL, 'M' },
+    { "print-ast", no_argument, NULL, 'A' },
+    { "print-layouts", no_argument, NULL, 'W' },
+    { "emit", required_argument, NULL, 'E' },
+    { "linker", required_argument, NULL, 'L' },
+    { "link-bitcode", required_argument, NULL, 'B' },
+    { "jobs", required_argument, NULL, 'j' },
+    { "split", required_argument, NULL, 'S' },
+    { "prune-unreachable", no_argument, NULL, 'P' },
+    { "cache-dir", required_argument, NULL, 'C' },
+    { "emit-interface", no_argument, NULL, 'i' },
+    { "import-path", required_argument, NULL, 'I' },
+    { "export", required_argument, NULL, 'X' },
+    { "pipeline", no_argument, NULL, 'Y' },
+    { "server", optional_argument, NULL, 'D' },
+    { "comptime-steps", required_argument, NULL, 'K' },
+    { "backend", required_argument, NULL, 'V' },
+    {}
+};
+
+static bool g_is_served = false;
+
+int main(int argc, char **argv);
+
+// Requests run in a fork of a server worker, getopt has to start over on their arguments
+static int compile_request(int argc, char **argv) {
+    g_is_served = true;
+    optind = 0;
+    return main(argc, argv);
+}
+
+int main(int argc, char **argv) {
+    // `charon run <source> [args...]` jits the program and runs it in process, `charon repl` reads entries from stdin
+    bool run = argc > 1 && strcmp(argv[1], "run") == 0;
+    bool repl = argc > 1 && strcmp(argv[1], "repl") == 0;
+    if(run || repl) {
+        argv++;
+        argc--;
+    } else {
+        printf("Charon (dev)\n");
+    }
+
+    static const struct { const char *name, *default_dest; gen_emit_t emit; } emit_kinds[] = {
+        { "llvm-ir", "out.ll", GEN_EMIT_LLVM_IR },
+        { "llvm-bc", "out.bc", GEN_EMIT_LLVM_BC },
+        { "asm", "out.s", GEN_EMIT_ASM },
+        { "obj", "out.o", GEN_EMIT_OBJ },
+        { "exe", "a.out", GEN_EMIT_OBJ }
+    };
+
+    char *dest_path = NULL;
+    size_t emit_kind = 0;
+    char *linker = getenv("CC") != NULL ? getenv("CC") : "cc";
+    gen_options_t options = { .passes = NULL, .debug = false };
+    char opt_level = '0';
+    trace_level_t time_report = TRACE_LEVEL_NONE;
+    char *trace_path = NULL;
+    bool report_memory = false;
+    bool print_ast = false;
+    bool print_struct_layouts = false;
+    size_t jobs = 0, split = 1;
+    bool prune = false;
+    char *cache_dir = NULL;
+    bool emit_interface = false;
+    bool pipeline = false;
+    bool server = false;
+    bool vm = false;
+    char socket_path[108] = "";
+    size_t import_path_count = 0;
+    const char **import_paths = NULL;
+    size_t root_count = 1;
+    const char **roots = malloc(sizeof(const char *));
+    roots[0] = "main";
+
+    int c;
+    while((c = getopt_long(argc, argv, run ? "+o:gO:j:I:" : "o:gO:j:I:", g_options, NULL)) != -1) {
+        switch(c) {
+            case 'o': dest_path = optarg; break;
+            case 'g': options.debug = true; break;
+            case 'O':
+                if(strlen(optarg) != 1 || strchr("0123", optarg[0]) == NULL) exit_message("invalid optimization level");
+                opt_level = optarg[0];
+                options.codegen_level = (LLVMCodeGenOptLevel) (optarg[0] - '0');
+                break;
+            case 'p': options.passes = optarg; break;
+            case 'G': options.profile_generate = true; break;
+            case 'U': options.profile_use = optarg; break;
+            case 'T':
+                time_report = TRACE_LEVEL_PHASES;
+                if(optarg == NULL) break;
+                if(strcmp(optarg, "detailed") != 0) exit_message("invalid time report, expected `detailed`");
+                time_report = TRACE_LEVEL_FUNCTIONS;
+                options.time_passes = true;
+                break;
+            case 'R': trace_path = optarg; break;
+            case 'M': report_memory = true; break;
+            case 'A': print_ast = true; break;
+            case 'W': print_struct_layouts = true; break;
+            case 'E':
+                for(emit_kind = 0; emit_kind < sizeof(emit_kinds) / sizeof(emit_kinds[0]); emit_kind++) if(strcmp(optarg, emit_kinds[emit_kind].name) == 0) break;
+                if(emit_kind == sizeof(emit_kinds) / sizeof(emit_kinds[0])) exit_message("invalid emit kind, expected one of `llvm-ir`, `llvm-bc`, `asm`, `obj`, `exe`");
+                break;
+            case 'L': linker = optarg; break;
+            case 'j':
+                jobs = strtoul(optarg, NULL, 10);
+                if(jobs == 0) exit_message("invalid job count");
+                break;
+            case 'S':
+                split = strtoul(optarg, NULL, 10);
+                if(split == 0) exit_message("invalid split count");
+                break;
+            case 'P': prune = true; break;
+            case 'C': cache_dir = optarg; break;
+            case 'i': emit_interface = true; break;
+            case 'Y': pipeline = true; break;
+            case 'D':
+                server = true;
+                if(optarg != NULL) snprintf(socket_path, sizeof(socket_path), "%s", optarg);
+                break;
+            case 'K':
+                options.comptime_steps = strtoul(optarg, NULL, 10);
+                if(options.comptime_steps == 0) exit_message("invalid comptime step limit");
+                break;
+            case 'V':
+                if(strcmp(optarg, "llvm") != 0 && strcmp(optarg, "vm") != 0) exit_message("invalid backend, expected `llvm` or `vm`");
+                vm = strcmp(optarg, "vm") == 0;
+                break;
+            case 'I':
+                import_paths = realloc(import_paths, sizeof(const char *) * ++import_path_count);
+                import_paths[import_path_count - 1] = optarg;
+                break;
+            case 'X':
+                roots = realloc(roots, sizeof(const char *) * ++root_count);
+                roots[root_count - 1] = optarg;
+                break;
+            case 'B':
+                options.bitcode = realloc(options.bitcode, sizeof(const char *) * ++options.bitcode_count);
+                options.bitcode[options.bitcode_count - 1] = optarg;
+                break;
+            default: exit_message("usage: charon [run | repl] [-g] [-O<level>] [--passes=<pipeline>] [--profile-generate | --profile-use=<profile>] [--emit=llvm-ir|llvm-bc|asm|obj|exe] [--linker=<cc>] [--link-bitcode=<file.bc>]... [--time-report[=detailed]] [--trace=<file>] [--mem-report] [--print-ast] [--print-layouts] [-j <jobs>] [--split=<modules>] [--prune-unreachable [--export=<symbol>]...] [--cache-dir=<dir>] [--emit-interface] [-I <dir>]... [--pipeline] [--comptime-steps=<steps>] [--backend=llvm|vm] [--server[=<socket>] [-j <workers>]] [-o <output>] <source>... [object.o]... [args...]");
+        }
+    }
+    if(server && g_is_served) exit_message("a server cannot be started through a server");
+    if(server && (run || repl || optind != argc)) exit_message("--server does not take a source file");
+    // Workers handle one request at a time, each compile can still use -j threads of its own
+    if(server && socket_path[0] == '\0' && !server_socket_path(socket_path, sizeof(socket_path))) exit_message("no private place for the socket, set $XDG_RUNTIME_DIR or pass --server=<socket>");
+    if(server) return server_main(socket_path, jobs != 0 ? jobs : (size_t) sysconf(_SC_NPROCESSORS_ONLN), compile_request);
+
+    bool link = strcmp(emit_kinds[emit_kind].name, "exe") == 0;
+    options.emit = emit_kinds[emit_kind].emit;
+
+    if(options.passes == NULL) {
+        char *passes = strdup(options.bitcode_count > 0 ? "lto<O0>" : "default<O0>");
+        *strchr(passes, '0') = opt_level;
+        options.passes = passes;
+    }
+    if(options.profile_generate && options.profile_use != NULL) exit_message("--profile-generate and --profile-use are mutually exclusive");
+    if(options.profile_generate && (run || repl)) exit_message("--profile-generate needs the profile runtime, build with --emit=exe or link the output like `make pgo-test` does");
+    if(repl && options.bitcode_count > 0) exit_message("--link-bitcode is not supported in the repl");
+    if(repl && prune) exit_message("--prune-unreachable is not supported in the repl");
+    if(repl && optind != argc) exit_message("the repl does not take a source file");
+    if(!repl && optind >= argc) exit_message("expected a source file");
+    if(split > 1 && (!link || run || repl)) exit_message("--split requires --emit=exe");
+    if(split > 1 && options.bitcode_count > 0) exit_message("--split does not support --link-bitcode");
+    if(cache_dir != NULL && (!link || run || repl)) exit_message("--cache-dir requires --emit=exe");
+    if(cache_dir != NULL && (split > 1 || options.bitcode_count > 0)) exit_message("--cache-dir does not support --split or --link-bitcode");
+    if(vm && (!run || options.bitcode_count > 0)) exit_message("--backend=vm only supports run without --link-bitcode");
+    if(pipeline && (run || repl || split > 1 || cache_dir != NULL || prune || emit_interface)) exit_message("--pipeline does not support run, repl, --split, --cache-dir, --prune-unreachable or --emit-interface");
+    // Every split module is optimized and emitted on its own thread unless told otherwise
+    if(jobs == 0) jobs = split;
+    mem_init(report_memory);
+    // The repl reports latency per entry instead of one phase table for the whole session
+    trace_init(repl ? TRACE_LEVEL_NONE : time_report, report_memory, trace_path);
+
+    if(repl) {
+        int result = repl_main(&options, time_report != TRACE_LEVEL_NONE);
+        trace_finish();
+        mem_report(stderr, 0);
+        return result;
+    }
+
+    // `run` passes everything after the source to the program, objects given to a build only go to the linker
+    size_t unit_count = 0, object_count = 0;
+    unit_t *units = calloc(argc - optind, sizeof(unit_t));
+    const char **objects = calloc(argc - optind, sizeof(const char *));
+    for(int i = optind; i < (run ? optind + 1 : argc); i++) {
+        size_t length = strlen(argv[i]);
+        if(!run && length > 2 && strcmp(argv[i] + length - 2, ".o") == 0) objects[object_count++] = argv[i];
+        else units[unit_count++].path = argv[i];
+    }
+    if(unit_count == 0) exit_message("expected a source file");
+    if(object_count > 0 && !link) exit_message("object files require --emit=exe");
+    if(unit_count > 1 && options.bitcode_count > 0) exit_message("--link-bitcode requires a single source file");
+    // Linked bitcode turns the module into a whole program (when building an executable), which the LTO pipeline expects.
+    // Objects given to the linker can call into the module, so its definitions stay external then
+    options.internalize = link && options.bitcode_count > 0 && object_count == 0;
+    if(unit_count > 1 && !link && dest_path != NULL) exit_message("-o with several source files requires --emit=exe");
+    if(pipeline && unit_count > 1) exit_message("--pipeline requires a single source file");
+
+    // A pipelined unit is parsed while it is generated, nothing can be summarized ahead of codegen
+    run_parallel(jobs, units, unit_count, pipeline ? read_unit : parse_unit, NULL);
+
+    size_t total_bytes = 0, total_lines = 0, imported_count = 0;
+    const char **imported = NULL;
+    gen_summary_t summary = {};
+    for(size_t i = 0; i < unit_count; i++) {
+        total_bytes += units[i].source->data_length;
+        total_lines += units[i].line_count;
+        if(pipeline) continue;
+        gen_summary_add_program(&summary, units[i].ast);
+        resolve_imports(&units[i], &summary, import_paths, import_path_count, &imported, &imported_count);
+    }
+    trace_set_input(total_bytes, total_lines);
+    options.summary = &summary;
+    free(imported);
+
+    // Written before pruning, importers may need functions this program never calls
+    for(size_t i = 0; emit_interface && i < unit_count; i++) {
+        // Next to the source, where importers look for it, whatever the working directory
+        char *path = replace_extension(units[i].path, ".chi");
+        gen_interface_write(units[i].ast, path);
+        free(path);
+    }
+    if(prune) prune_units(units, unit_count, roots, root_count);
 
     // semantics_validate(ast);
-    gen(ast, "build/test.ll", "");
+    int result = EXIT_SUCCESS;
+    if(run && vm) {
+        // Bytecode skips LLVM entirely, which is what short runs spend most of their time in
+        result = vm_run(units[0].ast, options.comptime_steps != 0 ? options.comptime_steps : GEN_COMPTIME_STEPS, argc - optind, &argv[optind]);
+    } else if(run) {
+        result = gen_run(units[0].ast, units[0].source, &options, argc - optind, &argv[optind]);
+    } else {
+        // Splitting partitions every file by call graph locality, each partition is generated in its own context
+        unit_t *gen_units = units;
+        size_t gen_unit_count = unit_count;
+        if(split > 1) {
+            trace_begin("split", NULL);
+            gen_unit_count = unit_count * split;
+            gen_units = calloc(gen_unit_count, sizeof(unit_t));
+            for(size_t i = 0; i < unit_count; i++) {
+                ir_callgraph_t callgraph;
+                ir_callgraph_build(&callgraph, units[i].ast);
+                ir_node_t **programs = ir_callgraph_partition(&callgraph, split);
+                for(size_t j = 0; j < split; j++) gen_units[i * split + j] = (unit_t) { .path = units[i].path, .source = units[i].source, .ast = programs[j] };
+                mem_free(MEM_SUBSYSTEM_NODES, programs);
+                ir_callgraph_free(&callgraph);
+            }
+            trace_end("split", NULL);
+        }
+
+        // With a cache every function is its own unit and the linker takes the cached objects of all of them
+        char **cached_objects = NULL;
+        size_t cached_object_count = 0;
+        if(cache_dir != NULL) gen_units = cache_units(units, unit_count, cache_dir, &options, &gen_unit_count, &cached_objects, &cached_object_count);
+
+        const char *extension = strrchr(emit_kinds[emit_kind].default_dest, '.');
+        for(size_t i = 0; i < gen_unit_count; i++) {
+            if(gen_units[i].dest_path != NULL) continue;
+            if(link) {
+                // Every file becomes its own object, only the linker sees the whole program
+                const char *directory = getenv("TMPDIR");
+                if(directory == NULL || directory[0] == '\0') directory = "/tmp";
+                if(asprintf(&gen_units[i].dest_path, "%s/charon-XXXXXX.o", directory) < 0) exit_perror();
+                int fd = mkstemps(gen_units[i].dest_path, 2);
+                if(fd < 0) exit_perror();
+                close(fd);
+            } else if(gen_unit_count == 1) {
+                gen_units[i].dest_path = dest_path != NULL ? dest_path : strdup(emit_kinds[emit_kind].default_dest);
+            } else {
+                gen_units[i].dest_path = replace_extension(gen_units[i].source->name, extension);
+            }
+        }
+        run_parallel(jobs, gen_units, gen_unit_count, pipeline ? pipeline_unit : gen_unit, &options);
+
+        if(link) {
+            size_t generated_count = cache_dir != NULL ? cached_object_count : gen_unit_count;
+            const char *link_objects[generated_count + object_count];
+            for(size_t i = 0; i < generated_count; i++) link_objects[i] = cache_dir != NULL ? cached_objects[i] : gen_units[i].dest_path;
+            for(size_t i = 0; i < object_count; i++) link_objects[generated_count + i] = objects[i];
+            bool is_linked = link_executable(linker, link_objects, generated_count + object_count, dest_path != NULL ? dest_path : emit_kinds[emit_kind].default_dest, options.profile_generate);
+            // The objects are only temporaries, a failed link leaves nothing behind either
+            if(cache_dir == NULL) for(size_t i = 0; i < gen_unit_count; i++) unlink(gen_units[i].dest_path);
+            for(size_t i = 0; i < cached_object_count; i++) free(cached_objects[i]);
+            free(cached_objects);
+            if(!is_linked) exit_message("linking failed");
+        }
+        if(gen_units != units) free(gen_units);
+    }
 
-    print_node(ast, 0);
+    if(print_ast) for(size_t i = 0; i < unit_count; i++) print_node(units[i].ast, 0);
+    if(print_struct_layouts) for(size_t i = 0; i < unit_count; i++) print_layouts(units[i].ast);
+    trace_finish();
+    mem_report(stderr, total_bytes);
 
-    free(source);
-    return EXIT_SUCCESS;
+    gen_summary_free(&summary);
+    free(units);
+    free(objects);
+    free(roots);
+    free(import_paths);
+    return result;
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 
 #define INFO_LINE_COUNT 3
 
+static thread_local jmp_buf *g_recovery = NULL;
+static thread_local FILE *g_stream = NULL;
+
 typedef struct {
     bool present;
     size_t offset, length;
@@ -51,14 +54,29 @@ static void diag(diag_loc_t *loc, char *fmt, va_list list, char *type, FILE *fd)
 [[noreturn]] void diag_error(diag_loc_t diag_loc, char *fmt, ...) {
     va_list list;
     va_start(list, fmt);
-    diag(&diag_loc, fmt, list, "\e[91merror", stderr);
+    diag(&diag_loc, fmt, list, "\e[91merror", g_stream != NULL ? g_stream : stderr);
     va_end(list);
+    if(g_recovery != NULL) longjmp(*g_recovery, 1);
     exit(EXIT_FAILURE);
 }
 
+// Errors longjmp to the recovery point instead of exiting while one is set, returns the previous one
+jmp_buf *diag_set_recovery(jmp_buf *recovery) {
+    jmp_buf *previous = g_recovery;
+    g_recovery = recovery;
+    return previous;
+}
+
+// Diagnostics of the calling thread go to `stream` instead of stderr and stdout while it is set, returns the previous one
+FILE *diag_set_stream(FILE *stream) {
+    FILE *previous = g_stream;
+    g_stream = stream;
+    return previous;
+}
+
 void diag_warn(diag_loc_t diag_loc, char *fmt, ...) {
     va_list list;
     va_start(list, fmt);
-    diag(&diag_loc, fmt, list, "\e[93mwarn", stdout);
+    diag(&diag_loc, fmt, list, "\e[93mwarn", g_stream != NULL ? g_stream : stdout);
     va_end(list);
 }
\ No newline at end of file
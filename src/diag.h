@@ -1,6 +1,8 @@
 #pragma once
 #include <stddef.h>
 #include <stdarg.h>
+#include <stdio.h>
+#include <setjmp.h>
 #include "source.h"
 
 typedef struct {
@@ -10,4 +12,6 @@ typedef struct {
 } diag_loc_t;
 
 [[noreturn]] void diag_error(diag_loc_t diag_loc, char *fmt, ...);
+jmp_buf *diag_set_recovery(jmp_buf *recovery);
+FILE *diag_set_stream(FILE *stream);
 void diag_warn(diag_loc_t diag_loc, char *fmt, ...);
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include "gen.h"
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "../sha256.h"
+
+#define CACHE_FORMAT_VERSION 4
+
+// A key names the object it was built into, it has to be collision resistant or a stale object gets linked
+typedef sha256_t hash_t;
+
+typedef struct {
+    uint8_t bytes[SHA256_DIGEST_SIZE];
+} digest_t;
+
+static void hash_bytes(hash_t *hash, const void *data, size_t length) {
+    sha256_update(hash, data, length);
+}
+
+static void hash_u64(hash_t *hash, uint64_t value) {
+    hash_bytes(hash, &value, sizeof(value));
+}
+
+static void hash_string(hash_t *hash, const char *str) {
+    if(str == NULL) hash_u64(hash, 0);
+    else hash_bytes(hash, str, strlen(str) + 1);
+}
+
+// Re-profiling into the same file keeps its path, so it is the contents that count. Every global needs a key,
+// the digest of the last profile read is reused for as long as the file looks unchanged.
+static digest_t profile_digest(const char *path) {
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static struct stat last_info;
+    static char *last_path = NULL;
+    static digest_t last_digest;
+
+    hash_t hash;
+    sha256_init(&hash);
+    digest_t digest;
+    struct stat info;
+    if(stat(path, &info) != 0) {
+        // Generating code fails on it anyway
+        hash_string(&hash, path);
+        sha256_final(&hash, digest.bytes);
+        return digest;
+    }
+    pthread_mutex_lock(&mutex);
+    bool is_known = last_path != NULL && strcmp(last_path, path) == 0 && last_info.st_dev == info.st_dev && last_info.st_ino == info.st_ino && last_info.st_size == info.st_size
+        && last_info.st_mtim.tv_sec == info.st_mtim.tv_sec && last_info.st_mtim.tv_nsec == info.st_mtim.tv_nsec;
+    if(is_known) {
+        digest = last_digest;
+        pthread_mutex_unlock(&mutex);
+        return digest;
+    }
+    FILE *file = fopen(path, "rb");
+    if(file != NULL) {
+        char buffer[1 << 16];
+        size_t count;
+        while((count = fread(buffer, 1, sizeof(buffer), file)) > 0) hash_bytes(&hash, buffer, count);
+        fclose(file);
+    }
+    sha256_final(&hash, digest.bytes);
+    free(last_path);
+    last_path = strdup(path);
+    last_info = info;
+    last_digest = digest;
+    pthread_mutex_unlock(&mutex);
+    return digest;
+}
+
+// Structs being hashed further up, one that points back at itself is hashed by how far up it is
+typedef struct struct_chain {
+    ir_type_t *type;
+    struct struct_chain *outer;
+} struct_chain_t;
+
+static void hash_type_in(hash_t *hash, ir_type_t *type, struct_chain_t *chain) {
+    hash_u64(hash, type->kind);
+    switch(type->kind) {
+        case IR_TYPE_KIND_VOID: break;
+        case IR_TYPE_KIND_INTEGER:
+            hash_u64(hash, type->integer.bit_size);
+            hash_u64(hash, type->integer.is_signed);
+            break;
+        case IR_TYPE_KIND_POINTER: hash_type_in(hash, type->pointer.base, chain); break;
+        case IR_TYPE_KIND_ARRAY:
+            hash_u64(hash, type->array.count);
+            hash_type_in(hash, type->array.base, chain);
+            break;
+        case IR_TYPE_KIND_VECTOR:
+            hash_u64(hash, type->vector.count);
+            hash_type_in(hash, type->vector.base, chain);
+            break;
+        case IR_TYPE_KIND_STRUCT:
+            // Member accesses compile to offsets, so any change to the layout changes the code
+            size_t depth = 0;
+            for(struct_chain_t *link = chain; link != NULL; link = link->outer, depth++) {
+                if(link->type != type) continue;
+                hash_u64(hash, depth);
+                return;
+            }
+            hash_u64(hash, UINT64_MAX);
+            hash_string(hash, type->structure.name);
+            hash_u64(hash, type->structure.is_complete);
+            hash_u64(hash, type->structure.size);
+            hash_u64(hash, type->structure.align);
+            hash_u64(hash, type->structure.field_count);
+            struct_chain_t link = { .type = type, .outer = chain };
+            for(size_t i = 0; i < type->structure.field_count; i++) {
+                hash_string(hash, type->structure.fields[i].name);
+                hash_u64(hash, type->structure.fields[i].offset);
+                hash_u64(hash, type->structure.fields[i].align);
+                hash_type_in(hash, type->structure.fields[i].type, &link);
+            }
+            break;
+    }
+}
+
+static void hash_type(hash_t *hash, ir_type_t *type) {
+    hash_type_in(hash, type, NULL);
+}
+
+static void hash_function_type(hash_t *hash, gen_function_type_t *type) {
+    hash_type(hash, type->return_type);
+    hash_u64(hash, type->varargs);
+    hash_u64(hash, type->argument_count);
+    for(size_t i = 0; i < type->argument_count; i++) hash_type(hash, type->arguments[i]);
+}
+
+// Stands in for the token stream, whitespace and comments do not change the code
+static void hash_node(hash_t *hash, ir_node_t *node, gen_options_t *options) {
+    if(node == NULL) {
+        hash_u64(hash, UINT64_MAX);
+        return;
+    }
+    hash_u64(hash, node->type);
+    // Debug info records lines, so moving a function invalidates it
+    if(options->debug) hash_u64(hash, node->diag_loc.offset);
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC: hash_u64(hash, node->expr_literal.numeric_value); break;
+        case IR_NODE_TYPE_EXPR_LITERAL_STRING: hash_string(hash, node->expr_literal.string_value); break;
+        case IR_NODE_TYPE_EXPR_LITERAL_CHAR: hash_u64(hash, node->expr_literal.char_value); break;
+        case IR_NODE_TYPE_EXPR_LITERAL_BOOL: hash_u64(hash, node->expr_literal.bool_value); break;
+        case IR_NODE_TYPE_EXPR_BINARY:
+            hash_u64(hash, node->expr_binary.operation);
+            hash_node(hash, node->expr_binary.left, options);
+            hash_node(hash, node->expr_binary.right, options);
+            break;
+        case IR_NODE_TYPE_EXPR_UNARY:
+            hash_u64(hash, node->expr_unary.operation);
+            hash_node(hash, node->expr_unary.operand, options);
+            break;
+        case IR_NODE_TYPE_EXPR_VAR:
+            hash_string(hash, node->expr_var.name);
+            // A global is accessed through its type, locals of the same name only cost a spurious miss
+            gen_symbol_t *symbol = options->summary != NULL ? gen_summary_get(options->summary, node->expr_var.name) : NULL;
+            if(symbol != NULL && !symbol->is_function && symbol->variable != NULL) hash_type(hash, symbol->variable);
+            break;
+        case IR_NODE_TYPE_EXPR_CALL:
+            hash_string(hash, node->expr_call.name);
+            // The callee's signature decides how the call is lowered, its body does not
+            gen_function_type_t callee;
+            if(options->summary != NULL && gen_summary_find_function(options->summary, node->expr_call.name, &callee) != NULL) hash_function_type(hash, &callee);
+            hash_u64(hash, node->expr_call.argument_count);
+            for(size_t i = 0; i < node->expr_call.argument_count; i++) hash_node(hash, node->expr_call.arguments[i], options);
+            break;
+        case IR_NODE_TYPE_EXPR_CAST:
+            hash_type(hash, node->expr_cast.type);
+            hash_node(hash, node->expr_cast.value, options);
+            break;
+        case IR_NODE_TYPE_EXPR_COMPTIME: hash_node(hash, node->expr_comptime.value, options); break;
+        case IR_NODE_TYPE_EXPR_INDEX:
+            hash_node(hash, node->expr_index.value, options);
+            hash_node(hash, node->expr_index.index, options);
+            break;
+        case IR_NODE_TYPE_EXPR_MEMBER:
+            hash_node(hash, node->expr_member.value, options);
+            hash_string(hash, node->expr_member.name);
+            break;
+        case IR_NODE_TYPE_STMT_BLOCK:
+            hash_u64(hash, node->stmt_block.statement_count);
+            for(size_t i = 0; i < node->stmt_block.statement_count; i++) hash_node(hash, node->stmt_block.statements[i], options);
+            break;
+        case IR_NODE_TYPE_STMT_RETURN: hash_node(hash, node->stmt_return.value, options); break;
+        case IR_NODE_TYPE_STMT_IF:
+            hash_node(hash, node->stmt_if.condition, options);
+            hash_node(hash, node->stmt_if.body, options);
+            hash_node(hash, node->stmt_if.else_body, options);
+            break;
+        case IR_NODE_TYPE_STMT_WHILE:
+            hash_node(hash, node->stmt_while.condition, options);
+            hash_node(hash, node->stmt_while.body, options);
+            break;
+        case IR_NODE_TYPE_STMT_DECL:
+            hash_type(hash, node->stmt_decl.type);
+            hash_string(hash, node->stmt_decl.name);
+            hash_node(hash, node->stmt_decl.initial, options);
+            break;
+        default: assert(false);
+    }
+}
+
+typedef struct {
+    gen_summary_t *summary;
+    size_t function_count;
+    ir_node_t **functions;
+} comptime_dependencies_t;
+
+static void add_dependency(comptime_dependencies_t *dependencies, const char *name) {
+    gen_symbol_t *symbol = gen_summary_get(dependencies->summary, name);
+    if(symbol == NULL || symbol->definition == NULL || symbol->definition->type != IR_NODE_TYPE_GLOBAL_FUNCTION) return;
+    for(size_t i = 0; i < dependencies->function_count; i++) if(dependencies->functions[i] == symbol->definition) return;
+    dependencies->functions = mem_realloc(MEM_SUBSYSTEM_CODEGEN, dependencies->functions, sizeof(ir_node_t *) * ++dependencies->function_count);
+    dependencies->functions[dependencies->function_count - 1] = symbol->definition;
+}
+
+// Everything comptime evaluates calls into, its results are part of the object
+static void collect_evaluated(ir_node_t *node, void *data) {
+    if(node->type == IR_NODE_TYPE_EXPR_CALL) add_dependency(data, node->expr_call.name);
+}
+
+static void collect_comptime(ir_node_t *node, void *data) {
+    comptime_dependencies_t *dependencies = data;
+    if(node->type == IR_NODE_TYPE_EXPR_COMPTIME) ir_node_visit(node->expr_comptime.value, collect_evaluated, data);
+    if(node->type != IR_NODE_TYPE_EXPR_CALL) return;
+    gen_symbol_t *symbol = gen_summary_get(dependencies->summary, node->expr_call.name);
+    if(symbol != NULL && symbol->definition != NULL && symbol->definition->type == IR_NODE_TYPE_GLOBAL_FUNCTION && symbol->definition->global_function.is_comptime) add_dependency(dependencies, node->expr_call.name);
+}
+
+void gen_cache_key(ir_node_t *global, source_t *source, gen_options_t *options, char key[GEN_CACHE_KEY_LENGTH + 1]) {
+    assert(global->type == IR_NODE_TYPE_GLOBAL_FUNCTION || global->type == IR_NODE_TYPE_GLOBAL_VARIABLE);
+    hash_t hash;
+    sha256_init(&hash);
+    hash_u64(&hash, CACHE_FORMAT_VERSION);
+
+    // Everything that changes the object besides the global itself
+    char *cpu = LLVMGetHostCPUName();
+    char *triple = LLVMGetDefaultTargetTriple();
+    hash_string(&hash, cpu);
+    hash_string(&hash, triple);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(triple);
+    hash_string(&hash, options->passes);
+    hash_u64(&hash, options->codegen_level);
+    hash_u64(&hash, options->debug);
+    hash_u64(&hash, options->profile_generate);
+    if(options->profile_use != NULL) {
+        digest_t profile = profile_digest(options->profile_use);
+        hash_u64(&hash, 1);
+        hash_bytes(&hash, profile.bytes, sizeof(profile.bytes));
+    } else {
+        hash_u64(&hash, 0);
+    }
+    if(options->debug) {
+        hash_string(&hash, source->directory);
+        hash_string(&hash, source->name);
+    }
+
+    comptime_dependencies_t dependencies = { .summary = options->summary };
+    if(global->type == IR_NODE_TYPE_GLOBAL_VARIABLE) {
+        hash_string(&hash, global->global_variable.name);
+        hash_type(&hash, global->global_variable.type);
+        hash_node(&hash, global->global_variable.initial, options);
+        // The whole initializer is evaluated while compiling
+        if(options->summary != NULL) ir_node_visit(global->global_variable.initial, collect_evaluated, &dependencies);
+    } else {
+        ir_function_decl_t *decl = &global->global_function.decl;
+        hash_string(&hash, decl->name);
+        hash_u64(&hash, decl->argument_count);
+        for(size_t i = 0; i < decl->argument_count; i++) {
+            hash_type(&hash, decl->arguments[i].type);
+            hash_string(&hash, decl->arguments[i].name);
+        }
+        hash_type(&hash, decl->return_type);
+        hash_u64(&hash, decl->varargs);
+        hash_node(&hash, global->global_function.body, options);
+        if(options->summary != NULL) ir_node_visit(global->global_function.body, collect_comptime, &dependencies);
+    }
+
+    // The list grows while it is walked, callees of a dependency are dependencies too
+    for(size_t i = 0; i < dependencies.function_count; i++) {
+        ir_node_t *dependency = dependencies.functions[i];
+        hash_string(&hash, dependency->global_function.decl.name);
+        hash_u64(&hash, dependency->global_function.decl.argument_count);
+        for(size_t j = 0; j < dependency->global_function.decl.argument_count; j++) {
+            hash_type(&hash, dependency->global_function.decl.arguments[j].type);
+            hash_string(&hash, dependency->global_function.decl.arguments[j].name);
+        }
+        hash_type(&hash, dependency->global_function.decl.return_type);
+        hash_node(&hash, dependency->global_function.body, options);
+        ir_node_visit(dependency->global_function.body, collect_evaluated, &dependencies);
+    }
+    mem_free(MEM_SUBSYSTEM_CODEGEN, dependencies.functions);
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256_final(&hash, digest);
+    for(size_t i = 0; i < SHA256_DIGEST_SIZE; i++) snprintf(key + i * 2, 3, "%02x", digest[i]);
+}
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "gen.h"
+#include <stdio.h>
+
+#define DWARF_VERSION 4
+#define DW_ATE_BOOLEAN 0x02
+#define DW_ATE_SIGNED 0x05
+#define DW_ATE_UNSIGNED 0x08
+#define DW_TAG_STRUCTURE_TYPE 0x13
+
+static const char *g_producer = "Charon (dev)";
+
+static void resolve_loc(gen_debug_t *debug, diag_loc_t diag_loc, unsigned *line, unsigned *column) {
+    if(!diag_loc.present || debug->line_count == 0) {
+        *line = 0;
+        *column = 0;
+        return;
+    }
+    size_t low = 0, high = debug->line_count;
+    while(high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if(debug->lines[mid] <= diag_loc.offset) low = mid; else high = mid;
+    }
+    *line = low + 1;
+    *column = diag_loc.offset - debug->lines[low] + 1;
+}
+
+static LLVMMetadataRef debug_type(gen_context_t *ctx, ir_type_t *type);
+
+// Registered as a forward declaration before the members are built, a struct pointing at itself finds it
+static LLVMMetadataRef debug_struct_type(gen_context_t *ctx, ir_type_t *type) {
+    gen_debug_t *debug = ctx->debug;
+    for(size_t i = 0; i < debug->struct_count; i++) if(debug->struct_types[i] == type) return debug->struct_metadata[i];
+
+    const char *name = type->structure.name;
+    size_t name_length = strlen(name);
+    LLVMMetadataRef forward = LLVMDIBuilderCreateReplaceableCompositeType(debug->builder, DW_TAG_STRUCTURE_TYPE, name, name_length, debug->compile_unit, debug->file, 0, 0, ir_type_size(type) * 8, ir_type_align(type) * 8, LLVMDIFlagFwdDecl, "", 0);
+    size_t index = debug->struct_count++;
+    debug->struct_types = realloc(debug->struct_types, sizeof(ir_type_t *) * debug->struct_count);
+    debug->struct_metadata = realloc(debug->struct_metadata, sizeof(LLVMMetadataRef) * debug->struct_count);
+    debug->struct_types[index] = type;
+    debug->struct_metadata[index] = forward;
+    if(!type->structure.is_complete) return forward;
+
+    LLVMMetadataRef members[type->structure.field_count];
+    for(size_t i = 0; i < type->structure.field_count; i++) {
+        ir_type_field_t *field = &type->structure.fields[i];
+        members[i] = LLVMDIBuilderCreateMemberType(debug->builder, debug->compile_unit, field->name, strlen(field->name), debug->file, 0, ir_type_size(field->type) * 8, field->align * 8, field->offset * 8, LLVMDIFlagZero, debug_type(ctx, field->type));
+    }
+    LLVMMetadataRef complete = LLVMDIBuilderCreateStructType(debug->builder, debug->compile_unit, name, name_length, debug->file, 0, ir_type_size(type) * 8, ir_type_align(type) * 8, LLVMDIFlagZero, NULL, members, type->structure.field_count, 0, NULL, "", 0);
+    LLVMMetadataReplaceAllUsesWith(forward, complete);
+    debug->struct_metadata[index] = complete;
+    return complete;
+}
+
+static LLVMMetadataRef debug_type(gen_context_t *ctx, ir_type_t *type) {
+    switch(type->kind) {
+        case IR_TYPE_KIND_VOID: return NULL;
+        case IR_TYPE_KIND_POINTER: return LLVMDIBuilderCreatePointerType(ctx->debug->builder, debug_type(ctx, type->pointer.base), 64, 0, 0, "", 0);
+        case IR_TYPE_KIND_INTEGER:
+            if(type->integer.bit_size == 1) return LLVMDIBuilderCreateBasicType(ctx->debug->builder, "bool", 4, 8, DW_ATE_BOOLEAN, LLVMDIFlagZero);
+            char name[8];
+            int name_length = snprintf(name, sizeof(name), "%c%lu", type->integer.is_signed ? 'i' : 'u', type->integer.bit_size);
+            return LLVMDIBuilderCreateBasicType(ctx->debug->builder, name, name_length, type->integer.bit_size, type->integer.is_signed ? DW_ATE_SIGNED : DW_ATE_UNSIGNED, LLVMDIFlagZero);
+        case IR_TYPE_KIND_ARRAY:
+            LLVMMetadataRef subrange = LLVMDIBuilderGetOrCreateSubrange(ctx->debug->builder, 0, type->array.count);
+            return LLVMDIBuilderCreateArrayType(ctx->debug->builder, ir_type_size(type) * 8, 0, debug_type(ctx, type->array.base), &subrange, 1);
+        case IR_TYPE_KIND_STRUCT: return debug_struct_type(ctx, type);
+        case IR_TYPE_KIND_VECTOR:
+            LLVMMetadataRef lanes = LLVMDIBuilderGetOrCreateSubrange(ctx->debug->builder, 0, type->vector.count);
+            return LLVMDIBuilderCreateVectorType(ctx->debug->builder, ir_type_size(type) * 8, ir_type_align(type) * 8, debug_type(ctx, type->vector.base), &lanes, 1);
+    }
+    assert(false);
+}
+
+void gen_debug_init(gen_context_t *ctx, source_t *source) {
+    gen_debug_t *debug = malloc(sizeof(gen_debug_t));
+    debug->builder = LLVMCreateDIBuilder(ctx->module);
+    debug->source = source;
+    debug->struct_count = 0;
+    debug->struct_types = NULL;
+    debug->struct_metadata = NULL;
+
+    debug->line_count = 1;
+    for(size_t i = 0; i < source->data_length; i++) if(source->data[i] == '\n') debug->line_count++;
+    debug->lines = malloc(sizeof(size_t) * debug->line_count);
+    debug->lines[0] = 0;
+    for(size_t i = 0, line = 1; i < source->data_length; i++) if(source->data[i] == '\n') debug->lines[line++] = i + 1;
+
+    const char *directory = source->directory != NULL ? source->directory : ".";
+    debug->file = LLVMDIBuilderCreateFile(debug->builder, source->name, strlen(source->name), directory, strlen(directory));
+    debug->compile_unit = LLVMDIBuilderCreateCompileUnit(
+        debug->builder, LLVMDWARFSourceLanguageC, debug->file,
+        g_producer, strlen(g_producer), false, "", 0, 0, "", 0,
+        LLVMDWARFEmissionFull, 0, false, false, "", 0, "", 0
+    );
+    debug->scope = debug->compile_unit;
+
+    LLVMAddModuleFlag(ctx->module, LLVMModuleFlagBehaviorWarning, "Debug Info Version", 18, LLVMValueAsMetadata(LLVMConstInt(ctx->types.int32, LLVMDebugMetadataVersion(), false)));
+    LLVMAddModuleFlag(ctx->module, LLVMModuleFlagBehaviorWarning, "Dwarf Version", 13, LLVMValueAsMetadata(LLVMConstInt(ctx->types.int32, DWARF_VERSION, false)));
+
+    ctx->debug = debug;
+}
+
+void gen_debug_finalize(gen_context_t *ctx) {
+    if(ctx->debug == NULL) return;
+    LLVMDIBuilderFinalize(ctx->debug->builder);
+    LLVMDisposeDIBuilder(ctx->debug->builder);
+    free(ctx->debug->lines);
+    free(ctx->debug->struct_types);
+    free(ctx->debug->struct_metadata);
+    free(ctx->debug);
+    ctx->debug = NULL;
+}
+
+void gen_debug_function_enter(gen_context_t *ctx, gen_function_t *function, diag_loc_t diag_loc) {
+    if(ctx->debug == NULL) return;
+    gen_debug_t *debug = ctx->debug;
+
+    LLVMMetadataRef types[function->type.argument_count + 1];
+    types[0] = debug_type(ctx, function->type.return_type);
+    for(size_t i = 0; i < function->type.argument_count; i++) types[i + 1] = debug_type(ctx, function->type.arguments[i]);
+    LLVMMetadataRef subroutine_type = LLVMDIBuilderCreateSubroutineType(debug->builder, debug->file, types, function->type.argument_count + 1, LLVMDIFlagZero);
+
+    unsigned line, column;
+    resolve_loc(debug, diag_loc, &line, &column);
+    size_t name_length = strlen(function->name);
+    LLVMMetadataRef subprogram = LLVMDIBuilderCreateFunction(debug->builder, debug->file, function->name, name_length, function->name, name_length, debug->file, line, subroutine_type, false, true, line, LLVMDIFlagPrototyped, false);
+    LLVMSetSubprogram(function->value, subprogram);
+    debug->scope = subprogram;
+    gen_debug_location(ctx, diag_loc);
+}
+
+void gen_debug_function_exit(gen_context_t *ctx) {
+    if(ctx->debug == NULL) return;
+    ctx->debug->scope = ctx->debug->compile_unit;
+    LLVMSetCurrentDebugLocation2(ctx->builder, NULL);
+}
+
+LLVMMetadataRef gen_debug_block_enter(gen_context_t *ctx, diag_loc_t diag_loc) {
+    if(ctx->debug == NULL) return NULL;
+    unsigned line, column;
+    resolve_loc(ctx->debug, diag_loc, &line, &column);
+    LLVMMetadataRef outer = ctx->debug->scope;
+    ctx->debug->scope = LLVMDIBuilderCreateLexicalBlock(ctx->debug->builder, outer, ctx->debug->file, line, column);
+    return outer;
+}
+
+void gen_debug_block_exit(gen_context_t *ctx, LLVMMetadataRef outer) {
+    if(ctx->debug == NULL) return;
+    ctx->debug->scope = outer;
+}
+
+void gen_debug_location(gen_context_t *ctx, diag_loc_t diag_loc) {
+    if(ctx->debug == NULL || !diag_loc.present) return;
+    unsigned line, column;
+    resolve_loc(ctx->debug, diag_loc, &line, &column);
+    LLVMSetCurrentDebugLocation2(ctx->builder, LLVMDIBuilderCreateDebugLocation(ctx->context, line, column, ctx->debug->scope, NULL));
+}
+
+void gen_debug_variable(gen_context_t *ctx, const char *name, ir_type_t *type, LLVMValueRef storage, size_t argument_number, diag_loc_t diag_loc) {
+    if(ctx->debug == NULL) return;
+    gen_debug_t *debug = ctx->debug;
+
+    unsigned line, column;
+    resolve_loc(debug, diag_loc, &line, &column);
+    LLVMMetadataRef variable;
+    if(argument_number > 0) {
+        variable = LLVMDIBuilderCreateParameterVariable(debug->builder, debug->scope, name, strlen(name), argument_number, debug->file, line, debug_type(ctx, type), true, LLVMDIFlagZero);
+    } else {
+        variable = LLVMDIBuilderCreateAutoVariable(debug->builder, debug->scope, name, strlen(name), debug->file, line, debug_type(ctx, type), true, LLVMDIFlagZero, 0);
+    }
+    LLVMMetadataRef location = LLVMDIBuilderCreateDebugLocation(ctx->context, line, column, debug->scope, NULL);
+    LLVMDIBuilderInsertDeclareAtEnd(debug->builder, storage, variable, LLVMDIBuilderCreateExpression(debug->builder, NULL, 0), location, LLVMGetInsertBlock(ctx->builder));
+}
+
+void gen_debug_global_variable(gen_context_t *ctx, const char *name, ir_type_t *type, LLVMValueRef global, diag_loc_t diag_loc) {
+    if(ctx->debug == NULL) return;
+    gen_debug_t *debug = ctx->debug;
+
+    unsigned line, column;
+    resolve_loc(debug, diag_loc, &line, &column);
+    size_t name_length = strlen(name);
+    LLVMMetadataRef expression = LLVMDIBuilderCreateGlobalVariableExpression(debug->builder, debug->compile_unit, name, name_length, name, name_length, debug->file, line, debug_type(ctx, type), false, LLVMDIBuilderCreateExpression(debug->builder, NULL, 0), NULL, 0);
+    LLVMGlobalSetMetadata(global, LLVMGetMDKindIDInContext(ctx->context, "dbg", 3), expression);
+}
\ No newline at end of file
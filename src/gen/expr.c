@@ -1,4 +1,5 @@
 #include "gen.h"
+#include "../ir/eval.h"
 
 static gen_value_t gen_expr_literal_numeric(gen_context_t *ctx, ir_node_t *node) {
     return (gen_value_t) {
@@ -28,24 +29,145 @@ static gen_value_t gen_expr_literal_bool(gen_context_t *ctx, ir_node_t *node) {
     };
 }
 
+static gen_value_t gen_expr_address(gen_context_t *ctx, ir_node_t *node);
+
+// What an address is known to be aligned to, packed structs can leave it below the type's own alignment
+static size_t known_align(gen_value_t address) {
+    return address.align != 0 ? address.align : ir_type_align(address.type);
+}
+
+static gen_value_t with_align(gen_value_t address, size_t align) {
+    address.align = align < ir_type_align(address.type) ? align : 0;
+    return address;
+}
+
+static LLVMValueRef build_load(gen_context_t *ctx, gen_value_t address) {
+    LLVMValueRef load = LLVMBuildLoad2(ctx->builder, gen_llvm_type(ctx, address.type), address.value, "");
+    if(address.align != 0) LLVMSetAlignment(load, address.align);
+    return load;
+}
+
+// Vectors behind pointers usually point into arrays of their elements, nothing more than the element's alignment is assumed
+static gen_value_t pointee(ir_type_t *type, LLVMValueRef address) {
+    gen_value_t target = { .type = type, .value = address };
+    if(ir_type_is_kind(type, IR_TYPE_KIND_VECTOR)) target = with_align(target, ir_type_align(type->vector.base));
+    return target;
+}
+
+static bool is_addressable(ir_node_t *node) {
+    if(node->type == IR_NODE_TYPE_EXPR_VAR || node->type == IR_NODE_TYPE_EXPR_INDEX || node->type == IR_NODE_TYPE_EXPR_MEMBER) return true;
+    return node->type == IR_NODE_TYPE_EXPR_UNARY && node->expr_unary.operation == IR_UNARY_OPERATION_DEREF;
+}
+
+// Arrays are indexed where they are stored and pointers are loaded first, either way it is one inbounds GEP
+static gen_value_t gen_expr_element(gen_context_t *ctx, ir_node_t *node) {
+    ir_node_t *base = node->expr_index.value;
+    ir_type_t *type;
+    LLVMValueRef address;
+    size_t align = 0;
+    if(is_addressable(base)) {
+        gen_value_t storage = gen_expr_address(ctx, base);
+        type = storage.type;
+        address = storage.value;
+        align = known_align(storage);
+        if(ir_type_is_kind(type, IR_TYPE_KIND_POINTER)) {
+            address = build_load(ctx, storage);
+            align = 0;
+        }
+    } else {
+        gen_value_t pointer = gen_expr(ctx, base, NULL);
+        if(ir_type_is_kind(pointer.type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "only arrays stored in variables can be indexed");
+        type = pointer.type;
+        address = pointer.value;
+    }
+    bool is_array = ir_type_is_kind(type, IR_TYPE_KIND_ARRAY);
+    if(!is_array && !ir_type_is_kind(type, IR_TYPE_KIND_POINTER)) diag_error(node->diag_loc, "indexed value is neither an array nor a pointer");
+    ir_type_t *element_type = is_array ? type->array.base : type->pointer.base;
+    if(ir_type_is_void(element_type)) diag_error(node->diag_loc, "indexing a void pointer");
+    if(ir_type_is_incomplete(element_type)) diag_error(node->diag_loc, "indexing a pointer to the incomplete struct '%s'", element_type->structure.name);
+
+    ir_node_t *index_node = node->expr_index.index;
+    gen_value_t index = gen_expr(ctx, index_node, NULL);
+    if(!ir_type_is_kind(index.type, IR_TYPE_KIND_INTEGER)) diag_error(index_node->diag_loc, "array index is not an integer");
+    if(is_array && index_node->type == IR_NODE_TYPE_EXPR_LITERAL_NUMERIC && index_node->expr_literal.numeric_value >= type->array.count) {
+        diag_error(index_node->diag_loc, "index %lu is out of bounds of an array of %lu", index_node->expr_literal.numeric_value, type->array.count);
+    }
+    LLVMValueRef offset = index.value;
+    if(index.type->integer.bit_size < 64) {
+        offset = index.type->integer.is_signed ? LLVMBuildSExt(ctx->builder, offset, ctx->types.int64, "index.sext") : LLVMBuildZExt(ctx->builder, offset, ctx->types.int64, "index.zext");
+    }
+
+    if(is_array) {
+        LLVMValueRef indices[] = { LLVMConstInt(ctx->types.int64, 0, false), offset };
+        address = LLVMBuildInBoundsGEP2(ctx->builder, gen_llvm_type(ctx, type), address, indices, 2, "index");
+        // Any element, so only what the array's alignment and the element size have in common
+        size_t size = ir_type_size(element_type);
+        return with_align((gen_value_t) { .type = element_type, .value = address }, (align | size) & -(align | size));
+    }
+    address = LLVMBuildInBoundsGEP2(ctx->builder, gen_llvm_type(ctx, element_type), address, &offset, 1, "index");
+    return pointee(element_type, address);
+}
+
+static ir_type_field_t *find_field(ir_node_t *node, ir_type_t *type) {
+    if(!ir_type_is_kind(type, IR_TYPE_KIND_STRUCT)) diag_error(node->diag_loc, "member access on a value that is neither a struct nor a pointer to one");
+    if(!type->structure.is_complete) diag_error(node->diag_loc, "member access on the incomplete struct '%s'", type->structure.name);
+    ir_type_field_t *field = ir_type_find_field(type, node->expr_member.name);
+    if(field == NULL) diag_error(node->diag_loc, "struct '%s' has no field '%s'", type->structure.name, node->expr_member.name);
+    return field;
+}
+
+// Fields sit at a constant offset from the struct, what is known of its alignment carries over
+static gen_value_t field_address(gen_context_t *ctx, ir_node_t *node, gen_value_t container) {
+    ir_type_field_t *field = find_field(node, container.type);
+    unsigned element = gen_struct_element(container.type, field - container.type->structure.fields);
+    LLVMValueRef address = LLVMBuildStructGEP2(ctx->builder, gen_llvm_type(ctx, container.type), container.value, element, field->name);
+    size_t align = known_align(container) | field->offset;
+    return with_align((gen_value_t) { .type = field->type, .value = address }, align & -align);
+}
+
+// `.` reaches through one pointer like `->` would
+static gen_value_t gen_expr_field(gen_context_t *ctx, ir_node_t *node) {
+    ir_node_t *base = node->expr_member.value;
+    if(is_addressable(base)) {
+        gen_value_t container = gen_expr_address(ctx, base);
+        if(ir_type_is_kind(container.type, IR_TYPE_KIND_POINTER)) container = (gen_value_t) { .type = container.type->pointer.base, .value = build_load(ctx, container) };
+        return field_address(ctx, node, container);
+    }
+    gen_value_t pointer = gen_expr(ctx, base, NULL);
+    if(!ir_type_is_kind(pointer.type, IR_TYPE_KIND_POINTER)) diag_error(node->diag_loc, "expression is not assignable");
+    return field_address(ctx, node, (gen_value_t) { .type = pointer.type->pointer.base, .value = pointer.value });
+}
+
+
+// Storage of an assignable expression, the value is its address and the type what is stored there
+static gen_value_t gen_expr_address(gen_context_t *ctx, ir_node_t *node) {
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_VAR:
+            gen_variable_t *var = gen_get_variable(ctx, node->expr_var.name);
+            if(var == NULL) diag_error(node->diag_loc, "reference to an undefined variable '%s'", node->expr_var.name);
+            return (gen_value_t) { .type = var->type, .value = var->value };
+        case IR_NODE_TYPE_EXPR_INDEX: return gen_expr_element(ctx, node);
+        case IR_NODE_TYPE_EXPR_MEMBER: return gen_expr_field(ctx, node);
+        case IR_NODE_TYPE_EXPR_UNARY:
+            if(node->expr_unary.operation != IR_UNARY_OPERATION_DEREF) break;
+            gen_value_t pointer = gen_expr(ctx, node->expr_unary.operand, NULL);
+            if(!ir_type_is_kind(pointer.type, IR_TYPE_KIND_POINTER)) diag_error(node->diag_loc, "cannot dereference a non-pointer");
+            return pointee(pointer.type->pointer.base, pointer.value);
+        default: break;
+    }
+    diag_error(node->diag_loc, "expression is not assignable");
+}
+
 static gen_value_t gen_expr_binary(gen_context_t *ctx, ir_node_t *node) {
     gen_value_t right = gen_expr(ctx, node->expr_binary.right, NULL); // TODO: NULL?
     if(ir_type_is_void(right.type)) diag_error(node->diag_loc, "rhs of binary expression is void");
 
     if(node->expr_binary.operation == IR_BINARY_OPERATION_ASSIGN) {
-        switch(node->expr_binary.left->type) {
-            case IR_NODE_TYPE_EXPR_VAR:
-                gen_variable_t *var = gen_scope_get_variable(ctx->scope, node->expr_binary.left->expr_var.name);
-                if(!ir_type_is_eq(var->type, right.type)) diag_error(node->diag_loc, "conflicting types in assignment");
-                LLVMBuildStore(ctx->builder, right.value, var->value);
-                return right;
-            case IR_NODE_TYPE_EXPR_UNARY:
-                assert(node->expr_binary.left->expr_unary.operation == IR_UNARY_OPERATION_DEREF);
-                gen_value_t value = gen_expr(ctx, node->expr_binary.left->expr_unary.operand, ir_type_make_pointer(right.type));
-                LLVMBuildStore(ctx->builder, right.value, value.value);
-                return right;
-            default: assert(false);
-        }
+        gen_value_t target = gen_expr_address(ctx, node->expr_binary.left);
+        if(!ir_type_is_eq(target.type, right.type)) diag_error(node->diag_loc, "conflicting types in assignment");
+        LLVMValueRef store = LLVMBuildStore(ctx->builder, right.value, target.value);
+        if(target.align != 0) LLVMSetAlignment(store, target.align);
+        return right;
     }
 
     ir_type_t *type = right.type;
@@ -53,21 +175,27 @@ static gen_value_t gen_expr_binary(gen_context_t *ctx, ir_node_t *node) {
     gen_value_t left = gen_expr(ctx, node->expr_binary.left, NULL); // TODO: NULL?
     if(!ir_type_is_eq(type, left.type)) diag_error(node->diag_loc, "conflicting types in binary expression");
     if(ir_type_is_void(type)) diag_error(node->diag_loc, "void in binary expression");
+    if(ir_type_is_kind(type, IR_TYPE_KIND_ARRAY) || ir_type_is_kind(type, IR_TYPE_KIND_STRUCT)) diag_error(node->diag_loc, "invalid type in binary expression");
+
+    // Vectors work element by element, comparing them gives a mask of the same length
+    bool is_vector = ir_type_is_kind(type, IR_TYPE_KIND_VECTOR);
+    ir_type_t *scalar_type = is_vector ? type->vector.base : type;
+    ir_type_t *bool_type = is_vector ? ir_type_make_vector(ir_type_get_bool(), type->vector.count) : ir_type_get_bool();
 
     switch(node->expr_binary.operation) {
         case IR_BINARY_OPERATION_EQUAL: return (gen_value_t) {
-            .type = ir_type_get_bool(),
+            .type = bool_type,
             .value = LLVMBuildICmp(ctx->builder, LLVMIntEQ, left.value, right.value, "expr.binary.eq")
         };
         case IR_BINARY_OPERATION_NOT_EQUAL: return (gen_value_t) {
-            .type = ir_type_get_bool(),
+            .type = bool_type,
             .value = LLVMBuildICmp(ctx->builder, LLVMIntNE, left.value, right.value, "expr.binary.ne")
         };
         default: break;
     }
 
-    if(!ir_type_is_kind(type, IR_TYPE_KIND_INTEGER)) diag_error(node->diag_loc, "invalid type in binary expression");
-    bool is_signed = type->integer.is_signed;
+    if(!ir_type_is_kind(scalar_type, IR_TYPE_KIND_INTEGER)) diag_error(node->diag_loc, "invalid type in binary expression");
+    bool is_signed = scalar_type->integer.is_signed;
 
     switch(node->expr_binary.operation) {
         case IR_BINARY_OPERATION_ADDITION: return (gen_value_t) {
@@ -91,19 +219,19 @@ static gen_value_t gen_expr_binary(gen_context_t *ctx, ir_node_t *node) {
             .value = is_signed ? LLVMBuildSRem(ctx->builder, left.value, right.value, "expr.binary.srem") : LLVMBuildURem(ctx->builder, left.value, right.value, "expr.binary.urem")
         };
         case IR_BINARY_OPERATION_GREATER: return (gen_value_t) {
-            .type = ir_type_get_bool(),
+            .type = bool_type,
             .value = LLVMBuildICmp(ctx->builder, is_signed ? LLVMIntSGT : LLVMIntUGT, left.value, right.value, "expr.binary.gt")
         };
         case IR_BINARY_OPERATION_GREATER_EQUAL: return (gen_value_t) {
-            .type = ir_type_get_bool(),
+            .type = bool_type,
             .value = LLVMBuildICmp(ctx->builder, is_signed ? LLVMIntSGE : LLVMIntUGE, left.value, right.value, "expr.binary.ge")
         };
         case IR_BINARY_OPERATION_LESS: return (gen_value_t) {
-            .type = ir_type_get_bool(),
+            .type = bool_type,
             .value = LLVMBuildICmp(ctx->builder, is_signed ? LLVMIntSLT : LLVMIntULT, left.value, right.value, "expr.binary.lt")
         };
         case IR_BINARY_OPERATION_LESS_EQUAL: return (gen_value_t) {
-            .type = ir_type_get_bool(),
+            .type = bool_type,
             .value = LLVMBuildICmp(ctx->builder, is_signed ? LLVMIntSLE : LLVMIntULE, left.value, right.value, "expr.binary.le")
         };
         default: assert(false);
@@ -112,26 +240,24 @@ static gen_value_t gen_expr_binary(gen_context_t *ctx, ir_node_t *node) {
 
 static gen_value_t gen_expr_unary(gen_context_t *ctx, ir_node_t *node) {
     if(node->expr_unary.operation == IR_UNARY_OPERATION_REF) {
-        assert(node->expr_unary.operand->type == IR_NODE_TYPE_EXPR_VAR);
-        gen_variable_t *var = gen_scope_get_variable(ctx->scope, node->expr_unary.operand->expr_var.name);
+        gen_value_t target = gen_expr_address(ctx, node->expr_unary.operand);
         return (gen_value_t) {
-            .type = ir_type_make_pointer(var->type),
-            .value = var->value
+            .type = ir_type_make_pointer(target.type),
+            .value = target.value
         };
     }
 
     gen_value_t operand = gen_expr(ctx, node->expr_unary.operand, NULL); // TODO: NULL?
+    if(ir_type_is_kind(operand.type, IR_TYPE_KIND_ARRAY) || ir_type_is_kind(operand.type, IR_TYPE_KIND_STRUCT)) diag_error(node->diag_loc, "invalid type in unary expression");
     switch(node->expr_unary.operation) {
         case IR_UNARY_OPERATION_DEREF:
             assert(ir_type_is_kind(operand.type, IR_TYPE_KIND_POINTER));
             ir_type_t *type = operand.type->pointer.base;
-            return (gen_value_t) {
-                .type = type,
-                .value = LLVMBuildLoad2(ctx->builder, gen_llvm_type(ctx, type), operand.value, "")
-            };
+            if(ir_type_is_incomplete(type)) diag_error(node->diag_loc, "dereferencing a pointer to the incomplete struct '%s'", type->structure.name);
+            return (gen_value_t) { .type = type, .value = build_load(ctx, pointee(type, operand.value)) };
         case IR_UNARY_OPERATION_NOT: return (gen_value_t) {
-            .type = ir_type_get_bool(),
-            .value = LLVMBuildICmp(ctx->builder, LLVMIntEQ, operand.value, LLVMConstInt(gen_llvm_type(ctx, operand.type), 0, false), "")
+            .type = ir_type_is_kind(operand.type, IR_TYPE_KIND_VECTOR) ? ir_type_make_vector(ir_type_get_bool(), operand.type->vector.count) : ir_type_get_bool(),
+            .value = LLVMBuildICmp(ctx->builder, LLVMIntEQ, operand.value, LLVMConstNull(gen_llvm_type(ctx, operand.type)), "")
         };
         case IR_UNARY_OPERATION_NEGATIVE: return (gen_value_t) {
             .type = operand.type,
@@ -142,56 +268,239 @@ static gen_value_t gen_expr_unary(gen_context_t *ctx, ir_node_t *node) {
 }
 
 static gen_value_t gen_expr_var(gen_context_t *ctx, ir_node_t *node) {
-    gen_variable_t *var = gen_scope_get_variable(ctx->scope, node->expr_var.name);
+    gen_variable_t *var = gen_get_variable(ctx, node->expr_var.name);
+    if(var == NULL) diag_error(node->diag_loc, "reference to an undefined variable '%s'", node->expr_var.name);
     return (gen_value_t) {
         .type = var->type,
         .value = LLVMBuildLoad2(ctx->builder, gen_llvm_type(ctx, var->type), var->value, "")
     };
 }
 
+static gen_value_t gen_expr_index(gen_context_t *ctx, ir_node_t *node) {
+    gen_value_t element = gen_expr_element(ctx, node);
+    return (gen_value_t) { .type = element.type, .value = build_load(ctx, element) };
+}
+
+// Struct values that were never stored anywhere, like a call's result, have their field extracted instead
+static gen_value_t gen_expr_member(gen_context_t *ctx, ir_node_t *node) {
+    ir_node_t *base = node->expr_member.value;
+    if(is_addressable(base)) {
+        gen_value_t field = gen_expr_field(ctx, node);
+        return (gen_value_t) { .type = field.type, .value = build_load(ctx, field) };
+    }
+    gen_value_t value = gen_expr(ctx, base, NULL);
+    if(ir_type_is_kind(value.type, IR_TYPE_KIND_POINTER)) {
+        gen_value_t field = field_address(ctx, node, (gen_value_t) { .type = value.type->pointer.base, .value = value.value });
+        return (gen_value_t) { .type = field.type, .value = build_load(ctx, field) };
+    }
+    ir_type_field_t *field = find_field(node, value.type);
+    return (gen_value_t) {
+        .type = field->type,
+        .value = LLVMBuildExtractValue(ctx->builder, value.value, gen_struct_element(value.type, field - value.type->structure.fields), field->name)
+    };
+}
+
+static ir_node_t *find_global(const char *name, void *data) {
+    return gen_get_definition((gen_context_t *) data, name);
+}
+
+static gen_value_t gen_expr_comptime(gen_context_t *ctx, ir_node_t *node) {
+    trace_begin("comptime", NULL);
+    ir_eval_value_t value = ir_eval(node, &(ir_eval_options_t) { .find_global = find_global, .data = ctx, .step_limit = ctx->comptime_steps });
+    trace_end("comptime", NULL);
+    if(ir_type_is_void(value.type)) return (gen_value_t) { .type = value.type, .value = NULL };
+    LLVMValueRef constant = gen_const(ctx, value);
+    ir_eval_value_free(value);
+    return (gen_value_t) { .type = value.type, .value = constant };
+}
+
+typedef enum {
+    BUILTIN_SHUFFLE,
+    BUILTIN_SELECT,
+    BUILTIN_EXTRACT,
+    BUILTIN_INSERT,
+    BUILTIN_REDUCE_ADD,
+    BUILTIN_REDUCE_MUL,
+    BUILTIN_REDUCE_MIN,
+    BUILTIN_REDUCE_MAX,
+    BUILTIN_ANY,
+    BUILTIN_ALL,
+    BUILTIN_COUNT
+} builtin_t;
+
+// Vector operations that are not operators, a function of the same name takes precedence
+static const struct {
+    const char *name;
+    size_t argument_count; // shuffle takes its lane indices after this many
+} g_builtins[] = {
+    [BUILTIN_SHUFFLE] = { "shuffle", 2 },
+    [BUILTIN_SELECT] = { "select", 3 },
+    [BUILTIN_EXTRACT] = { "extract", 2 },
+    [BUILTIN_INSERT] = { "insert", 3 },
+    [BUILTIN_REDUCE_ADD] = { "reduce_add", 1 },
+    [BUILTIN_REDUCE_MUL] = { "reduce_mul", 1 },
+    [BUILTIN_REDUCE_MIN] = { "reduce_min", 1 },
+    [BUILTIN_REDUCE_MAX] = { "reduce_max", 1 },
+    [BUILTIN_ANY] = { "any", 1 },
+    [BUILTIN_ALL] = { "all", 1 }
+};
+
+static gen_value_t builtin_vector(gen_context_t *ctx, ir_node_t *node, size_t argument) {
+    gen_value_t value = gen_expr(ctx, node->expr_call.arguments[argument], NULL);
+    if(!ir_type_is_kind(value.type, IR_TYPE_KIND_VECTOR)) diag_error(node->expr_call.arguments[argument]->diag_loc, "argument %lu of '%s' is not a vector", argument + 1, node->expr_call.name);
+    return value;
+}
+
+static gen_value_t builtin_mask(gen_context_t *ctx, ir_node_t *node, size_t argument) {
+    gen_value_t value = builtin_vector(ctx, node, argument);
+    if(!ir_type_is_eq(value.type->vector.base, ir_type_get_bool())) diag_error(node->expr_call.arguments[argument]->diag_loc, "argument %lu of '%s' is not a mask", argument + 1, node->expr_call.name);
+    return value;
+}
+
+static LLVMValueRef builtin_lane(gen_context_t *ctx, ir_node_t *node, size_t argument, ir_type_t *type) {
+    ir_node_t *index_node = node->expr_call.arguments[argument];
+    gen_value_t index = gen_expr(ctx, index_node, NULL);
+    if(!ir_type_is_kind(index.type, IR_TYPE_KIND_INTEGER)) diag_error(index_node->diag_loc, "vector index is not an integer");
+    if(index_node->type == IR_NODE_TYPE_EXPR_LITERAL_NUMERIC && index_node->expr_literal.numeric_value >= type->vector.count) {
+        diag_error(index_node->diag_loc, "index %lu is out of bounds of a vector of %lu", index_node->expr_literal.numeric_value, type->vector.count);
+    }
+    return index.value;
+}
+
+static LLVMValueRef build_reduce(gen_context_t *ctx, const char *intrinsic, gen_value_t vector) {
+    unsigned id = LLVMLookupIntrinsicID(intrinsic, strlen(intrinsic));
+    LLVMTypeRef vector_type = gen_llvm_type(ctx, vector.type);
+    LLVMValueRef function = LLVMGetIntrinsicDeclaration(ctx->module, id, &vector_type, 1);
+    return LLVMBuildCall2(ctx->builder, LLVMIntrinsicGetType(ctx->context, id, &vector_type, 1), function, &vector.value, 1, "");
+}
+
+static gen_value_t gen_expr_builtin(gen_context_t *ctx, ir_node_t *node, builtin_t builtin) {
+    size_t argument_count = node->expr_call.argument_count;
+    if(builtin == BUILTIN_SHUFFLE ? argument_count <= g_builtins[builtin].argument_count : argument_count != g_builtins[builtin].argument_count) diag_error(node->diag_loc, "invalid number of arguments");
+    switch(builtin) {
+        case BUILTIN_SHUFFLE: {
+            // Lanes are picked from both vectors as if they were one twice as long, the result is as long as the list
+            gen_value_t left = builtin_vector(ctx, node, 0);
+            gen_value_t right = gen_expr(ctx, node->expr_call.arguments[1], left.type);
+            size_t count = argument_count - 2;
+            if((count & (count - 1)) != 0 || count > 64) diag_error(node->diag_loc, "vector length must be a power of two up to 64");
+            LLVMValueRef lanes[count];
+            for(size_t i = 0; i < count; i++) {
+                ir_node_t *lane = node->expr_call.arguments[i + 2];
+                if(lane->type != IR_NODE_TYPE_EXPR_LITERAL_NUMERIC) diag_error(lane->diag_loc, "shuffle lanes must be number literals");
+                if(lane->expr_literal.numeric_value >= left.type->vector.count * 2) diag_error(lane->diag_loc, "lane %lu is out of bounds of two vectors of %lu", lane->expr_literal.numeric_value, left.type->vector.count);
+                lanes[i] = LLVMConstInt(ctx->types.int32, lane->expr_literal.numeric_value, false);
+            }
+            return (gen_value_t) {
+                .type = ir_type_make_vector(left.type->vector.base, count),
+                .value = LLVMBuildShuffleVector(ctx->builder, left.value, right.value, LLVMConstVector(lanes, count), "shuffle")
+            };
+        }
+        case BUILTIN_SELECT: {
+            gen_value_t mask = builtin_mask(ctx, node, 0);
+            gen_value_t left = builtin_vector(ctx, node, 1);
+            gen_value_t right = gen_expr(ctx, node->expr_call.arguments[2], left.type);
+            if(mask.type->vector.count != left.type->vector.count) diag_error(node->diag_loc, "mask and vectors differ in length");
+            return (gen_value_t) { .type = left.type, .value = LLVMBuildSelect(ctx->builder, mask.value, left.value, right.value, "select") };
+        }
+        case BUILTIN_EXTRACT: {
+            gen_value_t vector = builtin_vector(ctx, node, 0);
+            LLVMValueRef index = builtin_lane(ctx, node, 1, vector.type);
+            return (gen_value_t) { .type = vector.type->vector.base, .value = LLVMBuildExtractElement(ctx->builder, vector.value, index, "extract") };
+        }
+        case BUILTIN_INSERT: {
+            gen_value_t vector = builtin_vector(ctx, node, 0);
+            LLVMValueRef index = builtin_lane(ctx, node, 1, vector.type);
+            gen_value_t element = gen_expr(ctx, node->expr_call.arguments[2], vector.type->vector.base);
+            return (gen_value_t) { .type = vector.type, .value = LLVMBuildInsertElement(ctx->builder, vector.value, element.value, index, "insert") };
+        }
+        case BUILTIN_ANY: return (gen_value_t) { .type = ir_type_get_bool(), .value = build_reduce(ctx, "llvm.vector.reduce.or", builtin_mask(ctx, node, 0)) };
+        case BUILTIN_ALL: return (gen_value_t) { .type = ir_type_get_bool(), .value = build_reduce(ctx, "llvm.vector.reduce.and", builtin_mask(ctx, node, 0)) };
+        default: break;
+    }
+    gen_value_t vector = builtin_vector(ctx, node, 0);
+    bool is_signed = vector.type->vector.base->integer.is_signed;
+    const char *intrinsic;
+    switch(builtin) {
+        case BUILTIN_REDUCE_ADD: intrinsic = "llvm.vector.reduce.add"; break;
+        case BUILTIN_REDUCE_MUL: intrinsic = "llvm.vector.reduce.mul"; break;
+        case BUILTIN_REDUCE_MIN: intrinsic = is_signed ? "llvm.vector.reduce.smin" : "llvm.vector.reduce.umin"; break;
+        case BUILTIN_REDUCE_MAX: intrinsic = is_signed ? "llvm.vector.reduce.smax" : "llvm.vector.reduce.umax"; break;
+        default: assert(false);
+    }
+    return (gen_value_t) { .type = vector.type->vector.base, .value = build_reduce(ctx, intrinsic, vector) };
+}
+
 static gen_value_t gen_expr_call(gen_context_t *ctx, ir_node_t *node) {
-    gen_function_t *function = gen_get_function(ctx, node->expr_call.name);
-    if(function == NULL) diag_error(node->diag_loc, "reference to an undefined function '%s'", node->expr_call.name);
-    if(node->expr_call.argument_count < function->type.argument_count) diag_error(node->diag_loc, "missing arguments");
-    if(!function->type.varargs && node->expr_call.argument_count > function->type.argument_count) diag_error(node->diag_loc, "invalid number of arguments");
+    // Calls to comptime functions are comptime expressions of their own
+    ir_node_t *definition = gen_get_definition(ctx, node->expr_call.name);
+    if(definition != NULL && definition->type == IR_NODE_TYPE_GLOBAL_FUNCTION && definition->global_function.is_comptime) return gen_expr_comptime(ctx, node);
+
+    gen_function_t *found = gen_get_function(ctx, node->expr_call.name);
+    if(found == NULL) {
+        for(size_t i = 0; i < BUILTIN_COUNT; i++) if(strcmp(g_builtins[i].name, node->expr_call.name) == 0) return gen_expr_builtin(ctx, node, i);
+        diag_error(node->diag_loc, "reference to an undefined function '%s'", node->expr_call.name);
+    }
+    // Copied, calls in the arguments can declare functions and move the function list
+    gen_function_t function = *found;
+    if(node->expr_call.argument_count < function.type.argument_count) diag_error(node->diag_loc, "missing arguments");
+    if(!function.type.varargs && node->expr_call.argument_count > function.type.argument_count) diag_error(node->diag_loc, "invalid number of arguments");
     LLVMValueRef args[node->expr_call.argument_count];
-    for(size_t i = 0; i < node->expr_call.argument_count; i++) args[i] = gen_expr(ctx, node->expr_call.arguments[i], function->type.arguments[i]).value;
+    for(size_t i = 0; i < node->expr_call.argument_count; i++) {
+        gen_value_t argument = gen_expr(ctx, node->expr_call.arguments[i], i < function.type.argument_count ? function.type.arguments[i] : NULL);
+        // Only externs are varargs, see parse_extern
+        if(i >= function.type.argument_count && ir_type_is_kind(argument.type, IR_TYPE_KIND_STRUCT)) diag_error(node->expr_call.arguments[i]->diag_loc, "struct passed by value to the varargs of '%s', pass a pointer", node->expr_call.name);
+        if(i >= function.type.argument_count && ir_type_is_kind(argument.type, IR_TYPE_KIND_ARRAY)) diag_error(node->expr_call.arguments[i]->diag_loc, "array passed by value to the varargs of '%s', pass a pointer to its first element", node->expr_call.name);
+        args[i] = argument.value;
+    }
     return (gen_value_t) {
-        .type = function->type.return_type,
-        .value = LLVMBuildCall2(ctx->builder, function->llvm_type, function->value, args, node->expr_call.argument_count, "")
+        .type = function.type.return_type,
+        .value = LLVMBuildCall2(ctx->builder, function.llvm_type, function.value, args, node->expr_call.argument_count, "")
     };
 }
 
+// `llvm_to_type` is a vector type when casting the elements of one
+static LLVMValueRef cast_integer(gen_context_t *ctx, LLVMValueRef value, ir_type_t *from_type, ir_type_t *to_type, LLVMTypeRef llvm_to_type) {
+    if(from_type->integer.bit_size == to_type->integer.bit_size) return value;
+    if(from_type->integer.bit_size > to_type->integer.bit_size) return LLVMBuildTrunc(ctx->builder, value, llvm_to_type, "cast.trunc");
+    if(to_type->integer.is_signed) return LLVMBuildSExt(ctx->builder, value, llvm_to_type, "cast.sext");
+    return LLVMBuildZExt(ctx->builder, value, llvm_to_type, "cast.zext");
+}
+
 static gen_value_t gen_expr_cast(gen_context_t *ctx, ir_node_t *node) {
     gen_value_t v = gen_expr(ctx, node->expr_cast.value, NULL);
 
     LLVMValueRef value = v.value;
     ir_type_t *to_type = node->expr_cast.type;
     ir_type_t *from_type = v.type;
-    if(to_type->kind != from_type->kind) diag_error(node->diag_loc, "cast of incompatible types");
-
     LLVMTypeRef llvm_to_type = gen_llvm_type(ctx, to_type);
 
+    // An integer cast to a vector is converted to the element type and splat across every lane
+    if(ir_type_is_kind(to_type, IR_TYPE_KIND_VECTOR) && ir_type_is_kind(from_type, IR_TYPE_KIND_INTEGER)) {
+        ir_type_t *base = to_type->vector.base;
+        value = cast_integer(ctx, value, from_type, base, gen_llvm_type(ctx, base));
+        value = LLVMBuildInsertElement(ctx->builder, LLVMGetUndef(llvm_to_type), value, LLVMConstInt(ctx->types.int32, 0, false), "");
+        LLVMValueRef lanes = LLVMConstNull(LLVMVectorType(ctx->types.int32, to_type->vector.count));
+        return (gen_value_t) { .type = to_type, .value = LLVMBuildShuffleVector(ctx->builder, value, LLVMGetUndef(llvm_to_type), lanes, "cast.splat") };
+    }
+    if(to_type->kind != from_type->kind) diag_error(node->diag_loc, "cast of incompatible types");
+
     switch(to_type->kind) {
         case IR_TYPE_KIND_VOID: diag_error(node->diag_loc, "void cast");
-        case IR_TYPE_KIND_INTEGER:
-            if(from_type->integer.bit_size == to_type->integer.bit_size) break;
-            if(from_type->integer.bit_size > to_type->integer.bit_size) {
-                value = LLVMBuildTrunc(ctx->builder, value, llvm_to_type, "cast.trunc");
-            } else {
-                if(to_type->integer.is_signed) {
-                    value = LLVMBuildSExt(ctx->builder, value, llvm_to_type, "cast.sext");
-                } else {
-                    value = LLVMBuildZExt(ctx->builder, value, llvm_to_type, "cast.zext");
-                }
-            }
-            break;
+        case IR_TYPE_KIND_INTEGER: value = cast_integer(ctx, value, from_type, to_type, llvm_to_type); break;
         case IR_TYPE_KIND_POINTER: break;
+        case IR_TYPE_KIND_ARRAY: diag_error(node->diag_loc, "array cast");
+        case IR_TYPE_KIND_STRUCT: diag_error(node->diag_loc, "struct cast");
+        case IR_TYPE_KIND_VECTOR:
+            if(from_type->vector.count != to_type->vector.count) diag_error(node->diag_loc, "cast between vectors of different lengths");
+            value = cast_integer(ctx, value, from_type->vector.base, to_type->vector.base, llvm_to_type);
+            break;
     }
     return (gen_value_t) { .type = to_type, .value = value };
 }
 
 gen_value_t gen_expr(gen_context_t *ctx, ir_node_t *node, ir_type_t *type_expected) {
+    gen_debug_location(ctx, node->diag_loc);
     gen_value_t value;
     switch(node->type) {
         case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC: value = gen_expr_literal_numeric(ctx, node); break;
@@ -203,6 +512,9 @@ gen_value_t gen_expr(gen_context_t *ctx, ir_node_t *node, ir_type_t *type_expect
         case IR_NODE_TYPE_EXPR_VAR: value = gen_expr_var(ctx, node); break;
         case IR_NODE_TYPE_EXPR_CALL: value = gen_expr_call(ctx, node); break;
         case IR_NODE_TYPE_EXPR_CAST: value = gen_expr_cast(ctx, node); break;
+        case IR_NODE_TYPE_EXPR_COMPTIME: value = gen_expr_comptime(ctx, node); break;
+        case IR_NODE_TYPE_EXPR_INDEX: value = gen_expr_index(ctx, node); break;
+        case IR_NODE_TYPE_EXPR_MEMBER: value = gen_expr_member(ctx, node); break;
         default: assert(false); // TODO: possibly separate expressions and statements
     }
     if(type_expected != NULL && !ir_type_is_eq(value.type, type_expected)) diag_error(node->diag_loc, "conflicting types");
@@ -1,7 +1,9 @@
 #include "gen.h"
+#include <stdio.h>
+#include <pthread.h>
 
 gen_function_t *gen_add_function(gen_context_t *ctx, gen_function_t function) {
-    ctx->functions = realloc(ctx->functions, sizeof(gen_function_t) * ++ctx->function_count);
+    ctx->functions = mem_realloc(MEM_SUBSYSTEM_CODEGEN, ctx->functions, sizeof(gen_function_t) * ++ctx->function_count);
     ctx->functions[ctx->function_count - 1] = function;
     return &ctx->functions[ctx->function_count - 1];
 }
@@ -11,11 +13,47 @@ gen_function_t *gen_get_function(gen_context_t *ctx, const char *name) {
         if(strcmp(name, ctx->functions[i].name) != 0) continue;
         return &ctx->functions[i];
     }
-    return NULL;
+    if(ctx->summary == NULL) return NULL;
+    gen_function_type_t type;
+    const char *symbol_name = gen_summary_find_function(ctx->summary, name, &type);
+    if(symbol_name == NULL) return NULL;
+    return gen_declare_function(ctx, symbol_name, type);
+}
+
+gen_variable_t *gen_get_variable(gen_context_t *ctx, const char *name) {
+    gen_variable_t *variable = gen_scope_get_variable(&ctx->scope, name);
+    if(variable != NULL) return variable;
+
+    // Global variables of the program first, then the ones earlier repl entries left in the summary
+    ir_type_t *type;
+    ir_node_t *definition = gen_get_definition(ctx, name);
+    if(definition != NULL && definition->type == IR_NODE_TYPE_GLOBAL_VARIABLE) {
+        type = definition->global_variable.type;
+        name = definition->global_variable.name;
+    } else {
+        gen_symbol_t *symbol = ctx->summary != NULL ? gen_summary_get(ctx->summary, name) : NULL;
+        if(symbol == NULL || symbol->is_function || symbol->variable == NULL) return NULL;
+        type = symbol->variable;
+        name = symbol->name;
+    }
+
+    // Bound in the current scope, an earlier lookup might have declared the global already
+    LLVMValueRef global = LLVMGetNamedGlobal(ctx->module, name);
+    if(global == NULL) {
+        global = LLVMAddGlobal(ctx->module, gen_llvm_type(ctx, type), name);
+        LLVMSetAlignment(global, ir_type_align(type));
+    }
+    return gen_scope_add_variable(&ctx->scope, type, name, global);
+}
+
+ir_node_t *gen_get_definition(gen_context_t *ctx, const char *name) {
+    gen_symbol_t *symbol = gen_summary_get(&ctx->definitions, name);
+    if(symbol == NULL && ctx->summary != NULL) symbol = gen_summary_get(ctx->summary, name);
+    return symbol != NULL ? symbol->definition : NULL;
 }
 
 void gen_enter_function(gen_context_t *ctx, ir_type_t *return_type) {
-    ctx->current_function = malloc(sizeof(gen_current_function_t));
+    ctx->current_function = mem_alloc(MEM_SUBSYSTEM_CODEGEN, sizeof(gen_current_function_t));
     ctx->current_function->has_return = false;
     ctx->current_function->return_type = return_type;
 }
@@ -25,7 +63,7 @@ gen_current_function_t *gen_current_function(gen_context_t *ctx) {
 }
 
 void gen_exit_function(gen_context_t *ctx) {
-    free(ctx->current_function);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, ctx->current_function);
     ctx->current_function = NULL;
 }
 
@@ -41,34 +79,345 @@ LLVMTypeRef gen_llvm_type(gen_context_t *ctx, ir_type_t *type) {
             case 64: return ctx->types.int64;
         }
     }
+    if(ir_type_is_kind(type, IR_TYPE_KIND_ARRAY)) return LLVMArrayType(gen_llvm_type(ctx, type->array.base), type->array.count);
+    if(ir_type_is_kind(type, IR_TYPE_KIND_VECTOR)) return LLVMVectorType(gen_llvm_type(ctx, type->vector.base), type->vector.count);
+    if(ir_type_is_kind(type, IR_TYPE_KIND_STRUCT)) {
+        // Packed with the padding spelled out, the layout is charon's and not whatever the target's would be
+        assert(type->structure.is_complete);
+        LLVMTypeRef elements[type->structure.field_count * 2 + 1];
+        unsigned count = 0;
+        size_t end = 0;
+        for(size_t i = 0; i < type->structure.field_count; i++) {
+            ir_type_field_t *field = &type->structure.fields[i];
+            if(field->offset > end) elements[count++] = LLVMArrayType(ctx->types.int8, field->offset - end);
+            elements[count++] = gen_llvm_type(ctx, field->type);
+            end = field->offset + ir_type_size(field->type);
+        }
+        if(type->structure.size > end) elements[count++] = LLVMArrayType(ctx->types.int8, type->structure.size - end);
+        return LLVMStructTypeInContext(ctx->context, elements, count, true);
+    }
     assert(false);
 }
 
-void gen(ir_node_t *ast, const char *dest, const char *passes) {
-    gen_context_t ctx = {};
-    ctx.context = LLVMContextCreate();
-    ctx.module = LLVMModuleCreateWithNameInContext("CharonModule", ctx.context);
-    ctx.builder = LLVMCreateBuilderInContext(ctx.context);
+static LLVMValueRef const_elements(gen_context_t *ctx, ir_type_t *type, const uint64_t *elements) {
+    if(!ir_type_is_kind(type, IR_TYPE_KIND_ARRAY)) return LLVMConstInt(gen_llvm_type(ctx, type), elements[0], false);
+    size_t stride = 1;
+    for(ir_type_t *base = type->array.base; ir_type_is_kind(base, IR_TYPE_KIND_ARRAY); base = base->array.base) stride *= base->array.count;
+    LLVMValueRef *values = mem_alloc(MEM_SUBSYSTEM_CODEGEN, sizeof(LLVMValueRef) * (type->array.count > 0 ? type->array.count : 1));
+    for(size_t i = 0; i < type->array.count; i++) values[i] = const_elements(ctx, type->array.base, elements + i * stride);
+    LLVMValueRef array = LLVMConstArray(gen_llvm_type(ctx, type->array.base), values, type->array.count);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, values);
+    return array;
+}
+
+// Constant for the result of a comptime evaluation, arrays are built from their flattened elements
+LLVMValueRef gen_const(gen_context_t *ctx, ir_eval_value_t value) {
+    if(value.elements != NULL) return const_elements(ctx, value.type, value.elements);
+    return LLVMConstInt(gen_llvm_type(ctx, value.type), value.bits, false);
+}
+
+// Index of a field among the elements of the struct's llvm type, padding counts as an element
+unsigned gen_struct_element(ir_type_t *type, size_t field) {
+    unsigned element = 0;
+    size_t end = 0;
+    for(size_t i = 0; i <= field; i++) {
+        if(type->structure.fields[i].offset > end) element++;
+        if(i < field) element++;
+        end = type->structure.fields[i].offset + ir_type_size(type->structure.fields[i].type);
+    }
+    return element;
+}
+
+static void set_llvm_options(gen_options_t *options) {
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static bool options_set = false;
+    pthread_mutex_lock(&lock);
+    if(options_set) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    options_set = true;
+
+    size_t count = 0;
+    const char *args[3];
+    args[count++] = "charon";
+    if(options->time_passes) args[count++] = "-time-passes";
+    if(options->profile_use != NULL) {
+        size_t length = snprintf(NULL, 0, "-pgo-test-profile-file=%s", options->profile_use) + 1;
+        char *arg = malloc(length);
+        snprintf(arg, length, "-pgo-test-profile-file=%s", options->profile_use);
+        args[count++] = arg;
+    }
+    LLVMParseCommandLineOptions(count, args, NULL);
+    pthread_mutex_unlock(&lock);
+}
+
+static char *make_pipeline(gen_options_t *options) {
+    // Instrumentation and profile use have to see the same, unoptimized, IR for the CFG hashes to match
+    const char *prefix = "";
+    if(options->profile_generate) prefix = "pgo-instr-gen,instrprof";
+    if(options->profile_use != NULL) prefix = "pgo-instr-use";
+    const char *separator = prefix[0] != '\0' && options->passes[0] != '\0' ? "," : "";
+
+    size_t length = strlen(prefix) + strlen(separator) + strlen(options->passes) + 1;
+    char *pipeline = malloc(length);
+    snprintf(pipeline, length, "%s%s%s", prefix, separator, options->passes);
+    return pipeline;
+}
+
+static thread_local gen_context_t *g_innermost = NULL;
+static thread_local size_t g_context_depth = 0;
+
+gen_context_t *gen_context_make(LLVMContextRef context, const char *module_name) {
+    gen_context_t *ctx = mem_alloc(MEM_SUBSYSTEM_CODEGEN, sizeof(gen_context_t));
+    *ctx = (gen_context_t) { .outer = g_innermost };
+    g_innermost = ctx;
+    g_context_depth++;
+    ctx->context = context;
+    ctx->module = LLVMModuleCreateWithNameInContext(module_name, ctx->context);
+    ctx->builder = LLVMCreateBuilderInContext(ctx->context);
+
+    ctx->types.void_ = LLVMVoidTypeInContext(ctx->context);
+    ctx->types.pointer = LLVMPointerTypeInContext(ctx->context, 0);
+    ctx->types.int1 = LLVMInt1TypeInContext(ctx->context);
+    ctx->types.int8 = LLVMInt8TypeInContext(ctx->context);
+    ctx->types.int16 = LLVMInt16TypeInContext(ctx->context);
+    ctx->types.int32 = LLVMInt32TypeInContext(ctx->context);
+    ctx->types.int64 = LLVMInt64TypeInContext(ctx->context);
+    return ctx;
+}
+
+// The module is not freed, it is what the context was made for
+void gen_context_free(gen_context_t *ctx) {
+    assert(ctx == g_innermost);
+    g_innermost = ctx->outer;
+    g_context_depth--;
+    // Already done for finished modules, an abandoned one still has to resolve its temporary metadata
+    gen_debug_finalize(ctx);
+    gen_scope_free(&ctx->scope);
+    gen_summary_free(&ctx->definitions);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, ctx->functions);
+    LLVMDisposeBuilder(ctx->builder);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, ctx);
+}
+
+size_t gen_context_depth() {
+    return g_context_depth;
+}
+
+// Contexts an error left behind never finish their module, it goes with them
+void gen_context_unwind(size_t depth) {
+    while(g_context_depth > depth) {
+        LLVMModuleRef module = g_innermost->module;
+        gen_context_free(g_innermost);
+        LLVMDisposeModule(module);
+    }
+}
+
+typedef struct {
+    gen_context_t *ctx;
+    ir_node_t *function;
+    bool is_declared;
+} callee_check_t;
+
+static void check_callee(ir_node_t *node, void *data) {
+    callee_check_t *check = data;
+    if(node->type != IR_NODE_TYPE_EXPR_CALL || !check->is_declared) return;
+    const char *name = node->expr_call.name;
+    if(strcmp(name, check->function->global_function.decl.name) == 0) return;
+    ir_node_t *definition = gen_get_definition(check->ctx, name);
+    if(definition != NULL && definition->type == IR_NODE_TYPE_GLOBAL_FUNCTION && definition->global_function.is_comptime) return;
+    for(size_t i = 0; i < check->ctx->function_count; i++) if(strcmp(name, check->ctx->functions[i].name) == 0) return;
+    gen_function_type_t type;
+    check->is_declared = check->ctx->summary != NULL && gen_summary_find_function(check->ctx->summary, name, &type) != NULL;
+}
+
+LLVMModuleRef gen_module_stream(gen_next_global_t next, void *data, source_t *source, LLVMContextRef context, gen_options_t *options) {
+    gen_context_t *ctx = gen_context_make(context, "CharonModule");
+    ctx->summary = options->summary;
+    ctx->comptime_steps = options->comptime_steps != 0 ? options->comptime_steps : GEN_COMPTIME_STEPS;
+    if(options->debug) gen_debug_init(ctx, source);
+
+    trace_begin("gen", NULL);
+    // Without a summary a function can arrive before its callees, it is declared right away and lowered once the stream ends
+    size_t deferred_count = 0;
+    ir_node_t **deferred = NULL;
+    for(ir_node_t *node; (node = next(data)) != NULL;) {
+        if(node->type != IR_NODE_TYPE_GLOBAL_IMPORT && node->type != IR_NODE_TYPE_GLOBAL_STRUCT) gen_summary_add_definition(&ctx->definitions, node);
+        // Comptime functions are only ever evaluated, there is nothing to lower or defer
+        if(node->type == IR_NODE_TYPE_GLOBAL_FUNCTION && node->global_function.is_comptime) continue;
+        callee_check_t check = { .ctx = ctx, .function = node, .is_declared = true };
+        if(node->type == IR_NODE_TYPE_GLOBAL_FUNCTION) ir_node_visit(node->global_function.body, check_callee, &check);
+        if(check.is_declared) {
+            gen_global(ctx, node);
+            continue;
+        }
+        if(gen_get_function(ctx, node->global_function.decl.name) == NULL) gen_declare_function(ctx, node->global_function.decl.name, gen_make_function_type(&node->global_function.decl));
+        deferred = mem_realloc(MEM_SUBSYSTEM_CODEGEN, deferred, sizeof(ir_node_t *) * ++deferred_count);
+        deferred[deferred_count - 1] = node;
+    }
+    for(size_t i = 0; i < deferred_count; i++) gen_global(ctx, deferred[i]);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, deferred);
+
+    ctx->current_function = NULL;
+    gen_debug_finalize(ctx);
+    trace_end("gen", NULL);
+
+    LLVMModuleRef module = ctx->module;
+    gen_context_free(ctx);
+    return module;
+}
+
+typedef struct {
+    ir_node_t *ast;
+    size_t index;
+} program_cursor_t;
 
-    ctx.types.void_ = LLVMVoidTypeInContext(ctx.context);
-    ctx.types.pointer = LLVMPointerTypeInContext(ctx.context, 0);
-    ctx.types.int1 = LLVMInt1TypeInContext(ctx.context);
-    ctx.types.int8 = LLVMInt8TypeInContext(ctx.context);
-    ctx.types.int16 = LLVMInt16TypeInContext(ctx.context);
-    ctx.types.int32 = LLVMInt32TypeInContext(ctx.context);
-    ctx.types.int64 = LLVMInt64TypeInContext(ctx.context);
-    ctx.scope = NULL;
+static ir_node_t *next_program_global(void *data) {
+    program_cursor_t *cursor = data;
+    return cursor->index < cursor->ast->program.global_count ? cursor->ast->program.globals[cursor->index++] : NULL;
+}
 
+LLVMModuleRef gen_module(ir_node_t *ast, source_t *source, LLVMContextRef context, gen_options_t *options) {
     assert(ast->type == IR_NODE_TYPE_PROGRAM);
-    for(size_t i = 0; i < ast->program.global_count; i++) gen_global(&ctx, ast->program.globals[i]);
+    return gen_module_stream(next_program_global, &(program_cursor_t) { .ast = ast, .index = 0 }, source, context, options);
+}
+
+static void initialize_target() {
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+}
+
+LLVMTargetMachineRef gen_target_machine(gen_options_t *options) {
+    static pthread_once_t initialize_once = PTHREAD_ONCE_INIT;
+    pthread_once(&initialize_once, initialize_target);
+
+    char *error;
+    LLVMTargetRef target;
+    char *triple = LLVMGetDefaultTargetTriple();
+    if(LLVMGetTargetFromTriple(triple, &target, &error)) diag_error((diag_loc_t) { .present = false }, "unsupported target `%s`: %s", triple, error);
+
+    char *cpu = LLVMGetHostCPUName();
+    char *features = LLVMGetHostCPUFeatures();
+    LLVMTargetMachineRef machine = LLVMCreateTargetMachine(target, triple, cpu, features, options->codegen_level, LLVMRelocPIC, LLVMCodeModelDefault);
+    LLVMDisposeMessage(features);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(triple);
+    return machine;
+}
+
+void gen_set_target(LLVMModuleRef module, LLVMTargetMachineRef machine) {
+    char *triple = LLVMGetTargetMachineTriple(machine);
+    LLVMTargetDataRef data_layout = LLVMCreateTargetDataLayout(machine);
+    LLVMSetTarget(module, triple);
+    LLVMSetModuleDataLayout(module, data_layout);
+    LLVMDisposeTargetData(data_layout);
+    LLVMDisposeMessage(triple);
+}
+
+void gen_link_bitcode(LLVMModuleRef module, gen_options_t *options) {
+    if(options->bitcode_count == 0) return;
+    trace_begin("link_bitcode", NULL);
+    LLVMContextRef context = LLVMGetModuleContext(module);
+    for(size_t i = 0; i < options->bitcode_count; i++) {
+        char *error;
+        LLVMMemoryBufferRef buffer;
+        if(LLVMCreateMemoryBufferWithContentsOfFile(options->bitcode[i], &buffer, &error)) diag_error((diag_loc_t) { .present = false }, "failed to read `%s`: %s", options->bitcode[i], error);
+
+        LLVMModuleRef other;
+        if(LLVMParseBitcodeInContext2(context, buffer, &other)) diag_error((diag_loc_t) { .present = false }, "`%s` is not a valid bitcode file", options->bitcode[i]);
+        LLVMDisposeMemoryBuffer(buffer);
+
+        // Keep our triple and layout, clang bitcode for the same host only differs in spelling
+        LLVMSetTarget(other, LLVMGetTarget(module));
+        LLVMSetDataLayout(other, LLVMGetDataLayoutStr(module));
+        if(LLVMLinkModules2(module, other)) diag_error((diag_loc_t) { .present = false }, "failed to link `%s`", options->bitcode[i]);
+    }
+
+    if(options->internalize) {
+        for(LLVMValueRef function = LLVMGetFirstFunction(module); function != NULL; function = LLVMGetNextFunction(function)) {
+            if(LLVMIsDeclaration(function) || strcmp(LLVMGetValueName(function), "main") == 0) continue;
+            LLVMSetLinkage(function, LLVMInternalLinkage);
+        }
+        for(LLVMValueRef global = LLVMGetFirstGlobal(module); global != NULL; global = LLVMGetNextGlobal(global)) {
+            if(LLVMIsDeclaration(global) || LLVMGetLinkage(global) == LLVMAppendingLinkage) continue;
+            LLVMSetLinkage(global, LLVMInternalLinkage);
+        }
+    }
+    trace_end("link_bitcode", NULL);
+}
+
+void gen_run_passes(LLVMModuleRef module, LLVMTargetMachineRef machine, gen_options_t *options) {
+    trace_begin("passes", NULL);
+    set_llvm_options(options);
+    char *pipeline = make_pipeline(options);
+    LLVMPassBuilderOptionsRef pass_options = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef error = LLVMRunPasses(module, pipeline, machine, pass_options);
+    if(error != NULL) diag_error((diag_loc_t) { .present = false }, "failed to run passes `%s`: %s", pipeline, LLVMGetErrorMessage(error));
+    LLVMDisposePassBuilderOptions(pass_options);
+    free(pipeline);
+    trace_end("passes", NULL);
+
+    if(mem_enabled()) {
+        LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(module);
+        size_t function_count = 0;
+        for(LLVMValueRef function = LLVMGetFirstFunction(module); function != NULL; function = LLVMGetNextFunction(function)) function_count++;
+        mem_set_module_size(LLVMGetBufferSize(bitcode), function_count);
+        LLVMDisposeMemoryBuffer(bitcode);
+    }
+}
 
-    ctx.current_function = NULL;
+void gen_emit(LLVMModuleRef module, LLVMTargetMachineRef machine, const char *dest, gen_emit_t emit) {
+    trace_begin("emit", NULL);
+    char *error = NULL;
+    bool failed = false;
+    switch(emit) {
+        case GEN_EMIT_LLVM_IR: failed = LLVMPrintModuleToFile(module, dest, &error); break;
+        case GEN_EMIT_LLVM_BC: failed = LLVMWriteBitcodeToFile(module, dest) != 0; break;
+        case GEN_EMIT_ASM: failed = LLVMTargetMachineEmitToFile(machine, module, (char *) dest, LLVMAssemblyFile, &error); break;
+        case GEN_EMIT_OBJ: failed = LLVMTargetMachineEmitToFile(machine, module, (char *) dest, LLVMObjectFile, &error); break;
+    }
+    if(failed) diag_error((diag_loc_t) { .present = false }, "failed to write `%s`: %s", dest, error != NULL ? error : "unknown error");
+    trace_end("emit", NULL);
+}
+
+LLVMMemoryBufferRef gen_emit_to_memory(LLVMModuleRef module, LLVMTargetMachineRef machine, gen_emit_t emit) {
+    trace_begin("emit", NULL);
+    char *error = NULL;
+    LLVMMemoryBufferRef buffer = NULL;
+    switch(emit) {
+        case GEN_EMIT_LLVM_IR: {
+            char *ir = LLVMPrintModuleToString(module);
+            buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(ir, strlen(ir), "llvm-ir");
+            LLVMDisposeMessage(ir);
+            break;
+        }
+        case GEN_EMIT_LLVM_BC: buffer = LLVMWriteBitcodeToMemoryBuffer(module); break;
+        case GEN_EMIT_ASM: if(LLVMTargetMachineEmitToMemoryBuffer(machine, module, LLVMAssemblyFile, &error, &buffer)) buffer = NULL; break;
+        case GEN_EMIT_OBJ: if(LLVMTargetMachineEmitToMemoryBuffer(machine, module, LLVMObjectFile, &error, &buffer)) buffer = NULL; break;
+    }
+    if(buffer == NULL) diag_error((diag_loc_t) { .present = false }, "failed to emit: %s", error != NULL ? error : "unknown error");
+    trace_end("emit", NULL);
+    return buffer;
+}
+
+void gen_stream(gen_next_global_t next, void *data, source_t *source, const char *dest, gen_options_t *options) {
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMModuleRef module = gen_module_stream(next, data, source, context, options);
 
-    LLVMRunPasses(ctx.module, passes, NULL, LLVMCreatePassBuilderOptions());
-    LLVMPrintModuleToFile(ctx.module, dest, NULL);
+    // Passes and code generation both want the real target, so the IR is always tied to the host triple
+    LLVMTargetMachineRef machine = gen_target_machine(options);
+    gen_set_target(module, machine);
+    gen_link_bitcode(module, options);
+    gen_run_passes(module, machine, options);
+    gen_emit(module, machine, dest, options->emit);
 
-    // Cleanup
-    LLVMDisposeBuilder(ctx.builder);
-    LLVMDisposeModule(ctx.module);
-    LLVMContextDispose(ctx.context);
+    LLVMDisposeTargetMachine(machine);
+    LLVMDisposeModule(module);
+    LLVMContextDispose(context);
+}
+
+void gen(ir_node_t *ast, source_t *source, const char *dest, gen_options_t *options) {
+    assert(ast->type == IR_NODE_TYPE_PROGRAM);
+    gen_stream(next_program_global, &(program_cursor_t) { .ast = ast, .index = 0 }, source, dest, options);
 }
\ No newline at end of file
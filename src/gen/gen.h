@@ -1,29 +1,62 @@
 #pragma once
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <llvm-c/Core.h>
+#include <llvm-c/Analysis.h>
+#include <llvm-c/DebugInfo.h>
+#include <llvm-c/Support.h>
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/LLJIT.h>
 #include <llvm-c/Transforms/PassBuilder.h>
 #include "../ir/node.h"
 #include "../ir/type.h"
+#include "../ir/eval.h"
 #include "../diag.h"
+#include "../source.h"
+#include "../trace.h"
+#include "../mem.h"
+
+#define GEN_CACHE_KEY_LENGTH 64
+#define GEN_COMPTIME_STEPS 10000000
 
 typedef struct {
     ir_type_t *type;
     LLVMValueRef value;
+    size_t align; // of the address an expression is stored at when lower than its type's, 0 otherwise
 } gen_value_t;
 
 typedef struct {
     ir_type_t *type;
     const char *name;
     LLVMValueRef value;
+    size_t hash;
+    size_t shadowed;
 } gen_variable_t;
 
-typedef struct gen_scope {
-    struct gen_scope *outer;
-    size_t variable_count;
+typedef struct {
+    const char *name;
+    size_t hash;
+    size_t variable; // innermost binding of name
+} gen_scope_slot_t;
+
+/*
+ * Variables of every open scope live in one stack, which doubles as the undo log.
+ * Each name maps to its innermost binding, shadowed bindings are chained through `shadowed`.
+ */
+typedef struct {
+    size_t variable_count, variable_capacity;
     gen_variable_t *variables;
+    size_t mark_count, mark_capacity;
+    size_t *marks;
+    size_t slot_count, slot_capacity;
+    gen_scope_slot_t *slots;
 } gen_scope_t;
 
 typedef struct {
@@ -46,6 +79,68 @@ typedef struct {
 } gen_current_function_t;
 
 typedef struct {
+    const char *name;
+    size_t hash;
+    bool is_function;
+    bool is_defined;
+    gen_function_type_t function;
+    ir_type_t *variable;
+    ir_node_t *definition; // OPTIONAL, the function or extern comptime evaluates through
+} gen_symbol_t;
+
+typedef struct gen_interface gen_interface_t;
+
+// Hands globals to gen one at a time, NULL ends the program
+typedef ir_node_t *(*gen_next_global_t)(void *data);
+
+/*
+ * Signatures of symbols defined by other modules. Lookups that miss the module being generated
+ * fall back to the summary and declare the symbol on first use. Imported interfaces come last,
+ * their signatures are only materialized when a lookup reaches them.
+ */
+typedef struct {
+    size_t symbol_count, symbol_capacity;
+    gen_symbol_t *symbols;
+    size_t interface_count;
+    gen_interface_t **interfaces;
+} gen_summary_t;
+
+typedef struct {
+    LLVMDIBuilderRef builder;
+    LLVMMetadataRef file;
+    LLVMMetadataRef compile_unit;
+    LLVMMetadataRef scope;
+    source_t *source;
+    size_t line_count;
+    size_t *lines;
+    size_t struct_count;
+    ir_type_t **struct_types;
+    LLVMMetadataRef *struct_metadata; // built once per struct so members can point back at it
+} gen_debug_t;
+
+typedef enum {
+    GEN_EMIT_LLVM_IR,
+    GEN_EMIT_LLVM_BC,
+    GEN_EMIT_ASM,
+    GEN_EMIT_OBJ
+} gen_emit_t;
+
+typedef struct {
+    const char *passes;
+    LLVMCodeGenOptLevel codegen_level;
+    gen_emit_t emit;
+    size_t bitcode_count;
+    const char **bitcode; // linked into the module before any passes run
+    bool internalize; // everything but main is internal after linking
+    gen_summary_t *summary; // OPTIONAL, signatures of every file in the program
+    bool debug;
+    bool profile_generate;
+    const char *profile_use; // OPTIONAL
+    bool time_passes;
+    size_t comptime_steps; // budget of each comptime expression, 0 picks GEN_COMPTIME_STEPS
+} gen_options_t;
+
+typedef struct gen_context {
     LLVMBuilderRef builder;
     LLVMContextRef context;
     LLVMModuleRef module;
@@ -58,29 +153,105 @@ typedef struct {
         LLVMTypeRef int64;
         LLVMTypeRef pointer;
     } types;
-    gen_scope_t *scope;
+    gen_scope_t scope;
     size_t function_count;
     gen_function_t *functions;
     gen_current_function_t *current_function;
+    gen_debug_t *debug; // OPTIONAL
+    gen_summary_t *summary; // OPTIONAL
+    gen_summary_t definitions; // globals of this module by name, for comptime
+    size_t comptime_steps;
+    struct gen_context *outer; // made earlier on the same thread and not freed yet
 } gen_context_t;
 
-gen_scope_t *gen_scope_enter(gen_scope_t *current);
-gen_scope_t *gen_scope_exit(gen_scope_t *scope);
+typedef struct {
+    gen_options_t *options;
+    LLVMOrcThreadSafeContextRef ts_context;
+    LLVMOrcLLJITRef jit;
+    LLVMOrcJITDylibRef dylib;
+    LLVMTargetMachineRef machine;
+    gen_summary_t summary;
+    size_t entry_count;
+} gen_session_t;
+
+typedef struct {
+    bool has_value;
+    bool is_signed;
+    uint64_t value;
+    uint64_t compile_ns;
+} gen_session_result_t;
+
+size_t gen_hash_name(const char *name);
+
+void gen_scope_enter(gen_scope_t *scope);
+void gen_scope_exit(gen_scope_t *scope);
+void gen_scope_free(gen_scope_t *scope);
 
 gen_variable_t *gen_scope_add_variable(gen_scope_t *scope, ir_type_t *type, const char *name, LLVMValueRef value);
 gen_variable_t *gen_scope_get_variable(gen_scope_t *scope, const char *name);
 
+void gen_summary_add_program(gen_summary_t *summary, ir_node_t *ast);
+void gen_summary_add_function(gen_summary_t *summary, const char *name, gen_function_type_t type, bool is_defined);
+void gen_summary_add_variable(gen_summary_t *summary, const char *name, ir_type_t *type);
+void gen_summary_add_definition(gen_summary_t *summary, ir_node_t *node);
+void gen_summary_add_interface(gen_summary_t *summary, gen_interface_t *interface);
+gen_symbol_t *gen_summary_get(gen_summary_t *summary, const char *name);
+const char *gen_summary_find_function(gen_summary_t *summary, const char *name, gen_function_type_t *type);
+void gen_summary_free(gen_summary_t *summary);
+
+void gen_interface_write(ir_node_t *ast, const char *path);
+gen_interface_t *gen_interface_open(const char *path);
+const char *gen_interface_find_function(gen_interface_t *interface, const char *name, gen_function_type_t *type);
+void gen_interface_close(gen_interface_t *interface);
+
+/* Contexts are freed innermost first. An error that longjmps out of codegen skips that, the recovery point calls gen_context_unwind */
+gen_context_t *gen_context_make(LLVMContextRef context, const char *module_name);
+void gen_context_free(gen_context_t *ctx);
+size_t gen_context_depth();
+void gen_context_unwind(size_t depth);
+
+gen_function_type_t gen_make_function_type(ir_function_decl_t *decl);
 gen_function_t *gen_add_function(gen_context_t *ctx, gen_function_t function);
+gen_function_t *gen_declare_function(gen_context_t *ctx, const char *name, gen_function_type_t function_type);
 gen_function_t *gen_get_function(gen_context_t *ctx, const char *name);
+gen_variable_t *gen_get_variable(gen_context_t *ctx, const char *name);
+ir_node_t *gen_get_definition(gen_context_t *ctx, const char *name);
 
 void gen_enter_function(gen_context_t *ctx, ir_type_t *return_type);
 gen_current_function_t *gen_current_function(gen_context_t *ctx);
 void gen_exit_function(gen_context_t *ctx);
 
+void gen_debug_init(gen_context_t *ctx, source_t *source);
+void gen_debug_finalize(gen_context_t *ctx);
+void gen_debug_function_enter(gen_context_t *ctx, gen_function_t *function, diag_loc_t diag_loc);
+void gen_debug_function_exit(gen_context_t *ctx);
+LLVMMetadataRef gen_debug_block_enter(gen_context_t *ctx, diag_loc_t diag_loc);
+void gen_debug_block_exit(gen_context_t *ctx, LLVMMetadataRef outer);
+void gen_debug_location(gen_context_t *ctx, diag_loc_t diag_loc);
+void gen_debug_variable(gen_context_t *ctx, const char *name, ir_type_t *type, LLVMValueRef storage, size_t argument_number, diag_loc_t diag_loc);
+void gen_debug_global_variable(gen_context_t *ctx, const char *name, ir_type_t *type, LLVMValueRef global, diag_loc_t diag_loc);
+
 LLVMTypeRef gen_llvm_type(gen_context_t *ctx, ir_type_t *type);
+unsigned gen_struct_element(ir_type_t *type, size_t field);
+LLVMValueRef gen_const(gen_context_t *ctx, ir_eval_value_t value);
 
 gen_value_t gen_expr(gen_context_t *ctx, ir_node_t *node, ir_type_t *type_expected);
 void gen_stmt(gen_context_t *ctx, ir_node_t *node);
 void gen_global(gen_context_t *ctx, ir_node_t *node);
 
-void gen(ir_node_t *ast, const char *dest, const char *passes);
\ No newline at end of file
+LLVMModuleRef gen_module(ir_node_t *ast, source_t *source, LLVMContextRef context, gen_options_t *options);
+LLVMModuleRef gen_module_stream(gen_next_global_t next, void *data, source_t *source, LLVMContextRef context, gen_options_t *options);
+LLVMTargetMachineRef gen_target_machine(gen_options_t *options);
+void gen_set_target(LLVMModuleRef module, LLVMTargetMachineRef machine);
+void gen_link_bitcode(LLVMModuleRef module, gen_options_t *options);
+void gen_run_passes(LLVMModuleRef module, LLVMTargetMachineRef machine, gen_options_t *options);
+void gen_emit(LLVMModuleRef module, LLVMTargetMachineRef machine, const char *dest, gen_emit_t emit);
+LLVMMemoryBufferRef gen_emit_to_memory(LLVMModuleRef module, LLVMTargetMachineRef machine, gen_emit_t emit);
+void gen(ir_node_t *ast, source_t *source, const char *dest, gen_options_t *options);
+void gen_stream(gen_next_global_t next, void *data, source_t *source, const char *dest, gen_options_t *options);
+void gen_cache_key(ir_node_t *global, source_t *source, gen_options_t *options, char key[GEN_CACHE_KEY_LENGTH + 1]);
+int gen_run(ir_node_t *ast, source_t *source, gen_options_t *options, int argc, char **argv);
+
+gen_session_t *gen_session_make(gen_options_t *options);
+void gen_session_free(gen_session_t *session);
+gen_session_result_t gen_session_eval(gen_session_t *session, ir_node_t *node);
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "gen.h"
+#include "../ir/eval.h"
 
 static bool cmp_functions(gen_function_type_t *a, gen_function_type_t *b) {
     if(a->varargs != b->varargs || a->argument_count != b->argument_count) return false;
@@ -7,8 +8,8 @@ static bool cmp_functions(gen_function_type_t *a, gen_function_type_t *b) {
     return true;
 }
 
-static gen_function_type_t make_function_type(ir_function_decl_t *decl) {
-    ir_type_t **arguments = malloc(sizeof(ir_type_t *) * decl->argument_count);
+gen_function_type_t gen_make_function_type(ir_function_decl_t *decl) {
+    ir_type_t **arguments = mem_alloc(MEM_SUBSYSTEM_CODEGEN, sizeof(ir_type_t *) * decl->argument_count);
     for(size_t i = 0; i < decl->argument_count; i++) arguments[i] = decl->arguments[i].type;
     return (gen_function_type_t) {
         .return_type = decl->return_type,
@@ -18,7 +19,7 @@ static gen_function_type_t make_function_type(ir_function_decl_t *decl) {
     };
 }
 
-static gen_function_t *add_function(gen_context_t *ctx, const char *name, gen_function_type_t function_type) {
+gen_function_t *gen_declare_function(gen_context_t *ctx, const char *name, gen_function_type_t function_type) {
     LLVMTypeRef args[function_type.argument_count];
     for(size_t i = 0; i < function_type.argument_count; i++) args[i] = gen_llvm_type(ctx, function_type.arguments[i]);
     LLVMTypeRef func_type = LLVMFunctionType(gen_llvm_type(ctx, function_type.return_type), args, function_type.argument_count, function_type.varargs);
@@ -28,38 +29,83 @@ static gen_function_t *add_function(gen_context_t *ctx, const char *name, gen_fu
 static void gen_global_extern(gen_context_t *ctx, ir_node_t *node) {
     const char *func_name = node->global_extern.decl.name;
     gen_function_t *existing_func = gen_get_function(ctx, func_name);
-    gen_function_type_t func_type = make_function_type(&node->global_extern.decl);
-    if(existing_func != NULL && !cmp_functions(&existing_func->type, &func_type)) diag_error(node->diag_loc, "conflicting types for '%s'", func_name);
-    add_function(ctx, func_name, func_type);
+    gen_function_type_t func_type = gen_make_function_type(&node->global_extern.decl);
+    if(existing_func != NULL) {
+        if(!cmp_functions(&existing_func->type, &func_type)) diag_error(node->diag_loc, "conflicting types for '%s'", func_name);
+        return;
+    }
+    gen_declare_function(ctx, func_name, func_type);
 }
 
 static void gen_global_function(gen_context_t *ctx, ir_node_t *node) {
+    if(node->global_function.is_comptime) return;
     const char *func_name = node->global_function.decl.name;
-    if(gen_get_function(ctx, func_name) != NULL) diag_error(node->diag_loc, "redefinition of '%s'", func_name);
-    gen_function_t *func = add_function(ctx, func_name, make_function_type(&node->global_function.decl));
+    gen_function_type_t func_type = gen_make_function_type(&node->global_function.decl);
+
+    // Already declared by an extern or by a call through the summary, the definition has to match
+    gen_function_t *func = gen_get_function(ctx, func_name);
+    if(func != NULL && !LLVMIsDeclaration(func->value)) diag_error(node->diag_loc, "redefinition of '%s'", func_name);
+    if(func != NULL && !cmp_functions(&func->type, &func_type)) diag_error(node->diag_loc, "conflicting types for '%s'", func_name);
+    if(func == NULL) func = gen_declare_function(ctx, func_name, func_type);
+    trace_begin("gen_function", func_name);
 
     LLVMBasicBlockRef bb_entry = LLVMAppendBasicBlockInContext(ctx->context, func->value, "entry");
     LLVMPositionBuilderAtEnd(ctx->builder, bb_entry);
+    gen_debug_function_enter(ctx, func, node->diag_loc);
 
-    ctx->scope = gen_scope_enter(ctx->scope);
+    gen_scope_enter(&ctx->scope);
     for(size_t i = 0; i < node->global_function.decl.argument_count; i++) {
         ir_type_t *param_type = node->global_function.decl.arguments[i].type;
         const char *param_name = node->global_function.decl.arguments[i].name;
         LLVMValueRef param_original = LLVMGetParam(func->value, i);
         LLVMValueRef param_new = LLVMBuildAlloca(ctx->builder, gen_llvm_type(ctx, param_type), param_name);
+        LLVMSetAlignment(param_new, ir_type_align(param_type));
         LLVMBuildStore(ctx->builder, param_original, param_new);
-        gen_scope_add_variable(ctx->scope, param_type, param_name, param_new);
+        gen_scope_add_variable(&ctx->scope, param_type, param_name, param_new);
+        gen_debug_variable(ctx, param_name, param_type, param_new, i + 1, node->global_function.decl.arguments[i].diag_loc);
     }
     gen_enter_function(ctx, func->type.return_type);
     gen_stmt(ctx, node->global_function.body);
     gen_exit_function(ctx);
-    ctx->scope = gen_scope_exit(ctx->scope);
+    gen_scope_exit(&ctx->scope);
+    gen_debug_function_exit(ctx);
+    trace_end("gen_function", func_name);
+}
+
+static ir_node_t *find_global(const char *name, void *data) {
+    return gen_get_definition((gen_context_t *) data, name);
+}
+
+// Initializers are evaluated like comptime expressions, globals start out zeroed without one
+static void gen_global_variable(gen_context_t *ctx, ir_node_t *node) {
+    const char *name = node->global_variable.name;
+    ir_type_t *type = node->global_variable.type;
+    if(ir_type_is_void(type)) diag_error(node->diag_loc, "variable '%s' is void", name);
+    LLVMTypeRef llvm_type = gen_llvm_type(ctx, type);
+    LLVMValueRef initializer = LLVMConstNull(llvm_type);
+    if(node->global_variable.initial != NULL) {
+        ir_eval_value_t value = ir_eval(node->global_variable.initial, &(ir_eval_options_t) { .find_global = find_global, .data = ctx, .step_limit = ctx->comptime_steps });
+        if(!ir_type_is_eq(value.type, type)) diag_error(node->global_variable.initial->diag_loc, "conflicting types");
+        initializer = gen_const(ctx, value);
+        ir_eval_value_free(value);
+    }
+
+    // Already declared by a use through the summary
+    LLVMValueRef global = LLVMGetNamedGlobal(ctx->module, name);
+    if(global != NULL && LLVMGetInitializer(global) != NULL) diag_error(node->diag_loc, "redefinition of '%s'", name);
+    if(global == NULL) global = LLVMAddGlobal(ctx->module, llvm_type, name);
+    LLVMSetAlignment(global, ir_type_align(type));
+    LLVMSetInitializer(global, initializer);
+    gen_debug_global_variable(ctx, name, type, global, node->diag_loc);
 }
 
 void gen_global(gen_context_t *ctx, ir_node_t *node) {
     switch(node->type) {
         case IR_NODE_TYPE_GLOBAL_FUNCTION: gen_global_function(ctx, node); return;
         case IR_NODE_TYPE_GLOBAL_EXTERN: gen_global_extern(ctx, node); return;
+        case IR_NODE_TYPE_GLOBAL_IMPORT: return; // resolved through the summary
+        case IR_NODE_TYPE_GLOBAL_VARIABLE: gen_global_variable(ctx, node); return;
+        case IR_NODE_TYPE_GLOBAL_STRUCT: return; // the parser already resolved every use
         default: assert(false);
     }
 }
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "gen.h"
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Binary interface file (.chi), the signatures a module offers to importers.
+ * Layout: header, interned types, symbols, hash buckets, argument type indices, names.
+ * Every section is made of 32 bit words so the mapping can be read in place.
+ */
+
+#define INTERFACE_MAGIC "CHI"
+#define INTERFACE_VERSION 3
+#define INTERFACE_NONE UINT32_MAX
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t type_count, symbol_count, bucket_count, argument_count, string_size;
+} interface_header_t;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t is_signed;
+    uint16_t bit_size;
+    uint32_t base; // pointee of pointers or element of arrays, always an earlier type
+    uint32_t count; // elements of arrays, offset of the name of structs
+} interface_type_t;
+
+typedef struct {
+    uint32_t name, hash;
+    uint32_t return_type;
+    uint32_t first_argument, argument_count;
+    uint32_t varargs;
+} interface_symbol_t;
+
+struct gen_interface {
+    void *data;
+    size_t size;
+    const interface_header_t *header;
+    const interface_type_t *types;
+    const interface_symbol_t *symbols;
+    const uint32_t *buckets;
+    const uint32_t *arguments;
+    const char *strings;
+};
+
+typedef struct {
+    size_t type_count, symbol_count, argument_count, string_size;
+    interface_type_t *types;
+    interface_symbol_t *symbols;
+    bool *is_definition;
+    uint32_t *arguments;
+    char *strings;
+} writer_t;
+
+static uint32_t add_string(writer_t *writer, const char *str) {
+    size_t length = strlen(str) + 1;
+    writer->strings = mem_realloc(MEM_SUBSYSTEM_CODEGEN, writer->strings, writer->string_size + length);
+    memcpy(writer->strings + writer->string_size, str, length);
+    writer->string_size += length;
+    return writer->string_size - length;
+}
+
+static uint32_t intern_type(writer_t *writer, ir_type_t *type) {
+    interface_type_t entry = { .kind = type->kind, .base = INTERFACE_NONE };
+    switch(type->kind) {
+        case IR_TYPE_KIND_VOID: break;
+        case IR_TYPE_KIND_INTEGER:
+            entry.bit_size = type->integer.bit_size;
+            entry.is_signed = type->integer.is_signed;
+            break;
+        case IR_TYPE_KIND_POINTER: entry.base = intern_type(writer, type->pointer.base); break;
+        case IR_TYPE_KIND_ARRAY:
+            entry.base = intern_type(writer, type->array.base);
+            entry.count = type->array.count;
+            break;
+        case IR_TYPE_KIND_VECTOR:
+            entry.base = intern_type(writer, type->vector.base);
+            entry.count = type->vector.count;
+            break;
+        case IR_TYPE_KIND_STRUCT:
+            // Only the name, importers that look inside define the struct themselves
+            for(size_t i = 0; i < writer->type_count; i++) {
+                if(writer->types[i].kind == IR_TYPE_KIND_STRUCT && strcmp(writer->strings + writer->types[i].count, type->structure.name) == 0) return i;
+            }
+            entry.count = add_string(writer, type->structure.name);
+            break;
+    }
+    for(size_t i = 0; i < writer->type_count; i++) if(memcmp(&writer->types[i], &entry, sizeof(entry)) == 0) return i;
+    writer->types = mem_realloc(MEM_SUBSYSTEM_CODEGEN, writer->types, sizeof(interface_type_t) * (writer->type_count + 1));
+    writer->types[writer->type_count] = entry;
+    return writer->type_count++;
+}
+
+static void add_symbol(writer_t *writer, ir_function_decl_t *decl, bool is_definition) {
+    uint32_t name = add_string(writer, decl->name);
+    writer->arguments = mem_realloc(MEM_SUBSYSTEM_CODEGEN, writer->arguments, sizeof(uint32_t) * (writer->argument_count + decl->argument_count));
+    for(size_t i = 0; i < decl->argument_count; i++) writer->arguments[writer->argument_count + i] = intern_type(writer, decl->arguments[i].type);
+
+    writer->symbols = mem_realloc(MEM_SUBSYSTEM_CODEGEN, writer->symbols, sizeof(interface_symbol_t) * (writer->symbol_count + 1));
+    writer->is_definition = mem_realloc(MEM_SUBSYSTEM_CODEGEN, writer->is_definition, sizeof(bool) * (writer->symbol_count + 1));
+    writer->is_definition[writer->symbol_count] = is_definition;
+    writer->symbols[writer->symbol_count++] = (interface_symbol_t) {
+        .name = name,
+        .hash = (uint32_t) gen_hash_name(decl->name),
+        .return_type = intern_type(writer, decl->return_type),
+        .first_argument = writer->argument_count,
+        .argument_count = decl->argument_count,
+        .varargs = decl->varargs
+    };
+    writer->argument_count += decl->argument_count;
+}
+
+static bool write_items(FILE *file, const void *items, size_t size, size_t count) {
+    return count == 0 || fwrite(items, size, count, file) == count;
+}
+
+void gen_interface_write(ir_node_t *ast, const char *path) {
+    trace_begin("write_interface", NULL);
+    writer_t writer = {};
+    for(size_t i = 0; i < ast->program.global_count; i++) {
+        ir_node_t *node = ast->program.globals[i];
+        switch(node->type) {
+            case IR_NODE_TYPE_GLOBAL_FUNCTION:
+                // Never emitted, importers have nothing to link against
+                if(!node->global_function.is_comptime) add_symbol(&writer, &node->global_function.decl, true);
+                break;
+            case IR_NODE_TYPE_GLOBAL_EXTERN: add_symbol(&writer, &node->global_extern.decl, false); break;
+            // Only functions are exported, variables stay private to the module
+            case IR_NODE_TYPE_GLOBAL_IMPORT:
+            case IR_NODE_TYPE_GLOBAL_VARIABLE:
+            case IR_NODE_TYPE_GLOBAL_STRUCT:
+                break;
+            default: assert(false);
+        }
+    }
+
+    // Buckets hold symbol index + 1, at most half full so probes stay short
+    size_t bucket_count = 16;
+    while(bucket_count < writer.symbol_count * 2) bucket_count *= 2;
+    uint32_t *buckets = mem_calloc(MEM_SUBSYSTEM_CODEGEN, bucket_count, sizeof(uint32_t));
+    for(size_t i = 0; i < writer.symbol_count; i++) {
+        size_t bucket = writer.symbols[i].hash & (bucket_count - 1);
+        for(; buckets[bucket] != 0; bucket = (bucket + 1) & (bucket_count - 1)) {
+            interface_symbol_t *other = &writer.symbols[buckets[bucket] - 1];
+            if(other->hash == writer.symbols[i].hash && strcmp(writer.strings + other->name, writer.strings + writer.symbols[i].name) == 0) break;
+        }
+        // Definitions win over externs of the same function, the summary already checked they agree
+        if(buckets[bucket] != 0 && (writer.is_definition[buckets[bucket] - 1] || !writer.is_definition[i])) continue;
+        buckets[bucket] = i + 1;
+    }
+
+    interface_header_t header = {
+        .magic = INTERFACE_MAGIC,
+        .version = INTERFACE_VERSION,
+        .type_count = writer.type_count,
+        .symbol_count = writer.symbol_count,
+        .bucket_count = bucket_count,
+        .argument_count = writer.argument_count,
+        .string_size = writer.string_size
+    };
+    FILE *file = fopen(path, "wb");
+    bool is_written = file != NULL
+        && write_items(file, &header, sizeof(header), 1)
+        && write_items(file, writer.types, sizeof(interface_type_t), writer.type_count)
+        && write_items(file, writer.symbols, sizeof(interface_symbol_t), writer.symbol_count)
+        && write_items(file, buckets, sizeof(uint32_t), bucket_count)
+        && write_items(file, writer.arguments, sizeof(uint32_t), writer.argument_count)
+        && write_items(file, writer.strings, 1, writer.string_size);
+    if(file != NULL && fclose(file) != 0) is_written = false;
+    int error = errno;
+
+    mem_free(MEM_SUBSYSTEM_CODEGEN, buckets);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, writer.types);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, writer.symbols);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, writer.is_definition);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, writer.arguments);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, writer.strings);
+    trace_end("write_interface", NULL);
+    if(is_written) return;
+    // A truncated interface would only be rejected later, without saying why
+    if(file != NULL) unlink(path);
+    diag_error((diag_loc_t) { .present = false }, "failed to write the interface '%s': %s", path, strerror(error));
+}
+
+gen_interface_t *gen_interface_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+    struct stat s;
+    if(fstat(fd, &s) != 0 || (size_t) s.st_size < sizeof(interface_header_t)) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return NULL;
+
+    // Only the header is checked up front, symbols are validated when they are materialized
+    const interface_header_t *header = data;
+    size_t size = sizeof(interface_header_t)
+        + (size_t) header->type_count * sizeof(interface_type_t)
+        + (size_t) header->symbol_count * sizeof(interface_symbol_t)
+        + ((size_t) header->bucket_count + header->argument_count) * sizeof(uint32_t)
+        + header->string_size;
+    bool is_valid = memcmp(header->magic, INTERFACE_MAGIC, 4) == 0 && header->version == INTERFACE_VERSION && size == (size_t) s.st_size;
+    is_valid = is_valid && header->bucket_count > 0 && (header->bucket_count & (header->bucket_count - 1)) == 0 && header->symbol_count < header->bucket_count;
+    if(!is_valid) {
+        munmap(data, s.st_size);
+        return NULL;
+    }
+
+    gen_interface_t *interface = mem_alloc(MEM_SUBSYSTEM_CODEGEN, sizeof(gen_interface_t));
+    interface->data = data;
+    interface->size = s.st_size;
+    interface->header = header;
+    interface->types = (const interface_type_t *) (header + 1);
+    interface->symbols = (const interface_symbol_t *) (interface->types + header->type_count);
+    interface->buckets = (const uint32_t *) (interface->symbols + header->symbol_count);
+    interface->arguments = interface->buckets + header->bucket_count;
+    interface->strings = (const char *) (interface->arguments + header->argument_count);
+    return interface;
+}
+
+void gen_interface_close(gen_interface_t *interface) {
+    munmap(interface->data, interface->size);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, interface);
+}
+
+static ir_type_t *materialize_type(gen_interface_t *interface, uint32_t index) {
+    if(index >= interface->header->type_count) return NULL;
+    const interface_type_t *type = &interface->types[index];
+    switch(type->kind) {
+        case IR_TYPE_KIND_VOID: return ir_type_get_void();
+        case IR_TYPE_KIND_POINTER:
+            if(type->base >= index) return NULL;
+            ir_type_t *base = materialize_type(interface, type->base);
+            return base != NULL ? ir_type_make_pointer(base) : NULL;
+        case IR_TYPE_KIND_ARRAY:
+            if(type->base >= index || type->count == 0) return NULL;
+            ir_type_t *element = materialize_type(interface, type->base);
+            return element != NULL && !ir_type_is_incomplete(element) ? ir_type_make_array(element, type->count) : NULL;
+        case IR_TYPE_KIND_VECTOR:
+            if(type->base >= index || type->count == 0 || type->count > 64 || (type->count & (type->count - 1)) != 0) return NULL;
+            ir_type_t *lane = materialize_type(interface, type->base);
+            return lane != NULL && ir_type_is_kind(lane, IR_TYPE_KIND_INTEGER) ? ir_type_make_vector(lane, type->count) : NULL;
+        case IR_TYPE_KIND_STRUCT:
+            // Nominal, it equals the importer's own struct of that name
+            if(type->count >= interface->header->string_size) return NULL;
+            const char *name = interface->strings + type->count;
+            if(strnlen(name, interface->header->string_size - type->count) == interface->header->string_size - type->count) return NULL;
+            return ir_type_make_struct(name);
+        case IR_TYPE_KIND_INTEGER:
+            switch(type->bit_size) {
+                case 1: return ir_type_get_bool();
+                case 8: return type->is_signed ? ir_type_get_i8() : ir_type_get_u8();
+                case 16: return type->is_signed ? ir_type_get_i16() : ir_type_get_u16();
+                case 32: return type->is_signed ? ir_type_get_i32() : ir_type_get_u32();
+                case 64: return type->is_signed ? ir_type_get_i64() : ir_type_get_u64();
+            }
+            return NULL;
+    }
+    return NULL;
+}
+
+const char *gen_interface_find_function(gen_interface_t *interface, const char *name, gen_function_type_t *type) {
+    const interface_header_t *header = interface->header;
+    uint32_t hash = (uint32_t) gen_hash_name(name);
+    for(size_t bucket = hash & (header->bucket_count - 1), probes = 0; probes < header->bucket_count; bucket = (bucket + 1) & (header->bucket_count - 1), probes++) {
+        uint32_t entry = interface->buckets[bucket];
+        if(entry == 0) return NULL;
+        if(entry > header->symbol_count) return NULL;
+        const interface_symbol_t *symbol = &interface->symbols[entry - 1];
+        if(symbol->hash != hash || symbol->name >= header->string_size) continue;
+        const char *symbol_name = interface->strings + symbol->name;
+        if(strnlen(symbol_name, header->string_size - symbol->name) == header->string_size - symbol->name || strcmp(symbol_name, name) != 0) continue;
+
+        if(symbol->first_argument > header->argument_count || symbol->argument_count > header->argument_count - symbol->first_argument) return NULL;
+        ir_type_t *return_type = materialize_type(interface, symbol->return_type);
+        if(return_type == NULL) return NULL;
+        // Structs are passed by value only between functions that see their layout
+        if(ir_type_is_incomplete(return_type)) diag_error((diag_loc_t) { .present = false }, "imported '%s' returns struct '%s' by value, define the struct to call it", name, return_type->structure.name);
+        ir_type_t **arguments = mem_alloc(MEM_SUBSYSTEM_CODEGEN, sizeof(ir_type_t *) * (symbol->argument_count > 0 ? symbol->argument_count : 1));
+        for(size_t i = 0; i < symbol->argument_count; i++) {
+            ir_type_t *argument = materialize_type(interface, interface->arguments[symbol->first_argument + i]);
+            arguments[i] = argument;
+            if(argument != NULL && !ir_type_is_incomplete(argument)) continue;
+            mem_free(MEM_SUBSYSTEM_CODEGEN, arguments);
+            if(argument == NULL) return NULL;
+            diag_error((diag_loc_t) { .present = false }, "imported '%s' takes struct '%s' by value, define the struct to call it", name, argument->structure.name);
+        }
+        *type = (gen_function_type_t) { .return_type = return_type, .argument_count = symbol->argument_count, .arguments = arguments, .varargs = symbol->varargs != 0 };
+        return symbol_name;
+    }
+    return NULL;
+}
\ No newline at end of file
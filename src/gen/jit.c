@@ -0,0 +1,176 @@
+#include "gen.h"
+#include <stdio.h>
+
+static void check(LLVMErrorRef error, const char *what) {
+    if(error == NULL) return;
+    diag_error((diag_loc_t) { .present = false }, "%s: %s", what, LLVMGetErrorMessage(error));
+}
+
+static LLVMOrcLLJITRef make_jit(gen_options_t *options) {
+    LLVMOrcLLJITBuilderRef builder = LLVMOrcCreateLLJITBuilder();
+    LLVMOrcLLJITBuilderSetJITTargetMachineBuilder(builder, LLVMOrcJITTargetMachineBuilderCreateFromTargetMachine(gen_target_machine(options)));
+    LLVMOrcLLJITRef jit;
+    check(LLVMOrcCreateLLJIT(&jit, builder), "failed to create the jit");
+
+    // Externs resolve against whatever the charon process has loaded, libc included
+    LLVMOrcDefinitionGeneratorRef generator;
+    check(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&generator, LLVMOrcLLJITGetGlobalPrefix(jit), NULL, NULL), "failed to create the host symbol generator");
+    LLVMOrcJITDylibAddGenerator(LLVMOrcLLJITGetMainJITDylib(jit), generator);
+    return jit;
+}
+
+int gen_run(ir_node_t *ast, source_t *source, gen_options_t *options, int argc, char **argv) {
+    // The module has to live in the thread safe context the JIT takes ownership of
+    LLVMOrcThreadSafeContextRef ts_context = LLVMOrcCreateNewThreadSafeContext();
+    LLVMModuleRef module = gen_module(ast, source, LLVMOrcThreadSafeContextGetContext(ts_context), options);
+
+    LLVMTargetMachineRef machine = gen_target_machine(options);
+    gen_set_target(module, machine);
+    gen_link_bitcode(module, options);
+    gen_run_passes(module, machine, options);
+    LLVMDisposeTargetMachine(machine);
+
+    trace_begin("jit", NULL);
+    LLVMOrcLLJITRef jit = make_jit(options);
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit);
+    LLVMOrcThreadSafeModuleRef ts_module = LLVMOrcCreateNewThreadSafeModule(module, ts_context);
+    LLVMOrcDisposeThreadSafeContext(ts_context);
+    check(LLVMOrcLLJITAddLLVMIRModule(jit, dylib, ts_module), "failed to add the module to the jit");
+
+    LLVMOrcJITTargetAddress main_address;
+    check(LLVMOrcLLJITLookup(jit, &main_address, "main"), "failed to look up `main`");
+    trace_end("jit", NULL);
+
+    trace_begin("run", NULL);
+    int result = ((int (*)(int, char **)) main_address)(argc, argv);
+    fflush(stdout);
+    trace_end("run", NULL);
+
+    check(LLVMOrcDisposeLLJIT(jit), "failed to dispose of the jit");
+    return result;
+}
+
+gen_session_t *gen_session_make(gen_options_t *options) {
+    gen_session_t *session = mem_calloc(MEM_SUBSYSTEM_CODEGEN, 1, sizeof(gen_session_t));
+    session->options = options;
+    session->ts_context = LLVMOrcCreateNewThreadSafeContext();
+    session->machine = gen_target_machine(options);
+    session->jit = make_jit(options);
+    session->dylib = LLVMOrcLLJITGetMainJITDylib(session->jit);
+    return session;
+}
+
+void gen_session_free(gen_session_t *session) {
+    check(LLVMOrcDisposeLLJIT(session->jit), "failed to dispose of the jit");
+    LLVMOrcDisposeThreadSafeContext(session->ts_context);
+    LLVMDisposeTargetMachine(session->machine);
+    gen_summary_free(&session->summary);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, session);
+}
+
+static void gen_entry_statement(gen_context_t *ctx, ir_node_t *node, gen_session_result_t *result) {
+    // Top level declarations outlive the entry as globals, their initializer runs as part of it
+    if(node->type == IR_NODE_TYPE_STMT_DECL) {
+        const char *name = node->stmt_decl.name;
+        if(gen_summary_get(ctx->summary, name) != NULL) diag_error(node->diag_loc, "redefinition of '%s'", name);
+        LLVMTypeRef type = gen_llvm_type(ctx, node->stmt_decl.type);
+        LLVMValueRef global = LLVMAddGlobal(ctx->module, type, name);
+        LLVMSetAlignment(global, ir_type_align(node->stmt_decl.type));
+        LLVMSetInitializer(global, LLVMConstNull(type));
+        gen_scope_add_variable(&ctx->scope, node->stmt_decl.type, name, global);
+        if(node->stmt_decl.initial != NULL) LLVMBuildStore(ctx->builder, gen_expr(ctx, node->stmt_decl.initial, node->stmt_decl.type).value, global);
+        return;
+    }
+
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC:
+        case IR_NODE_TYPE_EXPR_LITERAL_STRING:
+        case IR_NODE_TYPE_EXPR_LITERAL_CHAR:
+        case IR_NODE_TYPE_EXPR_LITERAL_BOOL:
+        case IR_NODE_TYPE_EXPR_BINARY:
+        case IR_NODE_TYPE_EXPR_UNARY:
+        case IR_NODE_TYPE_EXPR_VAR:
+        case IR_NODE_TYPE_EXPR_CALL:
+        case IR_NODE_TYPE_EXPR_CAST:
+        case IR_NODE_TYPE_EXPR_COMPTIME:
+        case IR_NODE_TYPE_EXPR_INDEX:
+        case IR_NODE_TYPE_EXPR_MEMBER:
+            break;
+        default:
+            gen_stmt(ctx, node);
+            return;
+    }
+
+    gen_value_t value = gen_expr(ctx, node, NULL);
+    if(!ir_type_is_kind(value.type, IR_TYPE_KIND_INTEGER)) return;
+    result->has_value = true;
+    result->is_signed = value.type->integer.is_signed;
+    if(value.type->integer.bit_size == 64) {
+        LLVMBuildRet(ctx->builder, value.value);
+    } else if(result->is_signed) {
+        LLVMBuildRet(ctx->builder, LLVMBuildSExt(ctx->builder, value.value, ctx->types.int64, ""));
+    } else {
+        LLVMBuildRet(ctx->builder, LLVMBuildZExt(ctx->builder, value.value, ctx->types.int64, ""));
+    }
+}
+
+gen_session_result_t gen_session_eval(gen_session_t *session, ir_node_t *node) {
+    gen_session_result_t result = {};
+    // The parser keeps structs across entries, there is nothing to generate for them
+    if(node->type == IR_NODE_TYPE_GLOBAL_STRUCT) return result;
+    trace_time_t start = trace_now();
+
+    // Every entry gets a fresh module, earlier definitions are only declared through the summary
+    char name[32];
+    snprintf(name, sizeof(name), "__repl_%zu", session->entry_count++);
+    gen_context_t *ctx = gen_context_make(LLVMOrcThreadSafeContextGetContext(session->ts_context), name);
+    ctx->summary = &session->summary;
+    ctx->comptime_steps = session->options->comptime_steps != 0 ? session->options->comptime_steps : GEN_COMPTIME_STEPS;
+    gen_set_target(ctx->module, session->machine);
+
+    trace_begin("gen", NULL);
+    bool is_global = node->type == IR_NODE_TYPE_GLOBAL_FUNCTION || node->type == IR_NODE_TYPE_GLOBAL_EXTERN;
+    if(node->type == IR_NODE_TYPE_GLOBAL_FUNCTION) {
+        gen_symbol_t *existing = gen_summary_get(&session->summary, node->global_function.decl.name);
+        if(existing != NULL && existing->is_defined) diag_error(node->diag_loc, "redefinition of '%s'", node->global_function.decl.name);
+    }
+    if(is_global) {
+        gen_summary_add_definition(&ctx->definitions, node);
+        gen_global(ctx, node);
+    } else {
+        LLVMValueRef function = LLVMAddFunction(ctx->module, name, LLVMFunctionType(ctx->types.int64, NULL, 0, false));
+        LLVMPositionBuilderAtEnd(ctx->builder, LLVMAppendBasicBlockInContext(ctx->context, function, "entry"));
+        gen_scope_enter(&ctx->scope);
+        gen_entry_statement(ctx, node, &result);
+        gen_scope_exit(&ctx->scope);
+        if(LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder)) == NULL) LLVMBuildRet(ctx->builder, LLVMConstInt(ctx->types.int64, 0, false));
+    }
+    trace_end("gen", NULL);
+
+    char *message;
+    if(LLVMVerifyModule(ctx->module, LLVMReturnStatusAction, &message)) diag_error(node->diag_loc, "invalid entry: %s", message);
+    gen_run_passes(ctx->module, session->machine, session->options);
+
+    // Only publish symbols once the module is known to be good
+    for(size_t i = 0; i < ctx->function_count; i++) gen_summary_add_function(&session->summary, ctx->functions[i].name, ctx->functions[i].type, !LLVMIsDeclaration(ctx->functions[i].value));
+    if(node->type == IR_NODE_TYPE_STMT_DECL) gen_summary_add_variable(&session->summary, node->stmt_decl.name, node->stmt_decl.type);
+    if(node->type == IR_NODE_TYPE_GLOBAL_FUNCTION && node->global_function.is_comptime) gen_summary_add_function(&session->summary, node->global_function.decl.name, gen_make_function_type(&node->global_function.decl), true);
+    if(is_global) gen_summary_add_definition(&session->summary, node);
+
+    trace_begin("jit", NULL);
+    LLVMModuleRef module = ctx->module;
+    gen_context_free(ctx);
+    check(LLVMOrcLLJITAddLLVMIRModule(session->jit, session->dylib, LLVMOrcCreateNewThreadSafeModule(module, session->ts_context)), "failed to add the entry to the jit");
+    LLVMOrcJITTargetAddress address = 0;
+    if(!is_global) check(LLVMOrcLLJITLookup(session->jit, &address, name), "failed to look up the entry");
+    trace_end("jit", NULL);
+    result.compile_ns = trace_since(start).wall_ns;
+
+    if(address != 0) {
+        trace_begin("run", NULL);
+        result.value = ((uint64_t (*)()) address)();
+        fflush(stdout);
+        trace_end("run", NULL);
+    }
+    return result;
+}
\ No newline at end of file
@@ -1,32 +1,86 @@
 #include "gen.h"
 
-gen_scope_t *gen_scope_enter(gen_scope_t *current) {
-    gen_scope_t *scope = malloc(sizeof(gen_scope_t));
-    scope->outer = current;
-    scope->variable_count = 0;
-    scope->variables = NULL;
-    return scope;
+#define SCOPE_NONE SIZE_MAX
+#define SCOPE_INITIAL_CAPACITY 16
+
+size_t gen_hash_name(const char *name) {
+    size_t hash = 14695981039346656037u;
+    for(; *name != '\0'; name++) {
+        hash ^= (unsigned char) *name;
+        hash *= 1099511628211u;
+    }
+    return hash;
+}
+
+static gen_scope_slot_t *find_slot(gen_scope_slot_t *slots, size_t slot_capacity, const char *name, size_t hash) {
+    for(size_t i = hash & (slot_capacity - 1);; i = (i + 1) & (slot_capacity - 1)) {
+        gen_scope_slot_t *slot = &slots[i];
+        if(slot->name == NULL) return slot;
+        if(slot->hash == hash && strcmp(slot->name, name) == 0) return slot;
+    }
 }
 
-gen_scope_t *gen_scope_exit(gen_scope_t *scope) {
-    gen_scope_t *new = scope->outer;
-    free(scope->variables);
-    free(scope);
-    return new;
+static void grow_slots(gen_scope_t *scope) {
+    size_t slot_capacity = scope->slot_capacity == 0 ? SCOPE_INITIAL_CAPACITY : scope->slot_capacity * 2;
+    gen_scope_slot_t *slots = mem_calloc(MEM_SUBSYSTEM_SCOPES, slot_capacity, sizeof(gen_scope_slot_t));
+    for(size_t i = 0; i < scope->slot_capacity; i++) {
+        gen_scope_slot_t *slot = &scope->slots[i];
+        if(slot->name == NULL) continue;
+        *find_slot(slots, slot_capacity, slot->name, slot->hash) = *slot;
+    }
+    mem_free(MEM_SUBSYSTEM_SCOPES, scope->slots);
+    scope->slots = slots;
+    scope->slot_capacity = slot_capacity;
+}
+
+void gen_scope_enter(gen_scope_t *scope) {
+    if(scope->mark_count == scope->mark_capacity) {
+        scope->mark_capacity = scope->mark_capacity == 0 ? SCOPE_INITIAL_CAPACITY : scope->mark_capacity * 2;
+        scope->marks = mem_realloc(MEM_SUBSYSTEM_SCOPES, scope->marks, sizeof(size_t) * scope->mark_capacity);
+    }
+    scope->marks[scope->mark_count++] = scope->variable_count;
+}
+
+void gen_scope_exit(gen_scope_t *scope) {
+    assert(scope->mark_count > 0);
+    size_t mark = scope->marks[--scope->mark_count];
+    while(scope->variable_count > mark) {
+        gen_variable_t *var = &scope->variables[--scope->variable_count];
+        find_slot(scope->slots, scope->slot_capacity, var->name, var->hash)->variable = var->shadowed;
+    }
+}
+
+void gen_scope_free(gen_scope_t *scope) {
+    mem_free(MEM_SUBSYSTEM_SCOPES, scope->variables);
+    mem_free(MEM_SUBSYSTEM_SCOPES, scope->marks);
+    mem_free(MEM_SUBSYSTEM_SCOPES, scope->slots);
+    *scope = (gen_scope_t) {};
 }
 
 gen_variable_t *gen_scope_add_variable(gen_scope_t *scope, ir_type_t *type, const char *name, LLVMValueRef value) {
-    assert(scope != NULL);
-    scope->variables = realloc(scope->variables, sizeof(gen_variable_t) * ++scope->variable_count);
-    scope->variables[scope->variable_count - 1] = (gen_variable_t) { .type = type, .name = name, .value = value };
-    return &scope->variables[scope->variable_count - 1];
+    assert(scope->mark_count > 0);
+    if((scope->slot_count + 1) * 2 > scope->slot_capacity) grow_slots(scope);
+    if(scope->variable_count == scope->variable_capacity) {
+        scope->variable_capacity = scope->variable_capacity == 0 ? SCOPE_INITIAL_CAPACITY : scope->variable_capacity * 2;
+        scope->variables = mem_realloc(MEM_SUBSYSTEM_SCOPES, scope->variables, sizeof(gen_variable_t) * scope->variable_capacity);
+    }
+
+    size_t hash = gen_hash_name(name);
+    gen_scope_slot_t *slot = find_slot(scope->slots, scope->slot_capacity, name, hash);
+    if(slot->name == NULL) {
+        *slot = (gen_scope_slot_t) { .name = name, .hash = hash, .variable = SCOPE_NONE };
+        scope->slot_count++;
+    }
+
+    size_t index = scope->variable_count++;
+    scope->variables[index] = (gen_variable_t) { .type = type, .name = name, .value = value, .hash = hash, .shadowed = slot->variable };
+    slot->variable = index;
+    return &scope->variables[index];
 }
 
 gen_variable_t *gen_scope_get_variable(gen_scope_t *scope, const char *name) {
-    assert(scope != NULL);
-    for(size_t i = 0; i < scope->variable_count; i++) {
-        if(strcmp(name, scope->variables[i].name) != 0) continue;
-        return &scope->variables[i];
-    }
-    return gen_scope_get_variable(scope->outer, name);
+    if(scope->slot_capacity == 0) return NULL;
+    gen_scope_slot_t *slot = find_slot(scope->slots, scope->slot_capacity, name, gen_hash_name(name));
+    if(slot->name == NULL || slot->variable == SCOPE_NONE) return NULL;
+    return &scope->variables[slot->variable];
 }
\ No newline at end of file
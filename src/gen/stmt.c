@@ -1,9 +1,11 @@
 #include "gen.h"
 
 static void gen_stmt_block(gen_context_t *ctx, ir_node_t *node) {
-    ctx->scope = gen_scope_enter(ctx->scope);
+    LLVMMetadataRef debug_outer = gen_debug_block_enter(ctx, node->diag_loc);
+    gen_scope_enter(&ctx->scope);
     for(size_t i = 0; i < node->stmt_block.statement_count; i++) gen_stmt(ctx, node->stmt_block.statements[i]);
-    ctx->scope = gen_scope_exit(ctx->scope);
+    gen_scope_exit(&ctx->scope);
+    gen_debug_block_exit(ctx, debug_outer);
 }
 
 static void gen_stmt_return(gen_context_t *ctx, ir_node_t *node) {
@@ -87,13 +89,16 @@ static void gen_stmt_decl(gen_context_t *ctx, ir_node_t *node) {
     LLVMBasicBlockRef bb_entry = LLVMGetEntryBasicBlock(parent_func);
     LLVMPositionBuilder(entry_builder, bb_entry, LLVMGetFirstInstruction(bb_entry));
     LLVMValueRef value = LLVMBuildAlloca(entry_builder, gen_llvm_type(ctx, node->stmt_decl.type), node->stmt_decl.name);
+    LLVMSetAlignment(value, ir_type_align(node->stmt_decl.type));
     LLVMDisposeBuilder(entry_builder);
 
-    gen_scope_add_variable(ctx->scope, node->stmt_decl.type, node->stmt_decl.name, value);
+    gen_scope_add_variable(&ctx->scope, node->stmt_decl.type, node->stmt_decl.name, value);
+    gen_debug_variable(ctx, node->stmt_decl.name, node->stmt_decl.type, value, 0, node->diag_loc);
     if(node->stmt_decl.initial != NULL) LLVMBuildStore(ctx->builder, gen_expr(ctx, node->stmt_decl.initial, node->stmt_decl.type).value, value);
 }
 
 void gen_stmt(gen_context_t *ctx, ir_node_t *node) {
+    gen_debug_location(ctx, node->diag_loc);
     switch(node->type) {
         case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC:
         case IR_NODE_TYPE_EXPR_LITERAL_STRING:
@@ -104,6 +109,9 @@ void gen_stmt(gen_context_t *ctx, ir_node_t *node) {
         case IR_NODE_TYPE_EXPR_VAR:
         case IR_NODE_TYPE_EXPR_CALL:
         case IR_NODE_TYPE_EXPR_CAST:
+        case IR_NODE_TYPE_EXPR_COMPTIME:
+        case IR_NODE_TYPE_EXPR_INDEX:
+        case IR_NODE_TYPE_EXPR_MEMBER:
             gen_expr(ctx, node, NULL);
             break;
 
@@ -0,0 +1,131 @@
+#include "gen.h"
+
+#define SUMMARY_INITIAL_CAPACITY 64
+
+static gen_symbol_t *find_symbol(gen_symbol_t *symbols, size_t symbol_capacity, const char *name, size_t hash) {
+    for(size_t i = hash & (symbol_capacity - 1);; i = (i + 1) & (symbol_capacity - 1)) {
+        gen_symbol_t *symbol = &symbols[i];
+        if(symbol->name == NULL) return symbol;
+        if(symbol->hash == hash && strcmp(symbol->name, name) == 0) return symbol;
+    }
+}
+
+static gen_symbol_t *get_or_insert_symbol(gen_summary_t *summary, const char *name) {
+    if((summary->symbol_count + 1) * 2 > summary->symbol_capacity) {
+        size_t symbol_capacity = summary->symbol_capacity == 0 ? SUMMARY_INITIAL_CAPACITY : summary->symbol_capacity * 2;
+        gen_symbol_t *symbols = mem_calloc(MEM_SUBSYSTEM_CODEGEN, symbol_capacity, sizeof(gen_symbol_t));
+        for(size_t i = 0; i < summary->symbol_capacity; i++) {
+            gen_symbol_t *symbol = &summary->symbols[i];
+            if(symbol->name == NULL) continue;
+            *find_symbol(symbols, symbol_capacity, symbol->name, symbol->hash) = *symbol;
+        }
+        mem_free(MEM_SUBSYSTEM_CODEGEN, summary->symbols);
+        summary->symbols = symbols;
+        summary->symbol_capacity = symbol_capacity;
+    }
+
+    size_t hash = gen_hash_name(name);
+    gen_symbol_t *symbol = find_symbol(summary->symbols, summary->symbol_capacity, name, hash);
+    if(symbol->name != NULL) return symbol;
+    symbol->name = name;
+    symbol->hash = hash;
+    summary->symbol_count++;
+    return symbol;
+}
+
+static gen_symbol_t *insert_symbol(gen_summary_t *summary, const char *name) {
+    size_t symbol_count = summary->symbol_count;
+    gen_symbol_t *symbol = get_or_insert_symbol(summary, name);
+    return summary->symbol_count != symbol_count ? symbol : NULL;
+}
+
+// Definitions replace extern declarations, conflicting signatures are left for gen to report
+void gen_summary_add_function(gen_summary_t *summary, const char *name, gen_function_type_t type, bool is_defined) {
+    gen_symbol_t *symbol = get_or_insert_symbol(summary, name);
+    if(symbol->is_function && (symbol->is_defined || !is_defined)) return;
+    symbol->is_function = true;
+    symbol->is_defined = is_defined;
+    symbol->function = type;
+}
+
+void gen_summary_add_variable(gen_summary_t *summary, const char *name, ir_type_t *type) {
+    gen_symbol_t *symbol = insert_symbol(summary, name);
+    if(symbol == NULL) return;
+    symbol->is_function = false;
+    symbol->is_defined = true;
+    symbol->variable = type;
+}
+
+// Comptime reads bodies through the summary, a function wins over externs of the same name
+void gen_summary_add_definition(gen_summary_t *summary, ir_node_t *node) {
+    const char *name;
+    switch(node->type) {
+        case IR_NODE_TYPE_GLOBAL_FUNCTION: name = node->global_function.decl.name; break;
+        case IR_NODE_TYPE_GLOBAL_EXTERN: name = node->global_extern.decl.name; break;
+        case IR_NODE_TYPE_GLOBAL_VARIABLE: name = node->global_variable.name; break;
+        default: assert(false);
+    }
+    gen_symbol_t *symbol = get_or_insert_symbol(summary, name);
+    if(symbol->definition == NULL || node->type == IR_NODE_TYPE_GLOBAL_FUNCTION) symbol->definition = node;
+}
+
+void gen_summary_add_program(gen_summary_t *summary, ir_node_t *ast) {
+    assert(ast->type == IR_NODE_TYPE_PROGRAM);
+    for(size_t i = 0; i < ast->program.global_count; i++) {
+        ir_node_t *node = ast->program.globals[i];
+        switch(node->type) {
+            case IR_NODE_TYPE_GLOBAL_FUNCTION:
+                gen_symbol_t *existing = gen_summary_get(summary, node->global_function.decl.name);
+                if(existing != NULL && existing->is_defined) diag_error(node->diag_loc, "redefinition of '%s'", node->global_function.decl.name);
+                gen_summary_add_function(summary, node->global_function.decl.name, gen_make_function_type(&node->global_function.decl), true);
+                gen_summary_add_definition(summary, node);
+                break;
+            case IR_NODE_TYPE_GLOBAL_EXTERN:
+                gen_summary_add_function(summary, node->global_extern.decl.name, gen_make_function_type(&node->global_extern.decl), false);
+                gen_summary_add_definition(summary, node);
+                break;
+            case IR_NODE_TYPE_GLOBAL_VARIABLE:
+                if(gen_summary_get(summary, node->global_variable.name) != NULL) diag_error(node->diag_loc, "redefinition of '%s'", node->global_variable.name);
+                gen_summary_add_variable(summary, node->global_variable.name, node->global_variable.type);
+                gen_summary_add_definition(summary, node);
+                break;
+            case IR_NODE_TYPE_GLOBAL_IMPORT:
+            case IR_NODE_TYPE_GLOBAL_STRUCT:
+                break;
+            default: assert(false);
+        }
+    }
+}
+
+void gen_summary_add_interface(gen_summary_t *summary, gen_interface_t *interface) {
+    summary->interfaces = mem_realloc(MEM_SUBSYSTEM_CODEGEN, summary->interfaces, sizeof(gen_interface_t *) * ++summary->interface_count);
+    summary->interfaces[summary->interface_count - 1] = interface;
+}
+
+gen_symbol_t *gen_summary_get(gen_summary_t *summary, const char *name) {
+    if(summary->symbol_capacity == 0) return NULL;
+    gen_symbol_t *symbol = find_symbol(summary->symbols, summary->symbol_capacity, name, gen_hash_name(name));
+    return symbol->name != NULL ? symbol : NULL;
+}
+
+// The returned name outlives the lookup, it points into the summary or the mapped interface
+const char *gen_summary_find_function(gen_summary_t *summary, const char *name, gen_function_type_t *type) {
+    gen_symbol_t *symbol = gen_summary_get(summary, name);
+    if(symbol != NULL) {
+        if(!symbol->is_function) return NULL;
+        *type = symbol->function;
+        return symbol->name;
+    }
+    for(size_t i = 0; i < summary->interface_count; i++) {
+        const char *found = gen_interface_find_function(summary->interfaces[i], name, type);
+        if(found != NULL) return found;
+    }
+    return NULL;
+}
+
+void gen_summary_free(gen_summary_t *summary) {
+    for(size_t i = 0; i < summary->interface_count; i++) gen_interface_close(summary->interfaces[i]);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, summary->interfaces);
+    mem_free(MEM_SUBSYSTEM_CODEGEN, summary->symbols);
+    *summary = (gen_summary_t) {};
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "callgraph.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../mem.h"
+
+typedef struct {
+    const char *name;
+    size_t index;
+} name_entry_t;
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const name_entry_t *) a)->name, ((const name_entry_t *) b)->name);
+}
+
+static const char *global_name(ir_node_t *node) {
+    switch(node->type) {
+        case IR_NODE_TYPE_GLOBAL_FUNCTION: return node->global_function.decl.name;
+        case IR_NODE_TYPE_GLOBAL_EXTERN: return node->global_extern.decl.name;
+        case IR_NODE_TYPE_GLOBAL_IMPORT:
+        case IR_NODE_TYPE_GLOBAL_STRUCT:
+            return NULL;
+        case IR_NODE_TYPE_GLOBAL_VARIABLE: return node->global_variable.name;
+        default: assert(false);
+    }
+}
+
+static void add_callee(ir_callgraph_function_t *function, size_t callee) {
+    for(size_t i = 0; i < function->callee_count; i++) if(function->callees[i] == callee) return;
+    if(function->callee_count == function->callee_capacity) {
+        function->callee_capacity = function->callee_capacity == 0 ? 4 : function->callee_capacity * 2;
+        function->callees = mem_realloc(MEM_SUBSYSTEM_NODES, function->callees, sizeof(size_t) * function->callee_capacity);
+    }
+    function->callees[function->callee_count++] = callee;
+}
+
+typedef struct {
+    ir_callgraph_function_t *function;
+    name_entry_t *names;
+    size_t name_count;
+} walk_t;
+
+static void walk(ir_node_t *node, void *data) {
+    walk_t *walk = data;
+    walk->function->weight++;
+    // A local shadowing a global variable still counts as a use, keeping the global costs little
+    name_entry_t key;
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_CALL: key.name = node->expr_call.name; break;
+        case IR_NODE_TYPE_EXPR_VAR: key.name = node->expr_var.name; break;
+        default: return;
+    }
+    name_entry_t *entry = bsearch(&key, walk->names, walk->name_count, sizeof(name_entry_t), compare_entries);
+    // An extern and its definition share a name, the call depends on both
+    if(entry != NULL) while(entry > walk->names && strcmp(entry[-1].name, key.name) == 0) entry--;
+    for(; entry != NULL && entry < walk->names + walk->name_count && strcmp(entry->name, key.name) == 0; entry++) add_callee(walk->function, entry->index);
+}
+
+void ir_callgraph_build(ir_callgraph_t *callgraph, ir_node_t *program) {
+    assert(program->type == IR_NODE_TYPE_PROGRAM);
+    size_t count = program->program.global_count;
+    callgraph->function_count = count;
+    callgraph->functions = mem_calloc(MEM_SUBSYSTEM_NODES, count, sizeof(ir_callgraph_function_t));
+
+    name_entry_t *names = mem_alloc(MEM_SUBSYSTEM_NODES, sizeof(name_entry_t) * count);
+    size_t name_count = 0;
+    for(size_t i = 0; i < count; i++) {
+        callgraph->functions[i].node = program->program.globals[i];
+        const char *name = global_name(program->program.globals[i]);
+        if(name != NULL) names[name_count++] = (name_entry_t) { .name = name, .index = i };
+    }
+    qsort(names, name_count, sizeof(name_entry_t), compare_entries);
+
+    for(size_t i = 0; i < count; i++) {
+        ir_node_t *node = callgraph->functions[i].node;
+        walk_t data = { .function = &callgraph->functions[i], .names = names, .name_count = name_count };
+        if(node->type == IR_NODE_TYPE_GLOBAL_FUNCTION) ir_node_visit(node->global_function.body, walk, &data);
+        if(node->type == IR_NODE_TYPE_GLOBAL_VARIABLE) ir_node_visit(node->global_variable.initial, walk, &data);
+    }
+    mem_free(MEM_SUBSYSTEM_NODES, names);
+}
+
+void ir_callgraph_free(ir_callgraph_t *callgraph) {
+    for(size_t i = 0; i < callgraph->function_count; i++) mem_free(MEM_SUBSYSTEM_NODES, callgraph->functions[i].callees);
+    mem_free(MEM_SUBSYSTEM_NODES, callgraph->functions);
+    *callgraph = (ir_callgraph_t) {};
+}
+
+bool *ir_callgraph_reachable(ir_callgraph_t *callgraph, const char **roots, size_t root_count) {
+    bool *reachable = mem_calloc(MEM_SUBSYSTEM_NODES, callgraph->function_count, sizeof(bool));
+    size_t *worklist = mem_alloc(MEM_SUBSYSTEM_NODES, sizeof(size_t) * callgraph->function_count);
+    size_t worklist_count = 0;
+    for(size_t i = 0; i < callgraph->function_count; i++) {
+        const char *name = global_name(callgraph->functions[i].node);
+        for(size_t j = 0; name != NULL && j < root_count; j++) {
+            if(strcmp(name, roots[j]) != 0) continue;
+            reachable[i] = true;
+            worklist[worklist_count++] = i;
+            break;
+        }
+    }
+
+    // Every function enters the worklist at most once, when it is first marked
+    while(worklist_count > 0) {
+        ir_callgraph_function_t *function = &callgraph->functions[worklist[--worklist_count]];
+        for(size_t i = 0; i < function->callee_count; i++) {
+            if(reachable[function->callees[i]]) continue;
+            reachable[function->callees[i]] = true;
+            worklist[worklist_count++] = function->callees[i];
+        }
+    }
+    mem_free(MEM_SUBSYSTEM_NODES, worklist);
+    return reachable;
+}
+
+// Depth first from every root in source order, so a function lands right after its first caller
+static void order_functions(ir_callgraph_t *callgraph, size_t index, bool *visited, size_t *order, size_t *order_count) {
+    size_t stack_capacity = 16, stack_count = 0;
+    size_t *stack = mem_alloc(MEM_SUBSYSTEM_NODES, sizeof(size_t) * stack_capacity);
+    stack[stack_count++] = index;
+    while(stack_count > 0) {
+        ir_callgraph_function_t *function = &callgraph->functions[stack[--stack_count]];
+        size_t current = function - callgraph->functions;
+        if(visited[current]) continue;
+        visited[current] = true;
+        if(function->node->type != IR_NODE_TYPE_GLOBAL_FUNCTION) continue;
+        order[(*order_count)++] = current;
+        for(size_t i = function->callee_count; i > 0; i--) {
+            if(visited[function->callees[i - 1]]) continue;
+            if(stack_count == stack_capacity) stack = mem_realloc(MEM_SUBSYSTEM_NODES, stack, sizeof(size_t) * (stack_capacity *= 2));
+            stack[stack_count++] = function->callees[i - 1];
+        }
+    }
+    mem_free(MEM_SUBSYSTEM_NODES, stack);
+}
+
+ir_node_t **ir_callgraph_partition(ir_callgraph_t *callgraph, size_t count) {
+    assert(count > 0);
+    size_t function_count = callgraph->function_count;
+    bool *visited = mem_calloc(MEM_SUBSYSTEM_NODES, function_count, sizeof(bool));
+    size_t *order = mem_alloc(MEM_SUBSYSTEM_NODES, sizeof(size_t) * function_count);
+    size_t order_count = 0, extern_count = 0, variable_count = 0, total_weight = 0;
+    for(size_t i = 0; i < function_count; i++) {
+        if(callgraph->functions[i].node->type == IR_NODE_TYPE_GLOBAL_EXTERN) extern_count++;
+        if(callgraph->functions[i].node->type == IR_NODE_TYPE_GLOBAL_VARIABLE) variable_count++;
+        total_weight += callgraph->functions[i].weight;
+        order_functions(callgraph, i, visited, order, &order_count);
+    }
+
+    ir_node_t **programs = mem_alloc(MEM_SUBSYSTEM_NODES, sizeof(ir_node_t *) * count);
+    size_t next = 0, weight = 0;
+    for(size_t i = 0; i < count; i++) {
+        ir_node_t **globals = mem_alloc(MEM_SUBSYSTEM_NODES, sizeof(ir_node_t *) * (extern_count + variable_count + order_count));
+        size_t global_count = 0;
+        for(size_t j = 0; j < function_count; j++) {
+            ir_node_type_t type = callgraph->functions[j].node->type;
+            // Variables are defined once, the other programs declare them on first use
+            if(type == IR_NODE_TYPE_GLOBAL_EXTERN || (type == IR_NODE_TYPE_GLOBAL_VARIABLE && i == 0)) globals[global_count++] = callgraph->functions[j].node;
+        }
+
+        // Cut the ordering where the running weight crosses the next equal share
+        size_t limit = total_weight * (i + 1) / count;
+        while(next < order_count && (i == count - 1 || weight + callgraph->functions[order[next]].weight / 2 <= limit)) {
+            weight += callgraph->functions[order[next]].weight;
+            globals[global_count++] = callgraph->functions[order[next++]].node;
+        }
+        programs[i] = ir_node_make_program(global_count, globals, (diag_loc_t) {});
+    }
+
+    mem_free(MEM_SUBSYSTEM_NODES, visited);
+    mem_free(MEM_SUBSYSTEM_NODES, order);
+    return programs;
+}
\ No newline at end of file
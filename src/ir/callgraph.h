@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+#include "node.h"
+
+/*
+ * Call graph over the globals of a program, built from the calls and global variable uses in every function body.
+ * Externs and imports are nodes without callees, calls to names the program does not declare are ignored.
+ */
+
+typedef struct {
+    ir_node_t *node;
+    size_t weight;
+    size_t callee_count, callee_capacity;
+    size_t *callees;
+} ir_callgraph_function_t;
+
+typedef struct {
+    size_t function_count;
+    ir_callgraph_function_t *functions;
+} ir_callgraph_t;
+
+void ir_callgraph_build(ir_callgraph_t *callgraph, ir_node_t *program);
+void ir_callgraph_free(ir_callgraph_t *callgraph);
+
+/* Marks every function reachable through calls from the globals named in `roots`, indexed like `functions`. */
+bool *ir_callgraph_reachable(ir_callgraph_t *callgraph, const char **roots, size_t root_count);
+
+/* Splits the functions into `count` programs of similar weight, keeping callees next to their callers. Every program gets all externs, the first one all variables. */
+ir_node_t **ir_callgraph_partition(ir_callgraph_t *callgraph, size_t count);
\ No newline at end of file
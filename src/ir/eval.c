@@ -0,0 +1,353 @@
+#include "eval.h"
+#include <assert.h>
+#include <string.h>
+#include "../diag.h"
+#include "../mem.h"
+
+#define EVAL_DEPTH_LIMIT 1024
+
+typedef struct {
+    const char *name;
+    ir_eval_value_t value;
+    bool is_initialized;
+} variable_t;
+
+typedef struct {
+    ir_eval_options_t *options;
+    size_t steps;
+    size_t depth;
+    size_t variable_count, variable_capacity;
+    variable_t *variables;
+    size_t frame; // first variable of the innermost call
+    ir_type_t *return_type; // OPTIONAL, NULL outside of calls
+    ir_eval_value_t return_value;
+    size_t buffer_count, buffer_capacity;
+    uint64_t **buffers; // elements of every array, released together when the evaluation ends
+} eval_t;
+
+typedef enum {
+    FLOW_NEXT,
+    FLOW_RETURN
+} flow_t;
+
+static ir_eval_value_t eval_expr(eval_t *eval, ir_node_t *node, ir_type_t *type_expected);
+static flow_t eval_stmt(eval_t *eval, ir_node_t *node);
+
+static void step(eval_t *eval, ir_node_t *node) {
+    if(++eval->steps > eval->options->step_limit) diag_error(node->diag_loc, "comptime evaluation exceeded %lu steps", eval->options->step_limit);
+}
+
+static ir_eval_value_t make_value(ir_type_t *type, uint64_t bits) {
+    size_t width = type->integer.bit_size;
+    return (ir_eval_value_t) { .type = type, .bits = width == 64 ? bits : bits & ((UINT64_C(1) << width) - 1) };
+}
+
+static int64_t as_signed(ir_eval_value_t value) {
+    size_t width = value.type->integer.bit_size;
+    if(width == 64) return (int64_t) value.bits;
+    uint64_t sign = UINT64_C(1) << (width - 1);
+    return (int64_t) ((value.bits ^ sign) - sign);
+}
+
+// Integers in an array, one for anything else
+static size_t scalar_count(ir_type_t *type) {
+    size_t count = 1;
+    for(; ir_type_is_kind(type, IR_TYPE_KIND_ARRAY); type = type->array.base) count *= type->array.count;
+    return count;
+}
+
+static uint64_t *new_elements(eval_t *eval, ir_type_t *type) {
+    if(eval->buffer_count == eval->buffer_capacity) {
+        eval->buffer_capacity = eval->buffer_capacity == 0 ? 16 : eval->buffer_capacity * 2;
+        eval->buffers = mem_realloc(MEM_SUBSYSTEM_SCOPES, eval->buffers, sizeof(uint64_t *) * eval->buffer_capacity);
+    }
+    return eval->buffers[eval->buffer_count++] = mem_calloc(MEM_SUBSYSTEM_SCOPES, scalar_count(type), sizeof(uint64_t));
+}
+
+// Stored arrays get their own elements, assigning to one never changes another
+static ir_eval_value_t copy_value(eval_t *eval, ir_eval_value_t value) {
+    if(value.elements == NULL) return value;
+    uint64_t *elements = new_elements(eval, value.type);
+    memcpy(elements, value.elements, sizeof(uint64_t) * scalar_count(value.type));
+    value.elements = elements;
+    return value;
+}
+
+static void check_type(ir_node_t *node, ir_type_t *type) {
+    if(ir_type_is_kind(type, IR_TYPE_KIND_STRUCT)) diag_error(node->diag_loc, "structs have no value at compile time");
+    if(ir_type_is_kind(type, IR_TYPE_KIND_VECTOR)) diag_error(node->diag_loc, "vectors have no value at compile time");
+    if(!ir_type_is_kind(type, IR_TYPE_KIND_ARRAY)) return;
+    while(ir_type_is_kind(type, IR_TYPE_KIND_ARRAY)) type = type->array.base;
+    if(!ir_type_is_kind(type, IR_TYPE_KIND_INTEGER)) diag_error(node->diag_loc, "only arrays of integers have a value at compile time");
+}
+
+static variable_t *push_variable(eval_t *eval, ir_type_t *type, const char *name) {
+    if(eval->variable_count == eval->variable_capacity) {
+        eval->variable_capacity = eval->variable_capacity == 0 ? 16 : eval->variable_capacity * 2;
+        eval->variables = mem_realloc(MEM_SUBSYSTEM_SCOPES, eval->variables, sizeof(variable_t) * eval->variable_capacity);
+    }
+    variable_t *variable = &eval->variables[eval->variable_count++];
+    *variable = (variable_t) { .name = name, .value = { .type = type, .bits = 0 }, .is_initialized = false };
+    return variable;
+}
+
+// Only the innermost call is visible, runtime variables around the comptime expression never are
+static variable_t *get_variable(eval_t *eval, ir_node_t *node, const char *name) {
+    for(size_t i = eval->variable_count; i > eval->frame; i--) {
+        if(strcmp(eval->variables[i - 1].name, name) == 0) return &eval->variables[i - 1];
+    }
+    diag_error(node->diag_loc, "'%s' is not known at compile time", name);
+}
+
+static ir_eval_value_t eval_expr_var(eval_t *eval, ir_node_t *node) {
+    variable_t *variable = get_variable(eval, node, node->expr_var.name);
+    if(!variable->is_initialized) diag_error(node->diag_loc, "'%s' is read before it is assigned", node->expr_var.name);
+    return variable->value;
+}
+
+// Where the integers of an indexed array live, arrays in variables are read and written in place
+static uint64_t *eval_elements(eval_t *eval, ir_node_t *node, ir_type_t **type) {
+    if(node->type != IR_NODE_TYPE_EXPR_INDEX) {
+        ir_eval_value_t value = node->type == IR_NODE_TYPE_EXPR_VAR ? eval_expr_var(eval, node) : eval_expr(eval, node, NULL);
+        if(node->type != IR_NODE_TYPE_EXPR_VAR && ir_type_is_kind(value.type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "only arrays stored in variables can be indexed");
+        *type = value.type;
+        return value.elements;
+    }
+
+    ir_type_t *array_type;
+    uint64_t *elements = eval_elements(eval, node->expr_index.value, &array_type);
+    if(ir_type_is_kind(array_type, IR_TYPE_KIND_POINTER)) diag_error(node->diag_loc, "pointers have no value at compile time");
+    if(!ir_type_is_kind(array_type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "indexed value is neither an array nor a pointer");
+    ir_node_t *index_node = node->expr_index.index;
+    ir_eval_value_t index = eval_expr(eval, index_node, NULL);
+    if(!ir_type_is_kind(index.type, IR_TYPE_KIND_INTEGER)) diag_error(index_node->diag_loc, "array index is not an integer");
+    if(index.type->integer.is_signed && as_signed(index) < 0) diag_error(index_node->diag_loc, "index %ld is out of bounds of an array of %lu", as_signed(index), array_type->array.count);
+    if(index.bits >= array_type->array.count) diag_error(index_node->diag_loc, "index %lu is out of bounds of an array of %lu", index.bits, array_type->array.count);
+    *type = array_type->array.base;
+    return elements + index.bits * scalar_count(*type);
+}
+
+static ir_eval_value_t eval_expr_index(eval_t *eval, ir_node_t *node) {
+    ir_type_t *type;
+    uint64_t *elements = eval_elements(eval, node, &type);
+    if(ir_type_is_kind(type, IR_TYPE_KIND_ARRAY)) return (ir_eval_value_t) { .type = type, .elements = elements };
+    return make_value(type, elements[0]);
+}
+
+static ir_eval_value_t eval_expr_binary(eval_t *eval, ir_node_t *node) {
+    ir_eval_value_t right = eval_expr(eval, node->expr_binary.right, NULL);
+    if(ir_type_is_void(right.type)) diag_error(node->diag_loc, "rhs of binary expression is void");
+
+    if(node->expr_binary.operation == IR_BINARY_OPERATION_ASSIGN) {
+        ir_node_t *target = node->expr_binary.left;
+        if(target->type == IR_NODE_TYPE_EXPR_INDEX) {
+            ir_type_t *type;
+            uint64_t *elements = eval_elements(eval, target, &type);
+            if(!ir_type_is_eq(type, right.type)) diag_error(node->diag_loc, "conflicting types in assignment");
+            // The value can be part of the same array
+            if(right.elements != NULL) memmove(elements, right.elements, sizeof(uint64_t) * scalar_count(type));
+            else elements[0] = right.bits;
+            return right;
+        }
+        if(target->type == IR_NODE_TYPE_EXPR_MEMBER) diag_error(node->diag_loc, "structs have no value at compile time");
+        if(target->type != IR_NODE_TYPE_EXPR_VAR) diag_error(node->diag_loc, "pointers have no value at compile time");
+        variable_t *variable = get_variable(eval, target, target->expr_var.name);
+        if(!ir_type_is_eq(variable->value.type, right.type)) diag_error(node->diag_loc, "conflicting types in assignment");
+        variable->value = copy_value(eval, right);
+        variable->is_initialized = true;
+        return right;
+    }
+
+    ir_type_t *type = right.type;
+    ir_eval_value_t left = eval_expr(eval, node->expr_binary.left, NULL);
+    if(!ir_type_is_eq(type, left.type)) diag_error(node->diag_loc, "conflicting types in binary expression");
+    if(ir_type_is_kind(type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "invalid type in binary expression");
+
+    bool is_signed = type->integer.is_signed;
+    switch(node->expr_binary.operation) {
+        case IR_BINARY_OPERATION_EQUAL: return make_value(ir_type_get_bool(), left.bits == right.bits);
+        case IR_BINARY_OPERATION_NOT_EQUAL: return make_value(ir_type_get_bool(), left.bits != right.bits);
+        case IR_BINARY_OPERATION_ADDITION: return make_value(type, left.bits + right.bits);
+        case IR_BINARY_OPERATION_SUBTRACTION: return make_value(type, left.bits - right.bits);
+        case IR_BINARY_OPERATION_MULTIPLICATION: return make_value(type, left.bits * right.bits);
+        case IR_BINARY_OPERATION_DIVISION:
+        case IR_BINARY_OPERATION_MODULO:
+            // Both are undefined in the generated code, at compile time they are errors
+            if(right.bits == 0) diag_error(node->diag_loc, "division by zero at compile time");
+            bool is_division = node->expr_binary.operation == IR_BINARY_OPERATION_DIVISION;
+            if(!is_signed) return make_value(type, is_division ? left.bits / right.bits : left.bits % right.bits);
+            if(as_signed(right) == -1 && left.bits == UINT64_C(1) << (type->integer.bit_size - 1)) diag_error(node->diag_loc, "signed overflow in division at compile time");
+            return make_value(type, (uint64_t) (is_division ? as_signed(left) / as_signed(right) : as_signed(left) % as_signed(right)));
+        case IR_BINARY_OPERATION_GREATER: return make_value(ir_type_get_bool(), is_signed ? as_signed(left) > as_signed(right) : left.bits > right.bits);
+        case IR_BINARY_OPERATION_GREATER_EQUAL: return make_value(ir_type_get_bool(), is_signed ? as_signed(left) >= as_signed(right) : left.bits >= right.bits);
+        case IR_BINARY_OPERATION_LESS: return make_value(ir_type_get_bool(), is_signed ? as_signed(left) < as_signed(right) : left.bits < right.bits);
+        case IR_BINARY_OPERATION_LESS_EQUAL: return make_value(ir_type_get_bool(), is_signed ? as_signed(left) <= as_signed(right) : left.bits <= right.bits);
+        default: assert(false);
+    }
+}
+
+static ir_eval_value_t eval_expr_unary(eval_t *eval, ir_node_t *node) {
+    if(node->expr_unary.operation == IR_UNARY_OPERATION_REF || node->expr_unary.operation == IR_UNARY_OPERATION_DEREF) diag_error(node->diag_loc, "pointers have no value at compile time");
+    ir_eval_value_t operand = eval_expr(eval, node->expr_unary.operand, NULL);
+    if(ir_type_is_void(operand.type)) diag_error(node->diag_loc, "void in unary expression");
+    if(ir_type_is_kind(operand.type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "invalid type in unary expression");
+    switch(node->expr_unary.operation) {
+        case IR_UNARY_OPERATION_NOT: return make_value(ir_type_get_bool(), operand.bits == 0);
+        case IR_UNARY_OPERATION_NEGATIVE: return make_value(operand.type, -operand.bits);
+        default: assert(false);
+    }
+}
+
+static ir_eval_value_t eval_expr_call(eval_t *eval, ir_node_t *node) {
+    const char *name = node->expr_call.name;
+    ir_node_t *function = eval->options->find_global(name, eval->options->data);
+    if(function == NULL) diag_error(node->diag_loc, "no definition of '%s' to evaluate at compile time", name);
+    if(function->type == IR_NODE_TYPE_GLOBAL_VARIABLE) diag_error(node->diag_loc, "'%s' is not a function", name);
+    if(function->type != IR_NODE_TYPE_GLOBAL_FUNCTION) diag_error(node->diag_loc, "extern '%s' cannot be called at compile time", name);
+    ir_function_decl_t *decl = &function->global_function.decl;
+    if(node->expr_call.argument_count < decl->argument_count) diag_error(node->diag_loc, "missing arguments");
+    if(!decl->varargs && node->expr_call.argument_count > decl->argument_count) diag_error(node->diag_loc, "invalid number of arguments");
+    if(eval->depth == EVAL_DEPTH_LIMIT) diag_error(node->diag_loc, "comptime evaluation exceeded a call depth of %d", EVAL_DEPTH_LIMIT);
+
+    // Arguments see the caller's variables, the extra ones of a varargs call are evaluated and dropped
+    ir_eval_value_t arguments[node->expr_call.argument_count];
+    for(size_t i = 0; i < node->expr_call.argument_count; i++) arguments[i] = eval_expr(eval, node->expr_call.arguments[i], i < decl->argument_count ? decl->arguments[i].type : NULL);
+
+    size_t frame = eval->frame;
+    ir_type_t *return_type = eval->return_type;
+    eval->frame = eval->variable_count;
+    eval->return_type = decl->return_type;
+    for(size_t i = 0; i < decl->argument_count; i++) {
+        variable_t *variable = push_variable(eval, decl->arguments[i].type, decl->arguments[i].name);
+        variable->value = copy_value(eval, arguments[i]);
+        variable->is_initialized = true;
+    }
+
+    eval->depth++;
+    flow_t flow = eval_stmt(eval, function->global_function.body);
+    eval->depth--;
+    ir_eval_value_t value = { .type = decl->return_type, .bits = 0 };
+    if(!ir_type_is_void(decl->return_type)) {
+        if(flow != FLOW_RETURN) diag_error(node->diag_loc, "'%s' ended without returning a value", name);
+        value = eval->return_value;
+    }
+
+    eval->variable_count = eval->frame;
+    eval->frame = frame;
+    eval->return_type = return_type;
+    return value;
+}
+
+static ir_eval_value_t eval_expr_cast(eval_t *eval, ir_node_t *node) {
+    ir_eval_value_t value = eval_expr(eval, node->expr_cast.value, NULL);
+    ir_type_t *to_type = node->expr_cast.type;
+    if(ir_type_is_kind(to_type, IR_TYPE_KIND_VECTOR)) diag_error(node->diag_loc, "vectors have no value at compile time");
+    if(ir_type_is_kind(to_type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "array cast");
+    if(to_type->kind != value.type->kind) diag_error(node->diag_loc, "cast of incompatible types");
+    if(ir_type_is_void(to_type)) diag_error(node->diag_loc, "void cast");
+    if(value.type->integer.bit_size < to_type->integer.bit_size && to_type->integer.is_signed) return make_value(to_type, (uint64_t) as_signed(value));
+    return make_value(to_type, value.bits);
+}
+
+static ir_eval_value_t eval_expr(eval_t *eval, ir_node_t *node, ir_type_t *type_expected) {
+    step(eval, node);
+    ir_eval_value_t value;
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC: value = make_value(ir_type_get_u64(), node->expr_literal.numeric_value); break;
+        case IR_NODE_TYPE_EXPR_LITERAL_STRING: diag_error(node->diag_loc, "strings have no value at compile time");
+        case IR_NODE_TYPE_EXPR_LITERAL_CHAR: value = make_value(ir_type_get_char(), (unsigned char) node->expr_literal.char_value); break;
+        case IR_NODE_TYPE_EXPR_LITERAL_BOOL: value = make_value(ir_type_get_bool(), node->expr_literal.bool_value); break;
+        case IR_NODE_TYPE_EXPR_BINARY: value = eval_expr_binary(eval, node); break;
+        case IR_NODE_TYPE_EXPR_UNARY: value = eval_expr_unary(eval, node); break;
+        case IR_NODE_TYPE_EXPR_VAR: value = eval_expr_var(eval, node); break;
+        case IR_NODE_TYPE_EXPR_CALL: value = eval_expr_call(eval, node); break;
+        case IR_NODE_TYPE_EXPR_CAST: value = eval_expr_cast(eval, node); break;
+        case IR_NODE_TYPE_EXPR_COMPTIME: value = eval_expr(eval, node->expr_comptime.value, NULL); break;
+        case IR_NODE_TYPE_EXPR_INDEX: value = eval_expr_index(eval, node); break;
+        case IR_NODE_TYPE_EXPR_MEMBER: diag_error(node->diag_loc, "structs have no value at compile time");
+        default: assert(false);
+    }
+    if(type_expected != NULL && !ir_type_is_eq(value.type, type_expected)) diag_error(node->diag_loc, "conflicting types");
+    return value;
+}
+
+static flow_t eval_stmt_block(eval_t *eval, ir_node_t *node) {
+    size_t variable_count = eval->variable_count;
+    flow_t flow = FLOW_NEXT;
+    for(size_t i = 0; i < node->stmt_block.statement_count && flow == FLOW_NEXT; i++) flow = eval_stmt(eval, node->stmt_block.statements[i]);
+    eval->variable_count = variable_count;
+    return flow;
+}
+
+static flow_t eval_stmt_return(eval_t *eval, ir_node_t *node) {
+    if(eval->return_type == NULL) diag_error(node->diag_loc, "return statement outside of function");
+    if(ir_type_is_void(eval->return_type)) {
+        if(node->stmt_return.value != NULL) diag_error(node->diag_loc, "value returned from void function");
+        return FLOW_RETURN;
+    }
+    if(node->stmt_return.value == NULL) diag_error(node->diag_loc, "missing return value");
+    eval->return_value = eval_expr(eval, node->stmt_return.value, eval->return_type);
+    return FLOW_RETURN;
+}
+
+static flow_t eval_stmt_if(eval_t *eval, ir_node_t *node) {
+    if(eval_expr(eval, node->stmt_if.condition, ir_type_get_bool()).bits != 0) return eval_stmt(eval, node->stmt_if.body);
+    if(node->stmt_if.else_body != NULL) return eval_stmt(eval, node->stmt_if.else_body);
+    return FLOW_NEXT;
+}
+
+static flow_t eval_stmt_while(eval_t *eval, ir_node_t *node) {
+    while(node->stmt_while.condition == NULL || eval_expr(eval, node->stmt_while.condition, ir_type_get_bool()).bits != 0) {
+        if(eval_stmt(eval, node->stmt_while.body) == FLOW_RETURN) return FLOW_RETURN;
+    }
+    return FLOW_NEXT;
+}
+
+static flow_t eval_stmt_decl(eval_t *eval, ir_node_t *node) {
+    ir_type_t *type = node->stmt_decl.type;
+    check_type(node, type);
+    // In scope before its initializer like in the generated code, reading it there is an error
+    variable_t *variable = push_variable(eval, type, node->stmt_decl.name);
+    size_t index = eval->variable_count - 1;
+    if(ir_type_is_kind(type, IR_TYPE_KIND_ARRAY)) {
+        // Arrays start out zeroed, so tables can be filled one element at a time
+        variable->value.elements = new_elements(eval, type);
+        variable->is_initialized = true;
+    }
+    if(node->stmt_decl.initial == NULL) return FLOW_NEXT;
+    ir_eval_value_t value = copy_value(eval, eval_expr(eval, node->stmt_decl.initial, type));
+    eval->variables[index].value = value;
+    eval->variables[index].is_initialized = true;
+    return FLOW_NEXT;
+}
+
+static flow_t eval_stmt(eval_t *eval, ir_node_t *node) {
+    switch(node->type) {
+        case IR_NODE_TYPE_STMT_BLOCK: step(eval, node); return eval_stmt_block(eval, node);
+        case IR_NODE_TYPE_STMT_RETURN: step(eval, node); return eval_stmt_return(eval, node);
+        case IR_NODE_TYPE_STMT_IF: step(eval, node); return eval_stmt_if(eval, node);
+        case IR_NODE_TYPE_STMT_WHILE: step(eval, node); return eval_stmt_while(eval, node);
+        case IR_NODE_TYPE_STMT_DECL: step(eval, node); return eval_stmt_decl(eval, node);
+        default:
+            eval_expr(eval, node, NULL);
+            return FLOW_NEXT;
+    }
+}
+
+ir_eval_value_t ir_eval(ir_node_t *node, ir_eval_options_t *options) {
+    eval_t eval = { .options = options };
+    ir_eval_value_t value = eval_expr(&eval, node, NULL);
+    if(value.elements != NULL) {
+        uint64_t *elements = mem_alloc(MEM_SUBSYSTEM_SCOPES, sizeof(uint64_t) * scalar_count(value.type));
+        memcpy(elements, value.elements, sizeof(uint64_t) * scalar_count(value.type));
+        value.elements = elements;
+    }
+    for(size_t i = 0; i < eval.buffer_count; i++) mem_free(MEM_SUBSYSTEM_SCOPES, eval.buffers[i]);
+    mem_free(MEM_SUBSYSTEM_SCOPES, eval.buffers);
+    mem_free(MEM_SUBSYSTEM_SCOPES, eval.variables);
+    return value;
+}
+
+void ir_eval_value_free(ir_eval_value_t value) {
+    if(value.elements != NULL) mem_free(MEM_SUBSYSTEM_SCOPES, value.elements);
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "node.h"
+
+/*
+ * Interpreter behind comptime. Integers wrap at their width and divide, compare and extend with the
+ * signedness of their type, exactly like the code gen would emit for them. Arrays of integers are
+ * values that are copied when stored, like in the generated code. Pointers, strings, structs and
+ * externs have no value at compile time and are reported as errors.
+ */
+
+typedef struct {
+    ir_type_t *type;
+    uint64_t bits; // zero extended from the width of type
+    uint64_t *elements; // OPTIONAL, the bits of every integer of an array, nested arrays are flattened in order
+} ir_eval_value_t;
+
+typedef struct {
+    ir_node_t *(*find_global)(const char *name, void *data); // the function or extern behind a call, NULL when there is none
+    void *data;
+    size_t step_limit; // expressions and statements evaluated before giving up
+} ir_eval_options_t;
+
+/* The elements of the result belong to the caller and are released with ir_eval_value_free */
+ir_eval_value_t ir_eval(ir_node_t *node, ir_eval_options_t *options);
+void ir_eval_value_free(ir_eval_value_t value);
\ No newline at end of file
@@ -1,8 +1,9 @@
 #include "node.h"
 #include <stdlib.h>
+#include "../mem.h"
 
 static ir_node_t *make_node(ir_node_type_t type, diag_loc_t diag_loc) {
-    ir_node_t *node = malloc(sizeof(ir_node_t));
+    ir_node_t *node = mem_alloc(MEM_SUBSYSTEM_NODES, sizeof(ir_node_t));
     node->type = type;
     node->diag_loc = diag_loc;
     return node;
@@ -15,10 +16,11 @@ ir_node_t *ir_node_make_program(size_t global_count, ir_node_t **globals, diag_l
     return node;
 }
 
-ir_node_t *ir_node_make_global_function(ir_function_decl_t function_decl, ir_node_t *body, diag_loc_t diag_loc) {
+ir_node_t *ir_node_make_global_function(ir_function_decl_t function_decl, ir_node_t *body, bool is_comptime, diag_loc_t diag_loc) {
     ir_node_t *node = make_node(IR_NODE_TYPE_GLOBAL_FUNCTION, diag_loc);
     node->global_function.decl = function_decl;
     node->global_function.body = body;
+    node->global_function.is_comptime = is_comptime;
     return node;
 }
 
@@ -28,6 +30,26 @@ ir_node_t *ir_node_make_global_extern(ir_function_decl_t function_decl, diag_loc
     return node;
 }
 
+ir_node_t *ir_node_make_global_import(const char *name, diag_loc_t diag_loc) {
+    ir_node_t *node = make_node(IR_NODE_TYPE_GLOBAL_IMPORT, diag_loc);
+    node->global_import.name = name;
+    return node;
+}
+
+ir_node_t *ir_node_make_global_variable(ir_type_t *type, const char *name, ir_node_t *initial, diag_loc_t diag_loc) {
+    ir_node_t *node = make_node(IR_NODE_TYPE_GLOBAL_VARIABLE, diag_loc);
+    node->global_variable.type = type;
+    node->global_variable.name = name;
+    node->global_variable.initial = initial;
+    return node;
+}
+
+ir_node_t *ir_node_make_global_struct(ir_type_t *type, diag_loc_t diag_loc) {
+    ir_node_t *node = make_node(IR_NODE_TYPE_GLOBAL_STRUCT, diag_loc);
+    node->global_struct.type = type;
+    return node;
+}
+
 ir_node_t *ir_node_make_expr_literal_numeric(uintmax_t value, diag_loc_t diag_loc) {
     ir_node_t *node = make_node(IR_NODE_TYPE_EXPR_LITERAL_NUMERIC, diag_loc);
     node->expr_literal.numeric_value = value;
@@ -88,6 +110,26 @@ ir_node_t *ir_node_make_expr_cast(ir_node_t *value, ir_type_t *type, diag_loc_t
     return node;
 }
 
+ir_node_t *ir_node_make_expr_comptime(ir_node_t *value, diag_loc_t diag_loc) {
+    ir_node_t *node = make_node(IR_NODE_TYPE_EXPR_COMPTIME, diag_loc);
+    node->expr_comptime.value = value;
+    return node;
+}
+
+ir_node_t *ir_node_make_expr_index(ir_node_t *value, ir_node_t *index, diag_loc_t diag_loc) {
+    ir_node_t *node = make_node(IR_NODE_TYPE_EXPR_INDEX, diag_loc);
+    node->expr_index.value = value;
+    node->expr_index.index = index;
+    return node;
+}
+
+ir_node_t *ir_node_make_expr_member(ir_node_t *value, const char *name, diag_loc_t diag_loc) {
+    ir_node_t *node = make_node(IR_NODE_TYPE_EXPR_MEMBER, diag_loc);
+    node->expr_member.value = value;
+    node->expr_member.name = name;
+    return node;
+}
+
 ir_node_t *ir_node_make_stmt_block(size_t statement_count, ir_node_t **statements, diag_loc_t diag_loc) {
     ir_node_t *node = make_node(IR_NODE_TYPE_STMT_BLOCK, diag_loc);
     node->stmt_block.statement_count = statement_count;
@@ -122,4 +164,55 @@ ir_node_t *ir_node_make_stmt_decl(ir_type_t *type, const char *name, ir_node_t *
     node->stmt_decl.name = name;
     node->stmt_decl.initial = initial;
     return node;
+}
+
+void ir_node_visit(ir_node_t *node, void (*visit)(ir_node_t *node, void *data), void *data) {
+    if(node == NULL) return;
+    visit(node, data);
+    switch(node->type) {
+        case IR_NODE_TYPE_PROGRAM:
+            for(size_t i = 0; i < node->program.global_count; i++) ir_node_visit(node->program.globals[i], visit, data);
+            break;
+        case IR_NODE_TYPE_GLOBAL_FUNCTION: ir_node_visit(node->global_function.body, visit, data); break;
+        case IR_NODE_TYPE_GLOBAL_EXTERN: break;
+        case IR_NODE_TYPE_GLOBAL_IMPORT: break;
+        case IR_NODE_TYPE_GLOBAL_VARIABLE: ir_node_visit(node->global_variable.initial, visit, data); break;
+        case IR_NODE_TYPE_GLOBAL_STRUCT: break;
+
+        case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC: break;
+        case IR_NODE_TYPE_EXPR_LITERAL_STRING: break;
+        case IR_NODE_TYPE_EXPR_LITERAL_CHAR: break;
+        case IR_NODE_TYPE_EXPR_LITERAL_BOOL: break;
+        case IR_NODE_TYPE_EXPR_BINARY:
+            ir_node_visit(node->expr_binary.left, visit, data);
+            ir_node_visit(node->expr_binary.right, visit, data);
+            break;
+        case IR_NODE_TYPE_EXPR_UNARY: ir_node_visit(node->expr_unary.operand, visit, data); break;
+        case IR_NODE_TYPE_EXPR_VAR: break;
+        case IR_NODE_TYPE_EXPR_CALL:
+            for(size_t i = 0; i < node->expr_call.argument_count; i++) ir_node_visit(node->expr_call.arguments[i], visit, data);
+            break;
+        case IR_NODE_TYPE_EXPR_CAST: ir_node_visit(node->expr_cast.value, visit, data); break;
+        case IR_NODE_TYPE_EXPR_COMPTIME: ir_node_visit(node->expr_comptime.value, visit, data); break;
+        case IR_NODE_TYPE_EXPR_INDEX:
+            ir_node_visit(node->expr_index.value, visit, data);
+            ir_node_visit(node->expr_index.index, visit, data);
+            break;
+        case IR_NODE_TYPE_EXPR_MEMBER: ir_node_visit(node->expr_member.value, visit, data); break;
+
+        case IR_NODE_TYPE_STMT_BLOCK:
+            for(size_t i = 0; i < node->stmt_block.statement_count; i++) ir_node_visit(node->stmt_block.statements[i], visit, data);
+            break;
+        case IR_NODE_TYPE_STMT_RETURN: ir_node_visit(node->stmt_return.value, visit, data); break;
+        case IR_NODE_TYPE_STMT_IF:
+            ir_node_visit(node->stmt_if.condition, visit, data);
+            ir_node_visit(node->stmt_if.body, visit, data);
+            ir_node_visit(node->stmt_if.else_body, visit, data);
+            break;
+        case IR_NODE_TYPE_STMT_WHILE:
+            ir_node_visit(node->stmt_while.condition, visit, data);
+            ir_node_visit(node->stmt_while.body, visit, data);
+            break;
+        case IR_NODE_TYPE_STMT_DECL: ir_node_visit(node->stmt_decl.initial, visit, data); break;
+    }
 }
\ No newline at end of file
@@ -8,6 +8,9 @@ typedef enum {
 
     IR_NODE_TYPE_GLOBAL_FUNCTION,
     IR_NODE_TYPE_GLOBAL_EXTERN,
+    IR_NODE_TYPE_GLOBAL_IMPORT,
+    IR_NODE_TYPE_GLOBAL_VARIABLE,
+    IR_NODE_TYPE_GLOBAL_STRUCT,
 
     IR_NODE_TYPE_EXPR_LITERAL_NUMERIC,
     IR_NODE_TYPE_EXPR_LITERAL_STRING,
@@ -18,6 +21,9 @@ typedef enum {
     IR_NODE_TYPE_EXPR_VAR,
     IR_NODE_TYPE_EXPR_CALL,
     IR_NODE_TYPE_EXPR_CAST,
+    IR_NODE_TYPE_EXPR_COMPTIME,
+    IR_NODE_TYPE_EXPR_INDEX,
+    IR_NODE_TYPE_EXPR_MEMBER,
 
     IR_NODE_TYPE_STMT_BLOCK,
     IR_NODE_TYPE_STMT_RETURN,
@@ -74,10 +80,22 @@ typedef struct ir_node {
         struct {
             ir_function_decl_t decl;
             struct ir_node *body;
+            bool is_comptime; // never emitted, every call is evaluated while compiling
         } global_function;
         struct {
             ir_function_decl_t decl;
         } global_extern;
+        struct {
+            const char *name;
+        } global_import;
+        struct {
+            ir_type_t *type;
+            const char *name;
+            struct ir_node *initial; // OPTIONAL, evaluated while compiling
+        } global_variable;
+        struct {
+            ir_type_t *type; // the parser resolves every use of the name to this type
+        } global_struct;
 
         union {
             uintmax_t numeric_value;
@@ -105,6 +123,17 @@ typedef struct ir_node {
             struct ir_node *value;
             ir_type_t *type;
         } expr_cast;
+        struct {
+            struct ir_node *value;
+        } expr_comptime;
+        struct {
+            struct ir_node *value; // an array or a pointer
+            struct ir_node *index;
+        } expr_index;
+        struct {
+            struct ir_node *value; // a struct or a pointer to one
+            const char *name;
+        } expr_member;
 
         struct {
             size_t statement_count;
@@ -132,8 +161,11 @@ typedef struct ir_node {
 
 ir_node_t *ir_node_make_program(size_t global_count, ir_node_t **globals, diag_loc_t diag_loc);
 
-ir_node_t *ir_node_make_global_function(ir_function_decl_t function_decl, ir_node_t *body, diag_loc_t diag_loc);
+ir_node_t *ir_node_make_global_function(ir_function_decl_t function_decl, ir_node_t *body, bool is_comptime, diag_loc_t diag_loc);
 ir_node_t *ir_node_make_global_extern(ir_function_decl_t function_decl, diag_loc_t diag_loc);
+ir_node_t *ir_node_make_global_import(const char *name, diag_loc_t diag_loc);
+ir_node_t *ir_node_make_global_variable(ir_type_t *type, const char *name, ir_node_t *initial, diag_loc_t diag_loc);
+ir_node_t *ir_node_make_global_struct(ir_type_t *type, diag_loc_t diag_loc);
 
 ir_node_t *ir_node_make_expr_literal_numeric(uintmax_t value, diag_loc_t diag_loc);
 ir_node_t *ir_node_make_expr_literal_string(const char *value, diag_loc_t diag_loc);
@@ -144,9 +176,15 @@ ir_node_t *ir_node_make_expr_unary(ir_unary_operation_t operation, ir_node_t *op
 ir_node_t *ir_node_make_expr_var(const char *name, diag_loc_t diag_loc);
 ir_node_t *ir_node_make_expr_call(const char *name, size_t argument_count, ir_node_t **arguments, diag_loc_t diag_loc);
 ir_node_t *ir_node_make_expr_cast(ir_node_t *value, ir_type_t *type, diag_loc_t diag_loc);
+ir_node_t *ir_node_make_expr_comptime(ir_node_t *value, diag_loc_t diag_loc);
+ir_node_t *ir_node_make_expr_index(ir_node_t *value, ir_node_t *index, diag_loc_t diag_loc);
+ir_node_t *ir_node_make_expr_member(ir_node_t *value, const char *name, diag_loc_t diag_loc);
 
 ir_node_t *ir_node_make_stmt_block(size_t statement_count, ir_node_t **statements, diag_loc_t diag_loc);
 ir_node_t *ir_node_make_stmt_return(ir_node_t *value, diag_loc_t diag_loc);
 ir_node_t *ir_node_make_stmt_if(ir_node_t *condition, ir_node_t *body, ir_node_t *else_body, diag_loc_t diag_loc);
 ir_node_t *ir_node_make_stmt_while(ir_node_t *condition, ir_node_t *body, diag_loc_t diag_loc);
-ir_node_t *ir_node_make_stmt_decl(ir_type_t *type, const char *name, ir_node_t *initial, diag_loc_t diag_loc);
\ No newline at end of file
+ir_node_t *ir_node_make_stmt_decl(ir_type_t *type, const char *name, ir_node_t *initial, diag_loc_t diag_loc);
+
+/* Calls `visit` on the node and then on each of its children, in source order. */
+void ir_node_visit(ir_node_t *node, void (*visit)(ir_node_t *node, void *data), void *data);
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include "../mem.h"
 
 static ir_type_t
     *g_void = NULL,
@@ -15,9 +17,10 @@ static ir_type_t
     *g_i32 = NULL,
     *g_i64 = NULL,
     *g_bool = NULL;
+static pthread_once_t g_singletons_once = PTHREAD_ONCE_INIT;
 
 static ir_type_t *make_type(ir_type_kind_t kind) {
-    ir_type_t *type = malloc(sizeof(ir_type_t));
+    ir_type_t *type = mem_alloc(MEM_SUBSYSTEM_TYPES, sizeof(ir_type_t));
     type->kind = kind;
     return type;
 }
@@ -29,6 +32,20 @@ static ir_type_t *make_int_type(size_t bit_size, bool is_signed) {
     return type;
 }
 
+// Singletons are created up front, files are parsed on several threads
+static void make_singletons() {
+    g_void = make_type(IR_TYPE_KIND_VOID);
+    g_bool = make_int_type(1, false);
+    g_u8 = make_int_type(8, false);
+    g_u16 = make_int_type(16, false);
+    g_u32 = make_int_type(32, false);
+    g_u64 = make_int_type(64, false);
+    g_i8 = make_int_type(8, true);
+    g_i16 = make_int_type(16, true);
+    g_i32 = make_int_type(32, true);
+    g_i64 = make_int_type(64, true);
+}
+
 bool ir_type_is_kind(ir_type_t *type, ir_type_kind_t kind) {
     return type->kind == kind;
 }
@@ -37,23 +54,45 @@ bool ir_type_is_void(ir_type_t *type) {
     return ir_type_is_kind(type, IR_TYPE_KIND_VOID);
 }
 
-bool ir_type_is_eq(ir_type_t *a, ir_type_t *b) {
+// Structs are nominal, behind a pointer the name is enough so types pointing at themselves compare in finite time
+static bool is_eq(ir_type_t *a, ir_type_t *b, bool by_name) {
     if(a->kind != b->kind) return false;
     switch(a->kind) {
         case IR_TYPE_KIND_VOID: return true;
         case IR_TYPE_KIND_INTEGER: return a->integer.bit_size == b->integer.bit_size && a->integer.is_signed == b->integer.is_signed;
-        case IR_TYPE_KIND_POINTER: return ir_type_is_eq(a->pointer.base, b->pointer.base);
+        case IR_TYPE_KIND_POINTER: return is_eq(a->pointer.base, b->pointer.base, true);
+        case IR_TYPE_KIND_ARRAY: return a->array.count == b->array.count && is_eq(a->array.base, b->array.base, by_name);
+        case IR_TYPE_KIND_VECTOR: return a->vector.count == b->vector.count && is_eq(a->vector.base, b->vector.base, by_name);
+        case IR_TYPE_KIND_STRUCT:
+            if(a == b) return true;
+            if(strcmp(a->structure.name, b->structure.name) != 0) return false;
+            if(by_name) return true;
+            if(a->structure.is_complete != b->structure.is_complete || a->structure.size != b->structure.size || a->structure.align != b->structure.align) return false;
+            if(a->structure.field_count != b->structure.field_count) return false;
+            for(size_t i = 0; i < a->structure.field_count; i++) {
+                ir_type_field_t *x = &a->structure.fields[i], *y = &b->structure.fields[i];
+                if(strcmp(x->name, y->name) != 0 || x->offset != y->offset || !is_eq(x->type, y->type, false)) return false;
+            }
+            return true;
     }
     assert(false);
 }
 
+bool ir_type_is_eq(ir_type_t *a, ir_type_t *b) {
+    return is_eq(a, b, false);
+}
+
+bool ir_type_is_incomplete(ir_type_t *type) {
+    return type->kind == IR_TYPE_KIND_STRUCT && !type->structure.is_complete;
+}
+
 ir_type_t *ir_type_get_void() {
-    if(g_void == NULL) g_void = make_type(IR_TYPE_KIND_VOID);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_void;
 }
 
 ir_type_t *ir_type_get_bool() {
-    if(g_bool == NULL) g_bool = make_int_type(1, false);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_bool;
 }
 
@@ -66,22 +105,22 @@ ir_type_t *ir_type_get_uint() {
 }
 
 ir_type_t *ir_type_get_u8() {
-    if(g_u8 == NULL) g_u8 = make_int_type(8, false);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_u8;
 }
 
 ir_type_t *ir_type_get_u16() {
-    if(g_u16 == NULL) g_u16 = make_int_type(16, false);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_u16;
 }
 
 ir_type_t *ir_type_get_u32() {
-    if(g_u32 == NULL) g_u32 = make_int_type(32, false);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_u32;
 }
 
 ir_type_t *ir_type_get_u64() {
-    if(g_u64 == NULL) g_u64 = make_int_type(64, false);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_u64;
 }
 
@@ -90,22 +129,22 @@ ir_type_t *ir_type_get_int() {
 }
 
 ir_type_t *ir_type_get_i8() {
-    if(g_i8 == NULL) g_i8 = make_int_type(8, true);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_i8;
 }
 
 ir_type_t *ir_type_get_i16() {
-    if(g_i16 == NULL) g_i16 = make_int_type(16, true);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_i16;
 }
 
 ir_type_t *ir_type_get_i32() {
-    if(g_i32 == NULL) g_i32 = make_int_type(32, true);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_i32;
 }
 
 ir_type_t *ir_type_get_i64() {
-    if(g_i64 == NULL) g_i64 = make_int_type(64, true);
+    pthread_once(&g_singletons_once, make_singletons);
     return g_i64;
 }
 
@@ -115,6 +154,88 @@ ir_type_t *ir_type_make_pointer(ir_type_t *base) {
     return type;
 }
 
+ir_type_t *ir_type_make_array(ir_type_t *base, size_t count) {
+    ir_type_t *type = make_type(IR_TYPE_KIND_ARRAY);
+    type->array.base = base;
+    type->array.count = count;
+    return type;
+}
+
+ir_type_t *ir_type_make_vector(ir_type_t *base, size_t count) {
+    assert(base->kind == IR_TYPE_KIND_INTEGER && count > 0 && (count & (count - 1)) == 0);
+    ir_type_t *type = make_type(IR_TYPE_KIND_VECTOR);
+    type->vector.base = base;
+    type->vector.count = count;
+    return type;
+}
+
+ir_type_t *ir_type_make_struct(const char *name) {
+    ir_type_t *type = make_type(IR_TYPE_KIND_STRUCT);
+    type->structure = (typeof(type->structure)) { .name = name };
+    return type;
+}
+
+void ir_type_complete_struct(ir_type_t *type, size_t field_count, ir_type_field_t *fields, ir_type_layout_t layout) {
+    assert(type->kind == IR_TYPE_KIND_STRUCT && !type->structure.is_complete);
+    // align(N) only ever raises a field's alignment, in a packed struct it raises it from 1
+    for(size_t i = 0; i < field_count; i++) {
+        size_t natural = layout.is_packed ? 1 : ir_type_align(fields[i].type);
+        if(fields[i].align < natural) fields[i].align = natural;
+    }
+    // Stable, fields of equal alignment keep the order they were written in
+    for(size_t i = 1; layout.reorder && i < field_count; i++) {
+        ir_type_field_t field = fields[i];
+        size_t j = i;
+        for(; j > 0 && fields[j - 1].align < field.align; j--) fields[j] = fields[j - 1];
+        fields[j] = field;
+    }
+
+    size_t offset = 0, align = 1;
+    for(size_t i = 0; i < field_count; i++) {
+        offset = (offset + fields[i].align - 1) / fields[i].align * fields[i].align;
+        fields[i].offset = offset;
+        offset += ir_type_size(fields[i].type);
+        if(fields[i].align > align) align = fields[i].align;
+    }
+    if(layout.align > align) align = layout.align;
+    type->structure.is_complete = true;
+    type->structure.is_packed = layout.is_packed;
+    type->structure.size = (offset + align - 1) / align * align;
+    type->structure.align = align;
+    type->structure.field_count = field_count;
+    type->structure.fields = fields;
+}
+
+ir_type_field_t *ir_type_find_field(ir_type_t *type, const char *name) {
+    assert(type->kind == IR_TYPE_KIND_STRUCT);
+    for(size_t i = 0; i < type->structure.field_count; i++) if(strcmp(type->structure.fields[i].name, name) == 0) return &type->structure.fields[i];
+    return NULL;
+}
+
+size_t ir_type_size(ir_type_t *type) {
+    switch(type->kind) {
+        case IR_TYPE_KIND_VOID: return 0;
+        case IR_TYPE_KIND_POINTER: return 8;
+        case IR_TYPE_KIND_INTEGER: return (type->integer.bit_size + 7) / 8;
+        case IR_TYPE_KIND_ARRAY: return type->array.count * ir_type_size(type->array.base);
+        case IR_TYPE_KIND_STRUCT: return type->structure.size;
+        case IR_TYPE_KIND_VECTOR: return (type->vector.count * type->vector.base->integer.bit_size + 7) / 8;
+    }
+    assert(false);
+}
+
+size_t ir_type_align(ir_type_t *type) {
+    switch(type->kind) {
+        case IR_TYPE_KIND_VOID: return 1;
+        case IR_TYPE_KIND_POINTER: return 8;
+        case IR_TYPE_KIND_INTEGER: return ir_type_size(type);
+        case IR_TYPE_KIND_ARRAY: return ir_type_align(type->array.base);
+        case IR_TYPE_KIND_STRUCT: return type->structure.align;
+        case IR_TYPE_KIND_VECTOR: return ir_type_size(type);
+    }
+    assert(false);
+}
+
 void ir_type_print(ir_type_t *type) {
     switch(type->kind) {
         case IR_TYPE_KIND_VOID:
@@ -127,5 +248,17 @@ void ir_type_print(ir_type_t *type) {
         case IR_TYPE_KIND_INTEGER:
             printf("%c%lu", type->integer.is_signed ? 'i' : 'u', type->integer.bit_size);
             break;
+        case IR_TYPE_KIND_ARRAY:
+            ir_type_print(type->array.base);
+            printf("[%lu]", type->array.count);
+            break;
+        case IR_TYPE_KIND_STRUCT:
+            printf("struct %s", type->structure.name);
+            break;
+        case IR_TYPE_KIND_VECTOR:
+            printf("vec<");
+            ir_type_print(type->vector.base);
+            printf(", %lu>", type->vector.count);
+            break;
     }
 }
\ No newline at end of file
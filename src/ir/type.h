@@ -5,9 +5,25 @@
 typedef enum {
     IR_TYPE_KIND_VOID,
     IR_TYPE_KIND_POINTER,
-    IR_TYPE_KIND_INTEGER
+    IR_TYPE_KIND_INTEGER,
+    IR_TYPE_KIND_ARRAY,
+    IR_TYPE_KIND_STRUCT,
+    IR_TYPE_KIND_VECTOR
 } ir_type_kind_t;
 
+typedef struct {
+    const char *name;
+    struct type *type;
+    size_t offset; // in bytes from the start of the struct
+    size_t align; // requested with align(N) or 0, the alignment the field got once laid out
+} ir_type_field_t;
+
+typedef struct {
+    bool is_packed; // no padding between fields, the struct is byte aligned unless align(N) says otherwise
+    bool reorder; // fields may be sorted by decreasing alignment so they need less padding
+    size_t align; // OPTIONAL, 0 keeps the alignment of the widest field
+} ir_type_layout_t;
+
 typedef struct type {
     ir_type_kind_t kind;
     union {
@@ -18,12 +34,29 @@ typedef struct type {
         struct {
             struct type *base;
         } pointer;
+        struct {
+            struct type *base;
+            size_t count;
+        } array;
+        struct {
+            const char *name;
+            bool is_complete; // declared without fields until completed, only pointers to it work
+            bool is_packed;
+            size_t size, align;
+            size_t field_count;
+            ir_type_field_t *fields; // in memory order
+        } structure;
+        struct {
+            struct type *base; // an integer, bool for the masks comparisons produce
+            size_t count; // a power of two
+        } vector;
     };
 } ir_type_t;
 
 bool ir_type_is_kind(ir_type_t *type, ir_type_kind_t kind);
 bool ir_type_is_void(ir_type_t *type);
 bool ir_type_is_eq(ir_type_t *a, ir_type_t *b);
+bool ir_type_is_incomplete(ir_type_t *type);
 
 ir_type_t *ir_type_get_void();
 ir_type_t *ir_type_get_bool();
@@ -42,5 +75,22 @@ ir_type_t *ir_type_get_i32();
 ir_type_t *ir_type_get_i64();
 
 ir_type_t *ir_type_make_pointer(ir_type_t *base);
+ir_type_t *ir_type_make_array(ir_type_t *base, size_t count);
+ir_type_t *ir_type_make_vector(ir_type_t *base, size_t count);
+
+/*
+ * Structs are made incomplete so their fields can point back at them. Completing one lays the fields out in
+ * order, each at the next multiple of its alignment, and pads the size to a multiple of the struct's alignment.
+ */
+ir_type_t *ir_type_make_struct(const char *name);
+void ir_type_complete_struct(ir_type_t *type, size_t field_count, ir_type_field_t *fields, ir_type_layout_t layout);
+ir_type_field_t *ir_type_find_field(ir_type_t *type, const char *name); // NULL when there is none
+
+/*
+ * Size in bytes as laid out in memory, integers are rounded up to whole bytes. Vectors are naturally aligned
+ * and masks take a bit per element like LLVM stores them.
+ */
+size_t ir_type_size(ir_type_t *type);
+size_t ir_type_align(ir_type_t *type);
 
 void ir_type_print(ir_type_t *type);
\ No newline at end of file
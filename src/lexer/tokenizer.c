@@ -3,7 +3,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <pcre2.h>
+#include <pthread.h>
+#include <sched.h>
 #include "../diag.h"
+#include "../mem.h"
 
 typedef struct {
     const char *pattern;
@@ -25,6 +28,10 @@ static spec_t g_spec[] = {
     { .pattern = "^else", .type = TOKEN_TYPE_KEYWORD_ELSE },
     { .pattern = "^extern", .type = TOKEN_TYPE_KEYWORD_EXTERN },
     { .pattern = "^while", .type = TOKEN_TYPE_KEYWORD_WHILE },
+    { .pattern = "^import\\b", .type = TOKEN_TYPE_KEYWORD_IMPORT },
+    { .pattern = "^comptime\\b", .type = TOKEN_TYPE_KEYWORD_COMPTIME },
+    { .pattern = "^struct\\b", .type = TOKEN_TYPE_KEYWORD_STRUCT },
+    { .pattern = "^vec\\b", .type = TOKEN_TYPE_KEYWORD_VEC },
 
     { .pattern = "^0x[a-fA-F\\d]+", .type = TOKEN_TYPE_NUMBER_HEX },
     { .pattern = "^0b[01]+", .type = TOKEN_TYPE_NUMBER_BIN },
@@ -38,6 +45,7 @@ static spec_t g_spec[] = {
     { .pattern = "^[_a-zA-Z][_a-zA-Z0-9]*", .type = TOKEN_TYPE_IDENTIFIER },
 
     { .pattern = "^\\.\\.\\.", .type = TOKEN_TYPE_TRIPLE_PERIOD },
+    { .pattern = "^\\.", .type = TOKEN_TYPE_PERIOD },
     { .pattern = "^;", .type = TOKEN_TYPE_SEMI_COLON },
     { .pattern = "^==", .type = TOKEN_TYPE_EQUAL_EQUAL },
     { .pattern = "^=", .type = TOKEN_TYPE_EQUAL },
@@ -61,12 +69,24 @@ static spec_t g_spec[] = {
     { .pattern = "^\\)", .type = TOKEN_TYPE_PARENTHESES_RIGHT },
     { .pattern = "^{", .type = TOKEN_TYPE_BRACE_LEFT },
     { .pattern = "^}", .type = TOKEN_TYPE_BRACE_RIGHT },
+    { .pattern = "^\\[", .type = TOKEN_TYPE_BRACKET_LEFT },
+    { .pattern = "^\\]", .type = TOKEN_TYPE_BRACKET_RIGHT },
     { .pattern = "^,", .type = TOKEN_TYPE_COMMA },
     { .pattern = "^&", .type = TOKEN_TYPE_AMPERSAND }
 };
 
 static compiled_spec_t g_compiled_spec[sizeof(g_spec) / sizeof(spec_t)];
 static bool g_spec_is_compiled = false;
+static pthread_once_t g_spec_once = PTHREAD_ONCE_INIT;
+static pcre2_general_context *g_general_context = NULL;
+
+static void *general_context_malloc(size_t size, void *data) {
+    return mem_alloc(MEM_SUBSYSTEM_TOKENS, size);
+}
+
+static void general_context_free(void *ptr, void *data) {
+    mem_free(MEM_SUBSYSTEM_TOKENS, ptr);
+}
 
 static void print_pcre2_error(int error_code) {
     char error_message[120];
@@ -87,6 +107,7 @@ static bool compile_spec() {
         g_compiled_spec[i].type = g_spec[i].type;
         g_compiled_spec[i].pattern = code;
     }
+    g_general_context = pcre2_general_context_create(general_context_malloc, general_context_free, NULL);
     g_spec_is_compiled = true;
     return true;
 }
@@ -97,7 +118,7 @@ static token_t next_token(tokenizer_t *tokenizer) {
     const char *sub = tokenizer->source->data + tokenizer->cursor;
     size_t sub_length = tokenizer->source->data_length - tokenizer->cursor;
     for(size_t i = 0; i < sizeof(g_compiled_spec) / sizeof(compiled_spec_t); i++) {
-        pcre2_match_data *md = pcre2_match_data_create(1, NULL);
+        pcre2_match_data *md = pcre2_match_data_create(1, g_general_context);
         int match_count = pcre2_match(g_compiled_spec[i].pattern, (const uint8_t *) sub, sub_length, 0, 0, md, NULL);
         if(match_count <= 0) {
             pcre2_match_data_free(md);
@@ -119,21 +140,94 @@ static token_t next_token(tokenizer_t *tokenizer) {
 
         return (token_t) { .type = g_compiled_spec[i].type, .offset = offset, .length = size, .diag_loc = { .present = true, .offset = offset, .source = tokenizer->source } };
     }
-    diag_error((diag_loc_t) { .present = true, .offset = tokenizer->cursor, .source = tokenizer->source }, "unexpected symbol `%c`", *sub);
+    // Reported by whoever consumes the token, so a lexer thread never races the parser's diagnostics
+    return (token_t) { .type = TOKEN_TYPE_INTERNAL_ERROR, .offset = tokenizer->cursor, .length = 1, .diag_loc = { .present = true, .offset = tokenizer->cursor, .source = tokenizer->source } };
+}
+
+static token_t timed_next_token(tokenizer_t *tokenizer) {
+    if(!trace_enabled(TRACE_LEVEL_PHASES)) return next_token(tokenizer);
+    trace_time_t start = trace_now();
+    token_t token = next_token(tokenizer);
+    trace_time_t elapsed = trace_since(start);
+    tokenizer->lex_time.wall_ns += elapsed.wall_ns;
+    tokenizer->lex_time.cpu_ns += elapsed.cpu_ns;
+    return token;
+}
+
+static void ring_push(tokenizer_ring_t *ring, token_t token) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while(tail - atomic_load_explicit(&ring->head, memory_order_acquire) == TOKENIZER_RING_CAPACITY) sched_yield();
+    ring->tokens[tail % TOKENIZER_RING_CAPACITY] = token;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+static token_t ring_pop(tokenizer_ring_t *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    while(atomic_load_explicit(&ring->tail, memory_order_acquire) == head) sched_yield();
+    token_t token = ring->tokens[head % TOKENIZER_RING_CAPACITY];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return token;
+}
+
+static token_t read_token(tokenizer_t *tokenizer) {
+    token_t token = tokenizer->ring != NULL ? ring_pop(tokenizer->ring) : timed_next_token(tokenizer);
+    if(token.type == TOKEN_TYPE_INTERNAL_ERROR) diag_error(token.diag_loc, "unexpected symbol `%c`", tokenizer->source->data[token.offset]);
+    return token;
+}
+
+static void compile_spec_once() {
+    trace_begin("compile_spec", NULL);
+    compile_spec();
+    trace_end("compile_spec", NULL);
+}
+
+bool tokenizer_init() {
+    pthread_once(&g_spec_once, compile_spec_once);
+    return g_spec_is_compiled;
 }
 
 tokenizer_t *tokenizer_make(source_t *source) {
-    if(!g_spec_is_compiled && !compile_spec()) return NULL;
+    if(!tokenizer_init()) return NULL;
 
-    tokenizer_t *tokenizer = malloc(sizeof(tokenizer_t));
+    tokenizer_t *tokenizer = mem_alloc(MEM_SUBSYSTEM_TOKENS, sizeof(tokenizer_t));
     tokenizer->source = source;
     tokenizer->cursor = 0;
-    tokenizer->lookahead = next_token(tokenizer);
+    tokenizer->lex_time = (trace_time_t) {};
+    tokenizer->ring = NULL;
+    tokenizer->structs = NULL;
+    tokenizer->lookahead = read_token(tokenizer);
     return tokenizer;
 }
 
+tokenizer_t *tokenizer_make_from_ring(source_t *source, tokenizer_ring_t *ring) {
+    if(!tokenizer_init()) return NULL;
+
+    tokenizer_t *tokenizer = mem_alloc(MEM_SUBSYSTEM_TOKENS, sizeof(tokenizer_t));
+    tokenizer->source = source;
+    tokenizer->cursor = 0;
+    tokenizer->lex_time = (trace_time_t) {};
+    tokenizer->ring = ring;
+    tokenizer->structs = NULL;
+    tokenizer->lookahead = read_token(tokenizer);
+    return tokenizer;
+}
+
+// Lexes the whole source into the ring, the last token is either EOF or the first error
+void tokenizer_produce(source_t *source, tokenizer_ring_t *ring) {
+    bool is_compiled = tokenizer_init();
+    tokenizer_t tokenizer = { .source = source };
+    token_t token = { .type = TOKEN_TYPE_EOF, .diag_loc = { .present = false } };
+    do {
+        // The consumer refuses to start without a compiled spec, an EOF is enough to release it
+        if(is_compiled) token = timed_next_token(&tokenizer);
+        ring_push(ring, token);
+    } while(token.type != TOKEN_TYPE_EOF && token.type != TOKEN_TYPE_INTERNAL_ERROR);
+    trace_record("tokenize", tokenizer.lex_time);
+}
+
 void tokenizer_free(tokenizer_t *tokenizer) {
-    free(tokenizer);
+    if(tokenizer->ring == NULL) trace_record("tokenize", tokenizer->lex_time);
+    mem_free(MEM_SUBSYSTEM_TOKENS, tokenizer);
 }
 
 token_t tokenizer_peek(tokenizer_t *tokenizer) {
@@ -142,7 +236,8 @@ token_t tokenizer_peek(tokenizer_t *tokenizer) {
 
 token_t tokenizer_advance(tokenizer_t *tokenizer) {
     token_t token = tokenizer_peek(tokenizer);
-    tokenizer->lookahead = next_token(tokenizer);
+    // Nothing follows EOF in a ring, the lookahead stays put
+    if(token.type != TOKEN_TYPE_EOF || tokenizer->ring == NULL) tokenizer->lookahead = read_token(tokenizer);
     return token;
 }
 
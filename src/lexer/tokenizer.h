@@ -1,15 +1,36 @@
 #pragma once
 #include <stddef.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include "token.h"
 #include "../source.h"
+#include "../trace.h"
+
+#define TOKENIZER_RING_CAPACITY 4096
+
+/*
+ * Single producer, single consumer ring of tokens between a lexer thread and the parser.
+ * Each index is only written by one side, the other side reads it with acquire ordering.
+ */
+typedef struct {
+    alignas(64) atomic_size_t head; // next token to read, written by the consumer
+    alignas(64) atomic_size_t tail; // next slot to write, written by the producer
+    token_t tokens[TOKENIZER_RING_CAPACITY];
+} tokenizer_ring_t;
 
 typedef struct {
     source_t *source;
     size_t cursor;
     token_t lookahead;
+    trace_time_t lex_time;
+    tokenizer_ring_t *ring; // OPTIONAL, tokens come from a lexer thread instead of the source
+    struct parser_structs *structs; // OPTIONAL, owned by the parser, the repl hands it from one entry to the next
 } tokenizer_t;
 
+bool tokenizer_init(); // compiles the token spec once per process, makers call it themselves
 tokenizer_t *tokenizer_make(source_t *source);
+tokenizer_t *tokenizer_make_from_ring(source_t *source, tokenizer_ring_t *ring);
+void tokenizer_produce(source_t *source, tokenizer_ring_t *ring);
 void tokenizer_free(tokenizer_t *tokenizer);
 
 token_t tokenizer_advance(tokenizer_t *tokenizer);
@@ -0,0 +1,116 @@
+#include "libcharon.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "lexer/tokenizer.h"
+#include "parser/parser.h"
+#include "gen/gen.h"
+#include "diag.h"
+#include "trace.h"
+#include "mem.h"
+
+struct charon {
+    gen_options_t options;
+};
+
+charon_t *charon_make(charon_options_t options) {
+    if(options.opt_level > 3) return NULL;
+    // Shared state is built once per process, compiles only read it afterwards
+    if(!tokenizer_init()) return NULL;
+    ir_type_get_void();
+
+    char *passes;
+    if(options.passes != NULL) passes = strdup(options.passes);
+    else if(asprintf(&passes, "default<O%u>", options.opt_level) < 0) return NULL;
+
+    charon_t *charon = malloc(sizeof(charon_t));
+    charon->options = (gen_options_t) { .passes = passes, .debug = options.debug, .codegen_level = (LLVMCodeGenOptLevel) options.opt_level };
+    return charon;
+}
+
+void charon_free(charon_t *charon) {
+    free((char *) charon->options.passes);
+    free(charon);
+}
+
+static LLVMMemoryBufferRef compile(gen_options_t *options, source_t *source, LLVMContextRef context, LLVMTargetMachineRef machine) {
+    tokenizer_t *tokenizer = tokenizer_make(source);
+    ir_node_t *ast = parser_parse(tokenizer);
+    tokenizer_free(tokenizer);
+    for(size_t i = 0; i < ast->program.global_count; i++) {
+        if(ast->program.globals[i]->type == IR_NODE_TYPE_GLOBAL_IMPORT) diag_error(ast->program.globals[i]->diag_loc, "import is not supported by libcharon");
+    }
+
+    gen_summary_t summary = {};
+    gen_summary_add_program(&summary, ast);
+    options->summary = &summary;
+    LLVMModuleRef module = gen_module(ast, source, context, options);
+    gen_set_target(module, machine);
+    gen_run_passes(module, machine, options);
+    LLVMMemoryBufferRef output = gen_emit_to_memory(module, machine, options->emit);
+    gen_summary_free(&summary);
+    return output;
+}
+
+// Errors longjmp back here, whatever the compile allocated goes with its arena, the unwound codegen contexts and the LLVM context
+charon_result_t charon_compile(charon_t *charon, const char *name, const char *data, size_t length, charon_output_t output) {
+    static const gen_emit_t emits[] = {
+        [CHARON_OUTPUT_LLVM_IR] = GEN_EMIT_LLVM_IR,
+        [CHARON_OUTPUT_LLVM_BC] = GEN_EMIT_LLVM_BC,
+        [CHARON_OUTPUT_ASM] = GEN_EMIT_ASM,
+        [CHARON_OUTPUT_OBJ] = GEN_EMIT_OBJ
+    };
+    charon_result_t result = { .ok = false, .data = NULL, .size = 0, .diagnostics = NULL };
+    source_t source = { .name = name, .directory = NULL, .data_length = length, .data = data };
+    gen_options_t options = charon->options;
+    options.emit = emits[output];
+
+    size_t diagnostics_size;
+    FILE *stream = open_memstream(&result.diagnostics, &diagnostics_size);
+    if(stream == NULL) return result;
+    FILE *previous_stream = diag_set_stream(stream);
+    jmp_buf recovery;
+    jmp_buf *previous_recovery = diag_set_recovery(&recovery);
+    size_t trace_depth_outer = trace_depth();
+    size_t context_depth_outer = gen_context_depth();
+    mem_arena_t arena;
+    mem_arena_begin(&arena);
+
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMTargetMachineRef volatile machine = NULL;
+    LLVMMemoryBufferRef volatile buffer = NULL;
+    if(setjmp(recovery) == 0) {
+        machine = gen_target_machine(&options);
+        buffer = compile(&options, &source, context, machine);
+    } else {
+        trace_unwind(trace_depth_outer);
+        // The builders of an unfinished module are not part of the arena or the LLVM context
+        gen_context_unwind(context_depth_outer);
+    }
+
+    if(buffer != NULL) {
+        result.ok = true;
+        result.size = LLVMGetBufferSize(buffer);
+        result.data = malloc(result.size);
+        memcpy(result.data, LLVMGetBufferStart(buffer), result.size);
+        LLVMDisposeMemoryBuffer(buffer);
+    }
+    if(machine != NULL) LLVMDisposeTargetMachine(machine);
+    LLVMContextDispose(context);
+    mem_arena_end(&arena);
+    diag_set_recovery(previous_recovery);
+    diag_set_stream(previous_stream);
+    fclose(stream);
+    if(diagnostics_size == 0) {
+        free(result.diagnostics);
+        result.diagnostics = NULL;
+    }
+    return result;
+}
+
+void charon_result_free(charon_result_t *result) {
+    free(result->data);
+    free(result->diagnostics);
+    *result = (charon_result_t) {};
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+
+#define CHARON_API [[gnu::visibility("default")]]
+
+/*
+ * Embeddable compiler, built as build/libcharon.so. An instance holds the options of a build and can be
+ * shared by any number of threads. Every charon_compile call is independent: the source is read from memory,
+ * the output is returned in memory and errors end up in the result instead of exiting the process.
+ */
+
+typedef enum {
+    CHARON_OUTPUT_LLVM_IR,
+    CHARON_OUTPUT_LLVM_BC,
+    CHARON_OUTPUT_ASM,
+    CHARON_OUTPUT_OBJ
+} charon_output_t;
+
+typedef struct {
+    unsigned int opt_level; // 0 to 3
+    const char *passes; // OPTIONAL, a pass pipeline in place of default<O{opt_level}>
+    bool debug;
+} charon_options_t;
+
+typedef struct {
+    bool ok;
+    char *data; // OPTIONAL, the output when ok
+    size_t size;
+    char *diagnostics; // OPTIONAL, errors and warnings as printed by charon
+} charon_result_t;
+
+typedef struct charon charon_t;
+
+/* Returns NULL for invalid options or when the token spec fails to compile. */
+CHARON_API charon_t *charon_make(charon_options_t options);
+CHARON_API void charon_free(charon_t *charon);
+
+/* `name` is only used in diagnostics and debug info. Imports are not supported, there is no search path. */
+CHARON_API charon_result_t charon_compile(charon_t *charon, const char *name, const char *data, size_t length, charon_output_t output);
+CHARON_API void charon_result_free(charon_result_t *result);
\ No newline at end of file
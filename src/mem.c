@@ -0,0 +1,144 @@
+#include "mem.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <malloc.h>
+#include <sys/resource.h>
+
+typedef struct {
+    atomic_size_t allocations;
+    atomic_size_t bytes_total;
+    atomic_size_t bytes_live;
+} counter_t;
+
+static const char *g_subsystem_names[] = {
+    [MEM_SUBSYSTEM_TOKENS] = "tokens",
+    [MEM_SUBSYSTEM_NODES] = "ast nodes",
+    [MEM_SUBSYSTEM_STRINGS] = "strings",
+    [MEM_SUBSYSTEM_TYPES] = "types",
+    [MEM_SUBSYSTEM_SCOPES] = "scopes",
+    [MEM_SUBSYSTEM_CODEGEN] = "codegen",
+    [MEM_SUBSYSTEM_BYTECODE] = "bytecode"
+};
+
+static bool g_enabled = false;
+static counter_t g_counters[MEM_SUBSYSTEM_COUNT];
+static atomic_size_t g_module_bitcode_size, g_module_function_count;
+static thread_local mem_arena_t *g_arena = NULL;
+
+static void count_alloc(mem_subsystem_t subsystem, void *ptr) {
+    if(ptr == NULL) return;
+    size_t size = malloc_usable_size(ptr);
+    atomic_fetch_add_explicit(&g_counters[subsystem].allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_counters[subsystem].bytes_total, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_counters[subsystem].bytes_live, size, memory_order_relaxed);
+}
+
+static void count_free(mem_subsystem_t subsystem, void *ptr) {
+    if(ptr == NULL) return;
+    atomic_fetch_sub_explicit(&g_counters[subsystem].bytes_live, malloc_usable_size(ptr), memory_order_relaxed);
+}
+
+void mem_init(bool enabled) {
+    g_enabled = enabled;
+}
+
+bool mem_enabled() {
+    return g_enabled;
+}
+
+void mem_report(FILE *file, size_t source_size) {
+    if(!g_enabled) return;
+    fprintf(file, "\n-- Memory report\n");
+    fprintf(file, "%-16s %12s %16s %16s %14s\n", "subsystem", "allocations", "bytes (total)", "bytes (live)", "bytes/source");
+    size_t allocations = 0, bytes_total = 0, bytes_live = 0;
+    for(size_t i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        counter_t *counter = &g_counters[i];
+        fprintf(file, "%-16s %12lu %16lu %16lu %14.2f\n", g_subsystem_names[i], counter->allocations, counter->bytes_total, counter->bytes_live, source_size == 0 ? 0.0 : (double) counter->bytes_total / source_size);
+        allocations += counter->allocations;
+        bytes_total += counter->bytes_total;
+        bytes_live += counter->bytes_live;
+    }
+    fprintf(file, "%-16s %12lu %16lu %16lu %14.2f\n", "total", allocations, bytes_total, bytes_live, source_size == 0 ? 0.0 : (double) bytes_total / source_size);
+    fprintf(file, "%-16s %lu bytes of bitcode, %lu functions\n", "llvm module", g_module_bitcode_size, g_module_function_count);
+    fprintf(file, "%-16s %lu bytes\n", "source", source_size);
+    fprintf(file, "%-16s %lu KiB\n", "peak rss", mem_peak_rss_kb());
+}
+
+static size_t header_size() {
+    return g_arena != NULL ? sizeof(mem_block_t) : 0;
+}
+
+// Links a fresh allocation into the active arena, returns the pointer handed out
+static void *track(mem_subsystem_t subsystem, void *ptr) {
+    if(g_arena == NULL || ptr == NULL) return ptr;
+    mem_block_t *block = ptr;
+    *block = (mem_block_t) { .prev = NULL, .next = g_arena->blocks, .subsystem = subsystem };
+    if(block->next != NULL) block->next->prev = block;
+    g_arena->blocks = block;
+    return block + 1;
+}
+
+// Unlinks a pointer handed out by track, returns the allocation behind it
+static void *untrack(void *ptr) {
+    if(g_arena == NULL || ptr == NULL) return ptr;
+    mem_block_t *block = (mem_block_t *) ptr - 1;
+    if(block->prev != NULL) block->prev->next = block->next;
+    else g_arena->blocks = block->next;
+    if(block->next != NULL) block->next->prev = block->prev;
+    return block;
+}
+
+void *mem_alloc(mem_subsystem_t subsystem, size_t size) {
+    void *ptr = malloc(header_size() + size);
+    if(g_enabled) count_alloc(subsystem, ptr);
+    return track(subsystem, ptr);
+}
+
+void *mem_calloc(mem_subsystem_t subsystem, size_t count, size_t size) {
+    void *ptr = calloc(1, header_size() + count * size);
+    if(g_enabled) count_alloc(subsystem, ptr);
+    return track(subsystem, ptr);
+}
+
+void *mem_realloc(mem_subsystem_t subsystem, void *ptr, size_t size) {
+    ptr = untrack(ptr);
+    if(g_enabled) count_free(subsystem, ptr);
+    ptr = realloc(ptr, header_size() + size);
+    if(g_enabled) count_alloc(subsystem, ptr);
+    return track(subsystem, ptr);
+}
+
+void mem_free(mem_subsystem_t subsystem, void *ptr) {
+    ptr = untrack(ptr);
+    if(g_enabled) count_free(subsystem, ptr);
+    free(ptr);
+}
+
+void mem_arena_begin(mem_arena_t *arena) {
+    assert(g_arena == NULL);
+    arena->blocks = NULL;
+    g_arena = arena;
+}
+
+void mem_arena_end(mem_arena_t *arena) {
+    assert(g_arena == arena);
+    g_arena = NULL;
+    for(mem_block_t *block = arena->blocks, *next; block != NULL; block = next) {
+        next = block->next;
+        if(g_enabled) count_free(block->subsystem, block);
+        free(block);
+    }
+    arena->blocks = NULL;
+}
+
+void mem_set_module_size(size_t bitcode_size, size_t function_count) {
+    atomic_fetch_add(&g_module_bitcode_size, bitcode_size);
+    atomic_fetch_add(&g_module_function_count, function_count);
+}
+
+size_t mem_peak_rss_kb() {
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+}
\ No newline at end of file
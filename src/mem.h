@@ -0,0 +1,45 @@
+#pragma once
+#include <stddef.h>
+#include <stdio.h>
+#include <stdalign.h>
+
+typedef enum {
+    MEM_SUBSYSTEM_TOKENS,
+    MEM_SUBSYSTEM_NODES,
+    MEM_SUBSYSTEM_STRINGS,
+    MEM_SUBSYSTEM_TYPES,
+    MEM_SUBSYSTEM_SCOPES,
+    MEM_SUBSYSTEM_CODEGEN,
+    MEM_SUBSYSTEM_BYTECODE,
+    MEM_SUBSYSTEM_COUNT
+} mem_subsystem_t;
+
+/*
+ * While an arena is active on a thread, everything that thread allocates through mem_ is linked into it and
+ * mem_arena_end frees whatever is still live. Such memory must be freed on the same thread, before the arena
+ * ends, and nothing allocated outside the arena may be reallocated or freed while it is active.
+ */
+typedef struct mem_block {
+    alignas(max_align_t) struct mem_block *prev;
+    struct mem_block *next;
+    mem_subsystem_t subsystem;
+} mem_block_t;
+
+typedef struct {
+    mem_block_t *blocks;
+} mem_arena_t;
+
+void mem_init(bool enabled);
+bool mem_enabled();
+void mem_report(FILE *file, size_t source_size);
+
+void *mem_alloc(mem_subsystem_t subsystem, size_t size);
+void *mem_calloc(mem_subsystem_t subsystem, size_t count, size_t size);
+void *mem_realloc(mem_subsystem_t subsystem, void *ptr, size_t size);
+void mem_free(mem_subsystem_t subsystem, void *ptr);
+
+void mem_arena_begin(mem_arena_t *arena);
+void mem_arena_end(mem_arena_t *arena);
+
+void mem_set_module_size(size_t bitcode_size, size_t function_count);
+size_t mem_peak_rss_kb();
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string.h>
 #include "../lexer/token.h"
 #include "../diag.h"
+#include "../mem.h"
 
 static token_t consume(tokenizer_t *tokenizer, token_type_t type) {
     token_t token = tokenizer_advance(tokenizer);
@@ -24,14 +25,14 @@ static void expect(tokenizer_t *tokenizer, token_type_t type) {
 }
 
 static const char *make_text_from_token(tokenizer_t *tokenizer, token_t token) {
-    char *text = malloc(token.length + 1);
+    char *text = mem_alloc(MEM_SUBSYSTEM_STRINGS, token.length + 1);
     memcpy(text, tokenizer->source->data + token.offset, token.length);
     text[token.length] = '\0';
     return text;
 }
 
 static void free_text(tokenizer_t *tokenizer, const char *text) {
-    free((char *) text);
+    mem_free(MEM_SUBSYSTEM_STRINGS, (char *) text);
 }
 
 static ir_type_t *type_from_text(const char *text) {
@@ -51,18 +52,84 @@ static ir_type_t *type_from_text(const char *text) {
     return NULL;
 }
 
+static ir_node_t *parse_literal_numeric(tokenizer_t *tokenizer);
+
+static ir_type_t *find_struct(tokenizer_t *tokenizer, const char *name) {
+    parser_structs_t *structs = tokenizer->structs;
+    for(size_t i = 0; structs != NULL && i < structs->count; i++) if(strcmp(structs->types[i]->structure.name, name) == 0) return structs->types[i];
+    return NULL;
+}
+
+static ir_type_t *add_struct(tokenizer_t *tokenizer, const char *name) {
+    if(tokenizer->structs == NULL) tokenizer->structs = mem_calloc(MEM_SUBSYSTEM_NODES, 1, sizeof(parser_structs_t));
+    parser_structs_t *structs = tokenizer->structs;
+    structs->types = mem_realloc(MEM_SUBSYSTEM_NODES, structs->types, sizeof(ir_type_t *) * ++structs->count);
+    return structs->types[structs->count - 1] = ir_type_make_struct(name);
+}
+
+static ir_type_t *parse_struct_name(tokenizer_t *tokenizer, token_t token_identifier) {
+    const char *name = make_text_from_token(tokenizer, token_identifier);
+    ir_type_t *type = find_struct(tokenizer, name);
+    if(type == NULL) diag_error(token_identifier.diag_loc, "unknown struct '%s'", name);
+    free_text(tokenizer, name);
+    return type;
+}
+
+// Suffixes apply left to right, `int*[4]` holds four pointers and `int[4]*` points at an array
+static ir_type_t *parse_type_suffixes(tokenizer_t *tokenizer, ir_type_t *type) {
+    while(true) {
+        if(try_expect(tokenizer, TOKEN_TYPE_STAR)) {
+            type = ir_type_make_pointer(type);
+            continue;
+        }
+        if(!try_expect(tokenizer, TOKEN_TYPE_BRACKET_LEFT)) return type;
+        ir_node_t *count = parse_literal_numeric(tokenizer);
+        if(count->expr_literal.numeric_value == 0) diag_error(count->diag_loc, "array size must be greater than zero");
+        if(count->expr_literal.numeric_value > UINT32_MAX) diag_error(count->diag_loc, "array size too large");
+        if(ir_type_is_incomplete(type)) diag_error(count->diag_loc, "array of incomplete struct '%s'", type->structure.name);
+        expect(tokenizer, TOKEN_TYPE_BRACKET_RIGHT);
+        type = ir_type_make_array(type, count->expr_literal.numeric_value);
+    }
+}
+
+static ir_type_t *parse_type(tokenizer_t *tokenizer);
+
+// `vec<T, N>` holds N integers of type T, comparing two of them gives a `vec<bool, N>` mask
+static ir_type_t *parse_vector(tokenizer_t *tokenizer) {
+    expect(tokenizer, TOKEN_TYPE_LESS);
+    diag_loc_t diag_loc = tokenizer_peek(tokenizer).diag_loc;
+    ir_type_t *base = parse_type(tokenizer);
+    if(!ir_type_is_kind(base, IR_TYPE_KIND_INTEGER)) diag_error(diag_loc, "vector elements must be integers");
+    expect(tokenizer, TOKEN_TYPE_COMMA);
+    ir_node_t *count = parse_literal_numeric(tokenizer);
+    uintmax_t value = count->expr_literal.numeric_value;
+    if(value == 0 || value > 64 || (value & (value - 1)) != 0) diag_error(count->diag_loc, "vector length must be a power of two up to 64");
+    expect(tokenizer, TOKEN_TYPE_GREATER);
+    return ir_type_make_vector(base, value);
+}
+
 static ir_type_t *parse_type(tokenizer_t *tokenizer) {
+    if(try_expect(tokenizer, TOKEN_TYPE_KEYWORD_STRUCT)) return parse_type_suffixes(tokenizer, parse_struct_name(tokenizer, consume(tokenizer, TOKEN_TYPE_IDENTIFIER)));
+    if(try_expect(tokenizer, TOKEN_TYPE_KEYWORD_VEC)) return parse_type_suffixes(tokenizer, parse_vector(tokenizer));
     token_t token_type = consume(tokenizer, TOKEN_TYPE_TYPE);
     const char *text = make_text_from_token(tokenizer, token_type);
     ir_type_t *type = type_from_text(text);
     if(type == NULL) diag_error(token_type.diag_loc, "invalid type %s", text);
     free_text(tokenizer, text);
-    while(try_expect(tokenizer, TOKEN_TYPE_STAR)) type = ir_type_make_pointer(type);
-    return type;
+    return parse_type_suffixes(tokenizer, type);
+}
+
+// Values of a struct need its layout, only pointers to it work while it is declared without fields
+static void check_complete(ir_type_t *type, const char *name, diag_loc_t diag_loc) {
+    if(ir_type_is_incomplete(type)) diag_error(diag_loc, "'%s' has the incomplete type struct %s", name, type->structure.name);
+}
+
+static bool is_type_start(token_t token) {
+    return token.type == TOKEN_TYPE_TYPE || token.type == TOKEN_TYPE_KEYWORD_STRUCT || token.type == TOKEN_TYPE_KEYWORD_VEC;
 }
 
 static const char *string_escape(diag_loc_t diag_loc, const char *src, size_t src_length) {
-    char *dest = malloc(src_length + 1);
+    char *dest = mem_alloc(MEM_SUBSYSTEM_STRINGS, src_length + 1);
     int dest_index = 0;
     bool escaped = false;
     for(size_t i = 0; i < src_length; i++) {
@@ -120,6 +187,7 @@ static ir_node_t *helper_binary_operation(tokenizer_t *tokenizer, ir_node_t *(*f
 }
 
 static ir_node_t *parse_expression(tokenizer_t *tokenizer);
+static ir_node_t *parse_unary(tokenizer_t *tokenizer);
 static ir_node_t *parse_statement(tokenizer_t *tokenizer);
 
 static ir_node_t *parse_literal_numeric(tokenizer_t *tokenizer) {
@@ -181,7 +249,7 @@ static ir_node_t *parse_var_or_call(tokenizer_t *tokenizer) {
         ir_node_t **arguments = NULL;
         if(!try_expect(tokenizer, TOKEN_TYPE_PARENTHESES_RIGHT)) {
             do {
-                arguments = realloc(arguments, sizeof(ir_node_t *) * ++argument_count);
+                arguments = mem_realloc(MEM_SUBSYSTEM_NODES, arguments, sizeof(ir_node_t *) * ++argument_count);
                 arguments[argument_count - 1] = parse_expression(tokenizer);
             } while(try_expect(tokenizer, TOKEN_TYPE_COMMA));
             expect(tokenizer, TOKEN_TYPE_PARENTHESES_RIGHT);
@@ -193,7 +261,7 @@ static ir_node_t *parse_var_or_call(tokenizer_t *tokenizer) {
 
 static ir_node_t *parse_group_or_cast(tokenizer_t *tokenizer) {
     expect(tokenizer, TOKEN_TYPE_PARENTHESES_LEFT);
-    if(tokenizer_peek(tokenizer).type == TOKEN_TYPE_TYPE) {
+    if(is_type_start(tokenizer_peek(tokenizer))) {
         diag_loc_t type_diag_loc = tokenizer_peek(tokenizer).diag_loc;
         ir_type_t *type = parse_type(tokenizer);
         expect(tokenizer, TOKEN_TYPE_PARENTHESES_RIGHT);
@@ -205,16 +273,39 @@ static ir_node_t *parse_group_or_cast(tokenizer_t *tokenizer) {
     }
 }
 
+static ir_node_t *parse_comptime(tokenizer_t *tokenizer) {
+    token_t token_comptime = consume(tokenizer, TOKEN_TYPE_KEYWORD_COMPTIME);
+    return ir_node_make_expr_comptime(parse_unary(tokenizer), token_comptime.diag_loc);
+}
+
 static ir_node_t *parse_primary(tokenizer_t *tokenizer) {
     switch(tokenizer_peek(tokenizer).type) {
         case TOKEN_TYPE_IDENTIFIER: return parse_var_or_call(tokenizer);
         case TOKEN_TYPE_PARENTHESES_LEFT: return parse_group_or_cast(tokenizer);
+        case TOKEN_TYPE_KEYWORD_COMPTIME: return parse_comptime(tokenizer);
         default: return parse_literal(tokenizer);
     }
 }
 
+static ir_node_t *parse_postfix(tokenizer_t *tokenizer) {
+    ir_node_t *node = parse_primary(tokenizer);
+    while(true) {
+        if(tokenizer_peek(tokenizer).type == TOKEN_TYPE_PERIOD) {
+            token_t token_period = tokenizer_advance(tokenizer);
+            const char *name = make_text_from_token(tokenizer, consume(tokenizer, TOKEN_TYPE_IDENTIFIER));
+            node = ir_node_make_expr_member(node, name, token_period.diag_loc);
+            continue;
+        }
+        if(tokenizer_peek(tokenizer).type != TOKEN_TYPE_BRACKET_LEFT) return node;
+        token_t token_bracket = tokenizer_advance(tokenizer);
+        ir_node_t *index = parse_expression(tokenizer);
+        expect(tokenizer, TOKEN_TYPE_BRACKET_RIGHT);
+        node = ir_node_make_expr_index(node, index, token_bracket.diag_loc);
+    }
+}
+
 static ir_node_t *parse_unary(tokenizer_t *tokenizer) {
-    if(!token_match(tokenizer_peek(tokenizer), 4, TOKEN_TYPE_MINUS, TOKEN_TYPE_NOT, TOKEN_TYPE_STAR, TOKEN_TYPE_AMPERSAND)) return parse_primary(tokenizer);
+    if(!token_match(tokenizer_peek(tokenizer), 4, TOKEN_TYPE_MINUS, TOKEN_TYPE_NOT, TOKEN_TYPE_STAR, TOKEN_TYPE_AMPERSAND)) return parse_postfix(tokenizer);
     token_t token_operator = tokenizer_advance(tokenizer);
     ir_unary_operation_t operation;
     switch(token_operator.type) {
@@ -265,15 +356,19 @@ static ir_node_t *parse_expression(tokenizer_t *tokenizer) {
     return parse_assignment(tokenizer);
 }
 
-static ir_node_t *parse_decl(tokenizer_t *tokenizer) {
-    ir_type_t *type = parse_type(tokenizer);
-    token_t token_identifier = consume(tokenizer, TOKEN_TYPE_IDENTIFIER);
+static ir_node_t *parse_decl_rest(tokenizer_t *tokenizer, ir_type_t *type, token_t token_identifier) {
     const char *name = make_text_from_token(tokenizer, token_identifier);
+    check_complete(type, name, token_identifier.diag_loc);
     ir_node_t *initial = NULL;
     if(try_expect(tokenizer, TOKEN_TYPE_EQUAL)) initial = parse_expression(tokenizer);
     return ir_node_make_stmt_decl(type, name, initial, token_identifier.diag_loc);
 }
 
+static ir_node_t *parse_decl(tokenizer_t *tokenizer) {
+    ir_type_t *type = parse_type(tokenizer);
+    return parse_decl_rest(tokenizer, type, consume(tokenizer, TOKEN_TYPE_IDENTIFIER));
+}
+
 static ir_node_t *parse_return(tokenizer_t *tokenizer) {
     token_t token_return = consume(tokenizer, TOKEN_TYPE_KEYWORD_RETURN);
     ir_node_t *node_expression = NULL;
@@ -285,7 +380,11 @@ static ir_node_t *parse_simple_statement(tokenizer_t *tokenizer) {
     ir_node_t *node;
     switch(tokenizer_peek(tokenizer).type) {
         case TOKEN_TYPE_KEYWORD_RETURN: node = parse_return(tokenizer); break;
-        case TOKEN_TYPE_TYPE: node = parse_decl(tokenizer); break;
+        case TOKEN_TYPE_TYPE:
+        case TOKEN_TYPE_KEYWORD_STRUCT:
+        case TOKEN_TYPE_KEYWORD_VEC:
+            node = parse_decl(tokenizer);
+            break;
         default: node = parse_expression(tokenizer); break;
     }
     expect(tokenizer, TOKEN_TYPE_SEMI_COLON);
@@ -297,7 +396,7 @@ static ir_node_t *parse_block(tokenizer_t *tokenizer) {
     size_t statement_count = 0;
     ir_node_t **statements = NULL;
     while(!tokenizer_is_eof(tokenizer) && tokenizer_peek(tokenizer).type != TOKEN_TYPE_BRACE_RIGHT) {
-        statements = realloc(statements, sizeof(ir_node_t *) * ++statement_count);
+        statements = mem_realloc(MEM_SUBSYSTEM_NODES, statements, sizeof(ir_node_t *) * ++statement_count);
         statements[statement_count - 1] = parse_statement(tokenizer);
     }
     expect(tokenizer, TOKEN_TYPE_BRACE_RIGHT);
@@ -333,10 +432,9 @@ static ir_node_t *parse_statement(tokenizer_t *tokenizer) {
     }
 }
 
-static ir_function_decl_t parse_function_declaration(tokenizer_t *tokenizer, diag_loc_t *diag_loc) {
-    ir_type_t *return_type = parse_type(tokenizer);
-    token_t token_identifier = consume(tokenizer, TOKEN_TYPE_IDENTIFIER);
+static ir_function_decl_t parse_function_declaration_rest(tokenizer_t *tokenizer, ir_type_t *return_type, token_t token_identifier, diag_loc_t *diag_loc) {
     const char *name = make_text_from_token(tokenizer, token_identifier);
+    check_complete(return_type, name, token_identifier.diag_loc);
     bool varargs = false;
     size_t argument_count = 0;
     ir_function_decl_argument_t *arguments = NULL;
@@ -350,7 +448,8 @@ static ir_function_decl_t parse_function_declaration(tokenizer_t *tokenizer, dia
             diag_loc_t diag_loc = tokenizer_peek(tokenizer).diag_loc;
             ir_type_t *argument_type = parse_type(tokenizer);
             const char *argument_name = make_text_from_token(tokenizer, consume(tokenizer, TOKEN_TYPE_IDENTIFIER));
-            arguments = realloc(arguments, sizeof(ir_function_decl_argument_t) * ++argument_count);
+            check_complete(argument_type, argument_name, diag_loc);
+            arguments = mem_realloc(MEM_SUBSYSTEM_NODES, arguments, sizeof(ir_function_decl_argument_t) * ++argument_count);
             arguments[argument_count - 1] = (ir_function_decl_argument_t) {
                 .type = argument_type,
                 .name = argument_name,
@@ -369,24 +468,147 @@ static ir_function_decl_t parse_function_declaration(tokenizer_t *tokenizer, dia
     };
 }
 
-static ir_node_t *parse_function(tokenizer_t *tokenizer) {
-    diag_loc_t diag_loc;
-    ir_function_decl_t function_decl = parse_function_declaration(tokenizer, &diag_loc);
-    return ir_node_make_global_function(function_decl, parse_statement(tokenizer), diag_loc);
+static ir_function_decl_t parse_function_declaration(tokenizer_t *tokenizer, diag_loc_t *diag_loc) {
+    ir_type_t *return_type = parse_type(tokenizer);
+    return parse_function_declaration_rest(tokenizer, return_type, consume(tokenizer, TOKEN_TYPE_IDENTIFIER), diag_loc);
+}
+
+// Functions and variables share `type name`, the token after it decides
+static ir_node_t *parse_function_or_variable_rest(tokenizer_t *tokenizer, ir_type_t *type, bool is_comptime) {
+    token_t token_identifier = consume(tokenizer, TOKEN_TYPE_IDENTIFIER);
+    if(tokenizer_peek(tokenizer).type == TOKEN_TYPE_PARENTHESES_LEFT) {
+        diag_loc_t diag_loc;
+        ir_function_decl_t function_decl = parse_function_declaration_rest(tokenizer, type, token_identifier, &diag_loc);
+        return ir_node_make_global_function(function_decl, parse_statement(tokenizer), is_comptime, diag_loc);
+    }
+    if(is_comptime) diag_error(token_identifier.diag_loc, "comptime only applies to functions");
+    const char *name = make_text_from_token(tokenizer, token_identifier);
+    check_complete(type, name, token_identifier.diag_loc);
+    ir_node_t *initial = NULL;
+    if(try_expect(tokenizer, TOKEN_TYPE_EQUAL)) initial = parse_expression(tokenizer);
+    expect(tokenizer, TOKEN_TYPE_SEMI_COLON);
+    return ir_node_make_global_variable(type, name, initial, token_identifier.diag_loc);
+}
+
+static ir_node_t *parse_function_or_variable(tokenizer_t *tokenizer) {
+    bool is_comptime = try_expect(tokenizer, TOKEN_TYPE_KEYWORD_COMPTIME);
+    return parse_function_or_variable_rest(tokenizer, parse_type(tokenizer), is_comptime);
+}
+
+static size_t parse_align(tokenizer_t *tokenizer) {
+    expect(tokenizer, TOKEN_TYPE_PARENTHESES_LEFT);
+    ir_node_t *align = parse_literal_numeric(tokenizer);
+    uintmax_t value = align->expr_literal.numeric_value;
+    if(value == 0 || (value & (value - 1)) != 0) diag_error(align->diag_loc, "alignment must be a power of two");
+    if(value > 1 << 16) diag_error(align->diag_loc, "alignment too large");
+    expect(tokenizer, TOKEN_TYPE_PARENTHESES_RIGHT);
+    return value;
+}
+
+// Attributes are plain identifiers, they only mean something in front of a field or after the closing brace
+static const char *parse_attribute(tokenizer_t *tokenizer, token_t *token_attribute) {
+    *token_attribute = consume(tokenizer, TOKEN_TYPE_IDENTIFIER);
+    return make_text_from_token(tokenizer, *token_attribute);
+}
+
+static ir_node_t *parse_struct_definition(tokenizer_t *tokenizer, token_t token_identifier) {
+    const char *name = make_text_from_token(tokenizer, token_identifier);
+    ir_type_t *type = find_struct(tokenizer, name);
+    if(type != NULL && type->structure.is_complete) diag_error(token_identifier.diag_loc, "redefinition of struct '%s'", name);
+    // Known before the fields are, so they can point back at the struct
+    if(type == NULL) type = add_struct(tokenizer, name);
+
+    size_t field_count = 0;
+    ir_type_field_t *fields = NULL;
+    expect(tokenizer, TOKEN_TYPE_BRACE_LEFT);
+    while(!try_expect(tokenizer, TOKEN_TYPE_BRACE_RIGHT)) {
+        size_t align = 0;
+        if(tokenizer_peek(tokenizer).type == TOKEN_TYPE_IDENTIFIER) {
+            token_t token_attribute;
+            const char *attribute = parse_attribute(tokenizer, &token_attribute);
+            if(strcmp(attribute, "align") != 0) diag_error(token_attribute.diag_loc, "unknown field attribute '%s'", attribute);
+            free_text(tokenizer, attribute);
+            align = parse_align(tokenizer);
+        }
+        ir_type_t *field_type = parse_type(tokenizer);
+        token_t token_field = consume(tokenizer, TOKEN_TYPE_IDENTIFIER);
+        const char *field_name = make_text_from_token(tokenizer, token_field);
+        expect(tokenizer, TOKEN_TYPE_SEMI_COLON);
+        if(ir_type_is_void(field_type)) diag_error(token_field.diag_loc, "field '%s' is void", field_name);
+        check_complete(field_type, field_name, token_field.diag_loc);
+        for(size_t i = 0; i < field_count; i++) if(strcmp(fields[i].name, field_name) == 0) diag_error(token_field.diag_loc, "duplicate field '%s'", field_name);
+        fields = mem_realloc(MEM_SUBSYSTEM_NODES, fields, sizeof(ir_type_field_t) * ++field_count);
+        fields[field_count - 1] = (ir_type_field_t) { .name = field_name, .type = field_type, .align = align };
+    }
+    if(field_count == 0) diag_error(token_identifier.diag_loc, "struct '%s' has no fields", name);
+
+    ir_type_layout_t layout = {};
+    while(tokenizer_peek(tokenizer).type == TOKEN_TYPE_IDENTIFIER) {
+        token_t token_attribute;
+        const char *attribute = parse_attribute(tokenizer, &token_attribute);
+        if(strcmp(attribute, "packed") == 0) {
+            layout.is_packed = true;
+        } else if(strcmp(attribute, "reorder") == 0) {
+            layout.reorder = true;
+        } else if(strcmp(attribute, "align") == 0) {
+            layout.align = parse_align(tokenizer);
+        } else {
+            diag_error(token_attribute.diag_loc, "unknown struct attribute '%s'", attribute);
+        }
+        free_text(tokenizer, attribute);
+    }
+    expect(tokenizer, TOKEN_TYPE_SEMI_COLON);
+    ir_type_complete_struct(type, field_count, fields, layout);
+    return ir_node_make_global_struct(type, token_identifier.diag_loc);
+}
+
+// `struct name {` defines it and `struct name;` declares it, anything else uses it as the type of what follows
+static ir_node_t *parse_struct(tokenizer_t *tokenizer, ir_type_t **type) {
+    expect(tokenizer, TOKEN_TYPE_KEYWORD_STRUCT);
+    token_t token_identifier = consume(tokenizer, TOKEN_TYPE_IDENTIFIER);
+    if(tokenizer_peek(tokenizer).type == TOKEN_TYPE_BRACE_LEFT) return parse_struct_definition(tokenizer, token_identifier);
+    if(try_expect(tokenizer, TOKEN_TYPE_SEMI_COLON)) {
+        const char *name = make_text_from_token(tokenizer, token_identifier);
+        ir_type_t *declared = find_struct(tokenizer, name);
+        return ir_node_make_global_struct(declared != NULL ? declared : add_struct(tokenizer, name), token_identifier.diag_loc);
+    }
+    *type = parse_type_suffixes(tokenizer, parse_struct_name(tokenizer, token_identifier));
+    return NULL;
 }
 
 static ir_node_t *parse_extern(tokenizer_t *tokenizer) {
     expect(tokenizer, TOKEN_TYPE_KEYWORD_EXTERN);
     diag_loc_t diag_loc;
     ir_function_decl_t function_decl = parse_function_declaration(tokenizer, &diag_loc);
+    // Struct values have charon's layout, how C would pass them is not modelled, only pointers cross over.
+    // C has no array values at all, an array parameter there is a pointer to the first element
+    if(ir_type_is_kind(function_decl.return_type, IR_TYPE_KIND_STRUCT)) diag_error(diag_loc, "extern '%s' returns a struct by value, return it through a pointer", function_decl.name);
+    if(ir_type_is_kind(function_decl.return_type, IR_TYPE_KIND_ARRAY)) diag_error(diag_loc, "extern '%s' returns an array by value, return it through a pointer", function_decl.name);
+    for(size_t i = 0; i < function_decl.argument_count; i++) {
+        ir_function_decl_argument_t *argument = &function_decl.arguments[i];
+        if(ir_type_is_kind(argument->type, IR_TYPE_KIND_STRUCT)) diag_error(argument->diag_loc, "extern '%s' takes '%s' as a struct by value, pass a pointer", function_decl.name, argument->name);
+        if(ir_type_is_kind(argument->type, IR_TYPE_KIND_ARRAY)) diag_error(argument->diag_loc, "extern '%s' takes '%s' as an array by value, pass a pointer to its first element", function_decl.name, argument->name);
+    }
     expect(tokenizer, TOKEN_TYPE_SEMI_COLON);
     return ir_node_make_global_extern(function_decl, diag_loc);
 }
 
+static ir_node_t *parse_import(tokenizer_t *tokenizer) {
+    expect(tokenizer, TOKEN_TYPE_KEYWORD_IMPORT);
+    token_t token_identifier = consume(tokenizer, TOKEN_TYPE_IDENTIFIER);
+    expect(tokenizer, TOKEN_TYPE_SEMI_COLON);
+    return ir_node_make_global_import(make_text_from_token(tokenizer, token_identifier), token_identifier.diag_loc);
+}
+
 static ir_node_t *parse_global(tokenizer_t *tokenizer) {
     switch(tokenizer_peek(tokenizer).type) {
         case TOKEN_TYPE_KEYWORD_EXTERN: return parse_extern(tokenizer);
-        default: return parse_function(tokenizer);
+        case TOKEN_TYPE_KEYWORD_IMPORT: return parse_import(tokenizer);
+        case TOKEN_TYPE_KEYWORD_STRUCT:
+            ir_type_t *type;
+            ir_node_t *node = parse_struct(tokenizer, &type);
+            return node != NULL ? node : parse_function_or_variable_rest(tokenizer, type, false);
+        default: return parse_function_or_variable(tokenizer);
     }
 }
 
@@ -395,7 +617,7 @@ static ir_node_t *parse_program(tokenizer_t *tokenizer) {
     size_t global_count = 0;
     ir_node_t **globals = NULL;
     while(!tokenizer_is_eof(tokenizer)) {
-        globals = realloc(globals, sizeof(ir_node_t *) * ++global_count);
+        globals = mem_realloc(MEM_SUBSYSTEM_NODES, globals, sizeof(ir_node_t *) * ++global_count);
         globals[global_count - 1] = parse_global(tokenizer);
     }
     return ir_node_make_program(global_count, globals, diag_loc);
@@ -403,4 +625,51 @@ static ir_node_t *parse_program(tokenizer_t *tokenizer) {
 
 ir_node_t *parser_parse(tokenizer_t *tokenizer) {
     return parse_program(tokenizer);
+}
+
+ir_node_t *parser_parse_global(tokenizer_t *tokenizer) {
+    return parse_global(tokenizer);
+}
+
+ir_node_t *parser_parse_statement(tokenizer_t *tokenizer) {
+    return parse_statement(tokenizer);
+}
+
+ir_node_t *parser_parse_entry(tokenizer_t *tokenizer) {
+    bool is_comptime = false;
+    ir_type_t *type = NULL;
+    switch(tokenizer_peek(tokenizer).type) {
+        case TOKEN_TYPE_KEYWORD_EXTERN: return parse_extern(tokenizer);
+        case TOKEN_TYPE_TYPE:
+        case TOKEN_TYPE_KEYWORD_VEC:
+            break;
+        case TOKEN_TYPE_KEYWORD_STRUCT:
+            ir_node_t *definition = parse_struct(tokenizer, &type);
+            if(definition != NULL) return definition;
+            break;
+        case TOKEN_TYPE_KEYWORD_COMPTIME:
+            // With a single token of lookahead a leading comptime expression can only be a whole statement
+            token_t token_comptime = tokenizer_advance(tokenizer);
+            if(is_type_start(tokenizer_peek(tokenizer))) {
+                is_comptime = true;
+                break;
+            }
+            ir_node_t *node = ir_node_make_expr_comptime(parse_unary(tokenizer), token_comptime.diag_loc);
+            expect(tokenizer, TOKEN_TYPE_SEMI_COLON);
+            return node;
+        default: return parse_statement(tokenizer);
+    }
+
+    // Functions and declarations share `type name`, the token after it decides
+    if(type == NULL) type = parse_type(tokenizer);
+    token_t token_identifier = consume(tokenizer, TOKEN_TYPE_IDENTIFIER);
+    if(tokenizer_peek(tokenizer).type == TOKEN_TYPE_PARENTHESES_LEFT) {
+        diag_loc_t diag_loc;
+        ir_function_decl_t function_decl = parse_function_declaration_rest(tokenizer, type, token_identifier, &diag_loc);
+        return ir_node_make_global_function(function_decl, parse_statement(tokenizer), is_comptime, diag_loc);
+    }
+    if(is_comptime) diag_error(token_identifier.diag_loc, "comptime only applies to functions");
+    ir_node_t *node = parse_decl_rest(tokenizer, type, token_identifier);
+    expect(tokenizer, TOKEN_TYPE_SEMI_COLON);
+    return node;
 }
\ No newline at end of file
@@ -2,4 +2,13 @@
 #include "../lexer/tokenizer.h"
 #include "../ir/node.h"
 
-ir_node_t *parser_parse(tokenizer_t *tokenizer);
\ No newline at end of file
+/* Structs are resolved while parsing, a name refers to the struct defined or declared earlier in the source. */
+typedef struct parser_structs {
+    size_t count;
+    ir_type_t **types;
+} parser_structs_t;
+
+ir_node_t *parser_parse(tokenizer_t *tokenizer);
+ir_node_t *parser_parse_global(tokenizer_t *tokenizer);
+ir_node_t *parser_parse_statement(tokenizer_t *tokenizer);
+ir_node_t *parser_parse_entry(tokenizer_t *tokenizer); // global or statement, for the repl
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "lexer/tokenizer.h"
+#include "parser/parser.h"
+#include "diag.h"
+#include "trace.h"
+#include "mem.h"
+
+[[noreturn]] static void fail(const char *msg) {
+    fprintf(stderr, "ERROR(pipeline): %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+
+// The parser appends globals, codegen takes them in order, NULL once parsing is done and all were taken
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t available;
+    size_t global_count, next;
+    ir_node_t **globals;
+    bool is_done;
+} queue_t;
+
+typedef struct {
+    source_t *source;
+    tokenizer_ring_t *ring;
+} lexer_t;
+
+typedef struct {
+    queue_t *queue;
+    source_t *source;
+    const char *dest;
+    gen_options_t *options;
+    char *error;
+    size_t error_length;
+} codegen_t;
+
+static void queue_push(queue_t *queue, ir_node_t *node) {
+    pthread_mutex_lock(&queue->mutex);
+    queue->globals = mem_realloc(MEM_SUBSYSTEM_NODES, queue->globals, sizeof(ir_node_t *) * ++queue->global_count);
+    queue->globals[queue->global_count - 1] = node;
+    pthread_cond_signal(&queue->available);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static void queue_close(queue_t *queue) {
+    pthread_mutex_lock(&queue->mutex);
+    queue->is_done = true;
+    pthread_cond_signal(&queue->available);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static ir_node_t *queue_pop(void *data) {
+    queue_t *queue = data;
+    pthread_mutex_lock(&queue->mutex);
+    while(queue->next == queue->global_count && !queue->is_done) pthread_cond_wait(&queue->available, &queue->mutex);
+    ir_node_t *node = queue->next < queue->global_count ? queue->globals[queue->next++] : NULL;
+    pthread_mutex_unlock(&queue->mutex);
+    return node;
+}
+
+static void *lex(void *arg) {
+    lexer_t *lexer = arg;
+    tokenizer_produce(lexer->source, lexer->ring);
+    return NULL;
+}
+
+static void *codegen(void *arg) {
+    codegen_t *codegen = arg;
+    // A sequential build reports every parse error before any codegen error, so codegen holds its error until parsing is over
+    FILE *stream = open_memstream(&codegen->error, &codegen->error_length);
+    if(stream == NULL) fail("failed to buffer codegen errors");
+    FILE *previous_stream = diag_set_stream(stream);
+    jmp_buf recovery;
+    jmp_buf *previous_recovery = diag_set_recovery(&recovery);
+    if(setjmp(recovery) == 0) gen_stream(queue_pop, codegen->queue, codegen->source, codegen->dest, codegen->options);
+    else gen_context_unwind(0);
+    diag_set_recovery(previous_recovery);
+    diag_set_stream(previous_stream);
+    fclose(stream);
+    return NULL;
+}
+
+ir_node_t *pipeline_gen(source_t *source, const char *dest, gen_options_t *options) {
+    tokenizer_ring_t *ring = mem_alloc(MEM_SUBSYSTEM_TOKENS, sizeof(tokenizer_ring_t));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    queue_t queue = { .global_count = 0, .next = 0, .globals = NULL, .is_done = false };
+    pthread_mutex_init(&queue.mutex, NULL);
+    pthread_cond_init(&queue.available, NULL);
+
+    lexer_t lexer = { .source = source, .ring = ring };
+    codegen_t codegen_data = { .queue = &queue, .source = source, .dest = dest, .options = options, .error = NULL, .error_length = 0 };
+    pthread_t lexer_thread, codegen_thread;
+    if(pthread_create(&lexer_thread, NULL, lex, &lexer) != 0) fail("failed to create the lexer thread");
+    if(pthread_create(&codegen_thread, NULL, codegen, &codegen_data) != 0) fail("failed to create the codegen thread");
+
+    tokenizer_t *tokenizer = tokenizer_make_from_ring(source, ring);
+    if(tokenizer == NULL) fail("failed to initialize the tokenizer");
+    trace_begin("parse", NULL);
+    diag_loc_t diag_loc = tokenizer_peek(tokenizer).diag_loc;
+    while(!tokenizer_is_eof(tokenizer)) {
+        ir_node_t *node = parser_parse_global(tokenizer);
+        // Imports have to be resolved into the summary before codegen starts
+        if(node->type == IR_NODE_TYPE_GLOBAL_IMPORT) diag_error(node->diag_loc, "import is not supported with --pipeline");
+        queue_push(&queue, node);
+    }
+    queue_close(&queue);
+    tokenizer_free(tokenizer);
+    trace_end("parse", NULL);
+
+    pthread_join(lexer_thread, NULL);
+    pthread_join(codegen_thread, NULL);
+    mem_free(MEM_SUBSYSTEM_TOKENS, ring);
+    pthread_cond_destroy(&queue.available);
+    pthread_mutex_destroy(&queue.mutex);
+    if(codegen_data.error_length > 0) {
+        fwrite(codegen_data.error, 1, codegen_data.error_length, stderr);
+        exit(EXIT_FAILURE);
+    }
+    free(codegen_data.error);
+    return ir_node_make_program(queue.global_count, queue.globals, diag_loc);
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+#include "gen/gen.h"
+
+/*
+ * Lexes, parses and generates `source` on three threads at once. Tokens reach the parser through a ring,
+ * every global reaches codegen as soon as it is parsed and is lowered in source order, so the output matches
+ * a sequential build. Returns the program for --print-ast.
+ */
+ir_node_t *pipeline_gen(source_t *source, const char *dest, gen_options_t *options);
\ No newline at end of file
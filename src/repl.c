@@ -0,0 +1,98 @@
+#include "repl.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lexer/tokenizer.h"
+#include "parser/parser.h"
+#include "diag.h"
+#include "trace.h"
+
+// Input is buffered until brackets balance and it ends like a statement or a function body
+static bool is_complete(const char *buffer, size_t length) {
+    int depth = 0;
+    char quote = '\0';
+    for(size_t i = 0; i < length; i++) {
+        char c = buffer[i];
+        if(quote != '\0') {
+            if(c == quote) quote = '\0';
+            continue;
+        }
+        switch(c) {
+            case '"': case '\'': quote = c; break;
+            case '(': case '{': case '[': depth++; break;
+            case ')': case '}': case ']': depth--; break;
+        }
+    }
+    while(length > 0 && isspace(buffer[length - 1])) length--;
+    return depth <= 0 && length > 0 && (buffer[length - 1] == ';' || buffer[length - 1] == '}');
+}
+
+static void eval(gen_session_t *session, source_t *source, parser_structs_t **structs, bool report_latency, size_t *entry_count) {
+    jmp_buf recovery;
+    size_t trace_depth_outer = trace_depth();
+    size_t context_depth_outer = gen_context_depth();
+    jmp_buf *recovery_outer = diag_set_recovery(&recovery);
+    if(setjmp(recovery) != 0) {
+        // The error is already reported, the session carries on without the failed entry
+        trace_unwind(trace_depth_outer);
+        gen_context_unwind(context_depth_outer);
+        diag_set_recovery(recovery_outer);
+        return;
+    }
+
+    tokenizer_t *tokenizer = tokenizer_make(source);
+    if(tokenizer == NULL) diag_error((diag_loc_t) { .present = false }, "failed to initialize the tokenizer");
+    // Structs defined by earlier entries stay usable by name
+    tokenizer->structs = *structs;
+    while(!tokenizer_is_eof(tokenizer)) {
+        trace_time_t start = trace_now();
+        ir_node_t *node = parser_parse_entry(tokenizer);
+        trace_time_t parse_time = trace_since(start);
+        *structs = tokenizer->structs;
+
+        gen_session_result_t result = gen_session_eval(session, node);
+        if(result.has_value) printf(result.is_signed ? "= %ld\n" : "= %lu\n", result.value);
+        if(report_latency) fprintf(stderr, "entry %lu: parse %.3f ms, compile %.3f ms\n", (*entry_count)++, parse_time.wall_ns / 1e6, result.compile_ns / 1e6);
+    }
+    tokenizer_free(tokenizer);
+    diag_set_recovery(recovery_outer);
+}
+
+int repl_main(gen_options_t *options, bool report_latency) {
+    bool interactive = isatty(STDIN_FILENO);
+    gen_session_t *session = gen_session_make(options);
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    char *buffer = NULL;
+    size_t length = 0;
+    size_t entry_count = 0;
+    parser_structs_t *structs = NULL;
+    while(true) {
+        if(interactive) {
+            printf(length == 0 ? "> " : ". ");
+            fflush(stdout);
+        }
+        ssize_t line_length = getline(&line, &line_capacity, stdin);
+        if(line_length < 0) break;
+        buffer = realloc(buffer, length + line_length + 1);
+        memcpy(buffer + length, line, line_length + 1);
+        length += line_length;
+        if(!is_complete(buffer, length)) continue;
+
+        // Nodes keep pointing into the source for diagnostics, so it outlives the entry
+        source_t *source = malloc(sizeof(source_t));
+        *source = (source_t) { .name = "<repl>", .data = buffer, .data_length = length };
+        buffer = NULL;
+        length = 0;
+        eval(session, source, &structs, report_latency, &entry_count);
+    }
+    if(interactive) printf("\n");
+
+    gen_session_free(session);
+    free(buffer);
+    free(line);
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
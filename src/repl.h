@@ -0,0 +1,4 @@
+#pragma once
+#include "gen/gen.h"
+
+int repl_main(gen_options_t *options, bool report_latency);
\ No newline at end of file
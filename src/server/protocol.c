@@ -0,0 +1,147 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // struct ucred, the client is built without llvm's flags
+#endif
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+static bool write_all(int fd, const void *data, size_t size) {
+    for(size_t done = 0; done < size;) {
+        ssize_t written = write(fd, (const char *) data + done, size - done);
+        if(written <= 0) return false;
+        done += written;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *data, size_t size) {
+    for(size_t done = 0; done < size;) {
+        ssize_t count = read(fd, (char *) data + done, size - done);
+        if(count <= 0) return false;
+        done += count;
+    }
+    return true;
+}
+
+// /tmp is shared, another user could bind a predictable path there first, so only a directory nobody else can enter will do
+bool server_socket_path(char *path, size_t size) {
+    if(getenv("CHARON_SOCKET") != NULL) return snprintf(path, size, "%s", getenv("CHARON_SOCKET")) < (int) size;
+    if(getenv("XDG_RUNTIME_DIR") != NULL) return snprintf(path, size, "%s/charon.sock", getenv("XDG_RUNTIME_DIR")) < (int) size;
+    char directory[32];
+    snprintf(directory, sizeof(directory), "/tmp/charon-%u", (unsigned int) getuid());
+    if(mkdir(directory, 0700) != 0 && errno != EEXIST) return false;
+    struct stat info;
+    if(lstat(directory, &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 077) != 0) return false;
+    return snprintf(path, size, "%s/charon.sock", directory) < (int) size;
+}
+
+bool server_is_peer_trusted(int connection) {
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && credentials.uid == getuid();
+}
+
+bool server_send_request(int connection, int argc, char **argv) {
+    char *directory = getcwd(NULL, 0);
+    if(directory == NULL) return false;
+    const char *cc = getenv("CC") != NULL ? getenv("CC") : "";
+
+    size_t payload_size = strlen(directory) + 1 + strlen(cc) + 1;
+    for(int i = 0; i < argc; i++) payload_size += strlen(argv[i]) + 1;
+    if(payload_size > SERVER_MAX_PAYLOAD) {
+        free(directory);
+        return false;
+    }
+    char *payload = malloc(payload_size), *cursor = payload;
+    cursor = stpcpy(cursor, directory) + 1;
+    cursor = stpcpy(cursor, cc) + 1;
+    for(int i = 0; i < argc; i++) cursor = stpcpy(cursor, argv[i]) + 1;
+    free(directory);
+
+    // A closed standard stream cannot be passed, the compile gets /dev/null in its place
+    int fds[3];
+    for(int i = 0; i < 3; i++) fds[i] = fcntl(i, F_GETFD) >= 0 ? i : open("/dev/null", i == 0 ? O_RDONLY : O_WRONLY);
+
+    server_header_t header = { .version = SERVER_PROTOCOL_VERSION, .argument_count = argc, .payload_size = payload_size };
+    union {
+        char buffer[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control = {};
+    struct iovec iov = { .iov_base = &header, .iov_len = sizeof(header) };
+    struct msghdr message = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = sizeof(control.buffer) };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    bool ok = sendmsg(connection, &message, 0) == sizeof(header) && write_all(connection, payload, payload_size);
+    for(int i = 0; i < 3; i++) if(fds[i] != i && fds[i] >= 0) close(fds[i]);
+    free(payload);
+    return ok;
+}
+
+bool server_receive_request(int connection, server_request_t *request) {
+    server_header_t header;
+    union {
+        char buffer[CMSG_SPACE(sizeof(request->fds))];
+        struct cmsghdr align;
+    } control = {};
+    struct iovec iov = { .iov_base = &header, .iov_len = sizeof(header) };
+    struct msghdr message = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = sizeof(control.buffer) };
+    if(recvmsg(connection, &message, MSG_CMSG_CLOEXEC) != sizeof(header)) return false;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    if(cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(request->fds))) return false;
+    memcpy(request->fds, CMSG_DATA(cmsg), sizeof(request->fds));
+    request->payload = NULL;
+    request->argv = NULL;
+    if(header.version != SERVER_PROTOCOL_VERSION || header.payload_size > SERVER_MAX_PAYLOAD || header.argument_count > header.payload_size) goto invalid;
+
+    request->payload = malloc(header.payload_size + 1);
+    if(!read_all(connection, request->payload, header.payload_size)) goto invalid;
+    request->payload[header.payload_size] = '\0';
+
+    // Every string has to end inside the payload
+    char *cursor = request->payload, *end = request->payload + header.payload_size;
+    request->directory = cursor;
+    request->argc = header.argument_count + 1;
+    request->argv = malloc(sizeof(char *) * (request->argc + 1));
+    request->argv[0] = "charon";
+    for(uint32_t i = 0; i < header.argument_count + 2; i++) {
+        if(cursor >= end) goto invalid;
+        if(i == 1) request->cc = cursor;
+        if(i >= 2) request->argv[i - 1] = cursor;
+        cursor += strlen(cursor) + 1;
+    }
+    request->argv[request->argc] = NULL;
+    return true;
+
+invalid:
+    server_free_request(request);
+    return false;
+}
+
+void server_free_request(server_request_t *request) {
+    for(int i = 0; i < 3; i++) close(request->fds[i]);
+    free(request->payload);
+    free(request->argv);
+}
+
+bool server_send_status(int connection, int status) {
+    int32_t value = status;
+    return write_all(connection, &value, sizeof(value));
+}
+
+bool server_receive_status(int connection, int *status) {
+    int32_t value;
+    if(!read_all(connection, &value, sizeof(value))) return false;
+    *status = value;
+    return true;
+}
\ No newline at end of file
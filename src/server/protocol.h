@@ -0,0 +1,42 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define SERVER_PROTOCOL_VERSION 1
+#define SERVER_MAX_PAYLOAD (1 << 20)
+
+/*
+ * A request is a header that carries the client's stdin, stdout and stderr as SCM_RIGHTS, followed by
+ * `payload_size` bytes of NUL terminated strings: the working directory, $CC (empty when unset) and then
+ * `argument_count` arguments. The reply is the exit status of the compile as an int32_t.
+ */
+typedef struct {
+    uint32_t version;
+    uint32_t argument_count;
+    uint32_t payload_size;
+} server_header_t;
+
+typedef struct {
+    int fds[3];
+    char *payload;
+    const char *directory;
+    const char *cc;
+    int argc;
+    char **argv; // argv[0] is "charon", like a command line invocation
+} server_request_t;
+
+/*
+ * $CHARON_SOCKET, otherwise charon.sock in $XDG_RUNTIME_DIR, otherwise in /tmp/charon-<uid> which is created 0700.
+ * False when the path does not fit or that directory is not private to the current user.
+ */
+bool server_socket_path(char *path, size_t size);
+
+/* Whether the other end of the connection runs as the current user, both sides check before trusting it. */
+bool server_is_peer_trusted(int connection);
+
+bool server_send_request(int connection, int argc, char **argv);
+bool server_receive_request(int connection, server_request_t *request);
+void server_free_request(server_request_t *request);
+
+bool server_send_status(int connection, int status);
+bool server_receive_status(int connection, int *status);
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "protocol.h"
+#include "../lexer/tokenizer.h"
+#include "../ir/type.h"
+#include "../gen/gen.h"
+
+static volatile sig_atomic_t g_is_stopping = false;
+
+[[noreturn]] static void fail(const char *msg) {
+    fprintf(stderr, "ERROR(server): %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+
+[[noreturn]] static void fail_perror(const char *msg) {
+    fprintf(stderr, "ERROR(server): %s: %s\n", msg, strerror(errno));
+    exit(EXIT_FAILURE);
+}
+
+static void stop(int sig) {
+    g_is_stopping = true;
+}
+
+static void warm_up() {
+    if(!tokenizer_init()) fail("failed to compile the token spec");
+    ir_type_get_void();
+    LLVMDisposeTargetMachine(gen_target_machine(&(gen_options_t) { .codegen_level = LLVMCodeGenLevelNone }));
+}
+
+// Every request runs in a fork of the worker, a failing compile exits like it would on the command line
+static void handle(int listener, int connection, int (*compile)(int argc, char **argv)) {
+    server_request_t request;
+    if(!server_receive_request(connection, &request)) {
+        fprintf(stderr, "ERROR(server): invalid request\n");
+        return;
+    }
+
+    fflush(NULL);
+    pid_t pid = fork();
+    if(pid == 0) {
+        close(listener);
+        close(connection);
+        for(int i = 0; i < 3; i++) if(dup2(request.fds[i], i) < 0) _exit(EXIT_FAILURE);
+        if(chdir(request.directory) != 0) {
+            fprintf(stderr, "ERROR(server): cannot enter %s: %s\n", request.directory, strerror(errno));
+            _exit(EXIT_FAILURE);
+        }
+        if(request.cc[0] != '\0') setenv("CC", request.cc, 1);
+        else unsetenv("CC");
+        exit(compile(request.argc, request.argv));
+    }
+
+    int status = EXIT_FAILURE, wait_status;
+    if(pid > 0 && waitpid(pid, &wait_status, 0) == pid) status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 128 + WTERMSIG(wait_status);
+    server_send_status(connection, status);
+    server_free_request(&request);
+}
+
+static pid_t spawn_worker(int listener, int (*compile)(int argc, char **argv)) {
+    pid_t pid = fork();
+    if(pid != 0) return pid;
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    for(;;) {
+        int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if(connection < 0) {
+            if(errno == EINTR || errno == ECONNABORTED) continue;
+            fail_perror("accept failed");
+        }
+        // A request runs commands as this user, nobody else gets to send one
+        if(!server_is_peer_trusted(connection)) {
+            fprintf(stderr, "ERROR(server): rejected a connection from another user\n");
+            close(connection);
+            continue;
+        }
+        handle(listener, connection, compile);
+        close(connection);
+    }
+}
+
+int server_main(const char *socket_path, size_t worker_count, int (*compile)(int argc, char **argv)) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if(strlen(socket_path) >= sizeof(address.sun_path)) fail("socket path is too long");
+    strcpy(address.sun_path, socket_path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listener < 0) fail_perror("cannot create the socket");
+    // A socket nobody accepts on is left over from a server that did not shut down
+    if(connect(listener, (struct sockaddr *) &address, sizeof(address)) == 0) fail("a server is already listening on this socket");
+    close(listener);
+    unlink(socket_path);
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listener < 0) fail_perror("cannot create the socket");
+    if(bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0) fail_perror("cannot bind the socket");
+    // Nothing can connect before listen, so restricting the mode here leaves no window
+    if(chmod(socket_path, 0600) != 0) fail_perror("cannot restrict the socket");
+    if(listen(listener, SOMAXCONN) != 0) fail_perror("cannot listen on the socket");
+
+    warm_up();
+    // Anything still buffered would be written again by every worker and request
+    fflush(NULL);
+    struct sigaction action = { .sa_handler = stop };
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    pid_t workers[worker_count];
+    for(size_t i = 0; i < worker_count; i++) if((workers[i] = spawn_worker(listener, compile)) < 0) fail_perror("cannot fork a worker");
+    printf("listening on %s with %lu workers\n", socket_path, worker_count);
+    fflush(stdout);
+
+    // A worker that dies is replaced, its request has already failed on the client side
+    while(!g_is_stopping) {
+        int wait_status;
+        pid_t pid = wait(&wait_status);
+        if(pid < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        for(size_t i = 0; i < worker_count; i++) if(workers[i] == pid && (workers[i] = spawn_worker(listener, compile)) < 0) fail_perror("cannot fork a worker");
+    }
+
+    for(size_t i = 0; i < worker_count; i++) kill(workers[i], SIGTERM);
+    while(wait(NULL) > 0);
+    close(listener);
+    unlink(socket_path);
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
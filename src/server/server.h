@@ -0,0 +1,9 @@
+#pragma once
+#include <stddef.h>
+
+/*
+ * Listens on a Unix socket and runs every request through `compile` as if it was a command line invocation.
+ * The lexer tables, type singletons and LLVM targets are initialized once, the workers and every request
+ * they fork inherit them. Returns when interrupted.
+ */
+int server_main(const char *socket_path, size_t worker_count, int (*compile)(int argc, char **argv));
\ No newline at end of file
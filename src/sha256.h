@@ -0,0 +1,20 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * SHA-256 (FIPS 180-4), fed in pieces. Used where a digest names content, like the object cache.
+ */
+
+#define SHA256_DIGEST_SIZE 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length; // bytes fed so far
+    uint8_t block[64];
+    size_t block_size;
+} sha256_t;
+
+void sha256_init(sha256_t *sha);
+void sha256_update(sha256_t *sha, const void *data, size_t length);
+void sha256_final(sha256_t *sha, uint8_t digest[SHA256_DIGEST_SIZE]);
\ No newline at end of file
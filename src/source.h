@@ -3,6 +3,7 @@
 
 typedef struct {
     const char *name;
+    const char *directory; // OPTIONAL
     size_t data_length;
     const char *data;
 } source_t;
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "trace.h"
+#include "mem.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#define MAX_DEPTH 32
+#define SLOWEST_FUNCTION_COUNT 10
+
+typedef struct {
+    const char *name;
+    const char *detail;
+    bool accumulated;
+    int tid;
+    size_t depth;
+    uint64_t start_ns;
+    trace_time_t elapsed;
+    size_t peak_rss_kb;
+} event_t;
+
+typedef struct {
+    const char *name;
+    const char *detail;
+    trace_time_t start;
+} open_event_t;
+
+static trace_level_t g_level = TRACE_LEVEL_NONE;
+static trace_level_t g_report_level = TRACE_LEVEL_NONE;
+static bool g_mem_report = false;
+static const char *g_path = NULL;
+static trace_time_t g_start;
+static size_t g_input_bytes = 0, g_input_lines = 0;
+
+static pthread_mutex_t g_events_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t g_event_count = 0, g_event_capacity = 0;
+static event_t *g_events = NULL;
+
+static atomic_int g_thread_count = 0;
+static thread_local int g_tid = 0;
+static thread_local size_t g_depth = 0;
+static thread_local open_event_t g_open[MAX_DEPTH];
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int current_tid() {
+    if(g_tid == 0) g_tid = ++g_thread_count;
+    return g_tid;
+}
+
+static void add_event(event_t event) {
+    pthread_mutex_lock(&g_events_lock);
+    if(g_event_count == g_event_capacity) {
+        g_event_capacity = g_event_capacity == 0 ? 64 : g_event_capacity * 2;
+        g_events = realloc(g_events, sizeof(event_t) * g_event_capacity);
+    }
+    g_events[g_event_count++] = event;
+    pthread_mutex_unlock(&g_events_lock);
+}
+
+static void print_json_string(FILE *file, const char *str) {
+    fputc('"', file);
+    for(; *str != '\0'; str++) {
+        switch(*str) {
+            case '"': fputs("\\\"", file); break;
+            case '\\': fputs("\\\\", file); break;
+            case '\n': fputs("\\n", file); break;
+            default: fputc(*str, file); break;
+        }
+    }
+    fputc('"', file);
+}
+
+static void write_trace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if(file == NULL) {
+        perror("ERROR(trace): ");
+        return;
+    }
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for(size_t i = 0; i < g_event_count; i++) {
+        event_t *event = &g_events[i];
+        if(event->accumulated) continue;
+        fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+        print_json_string(file, event->name);
+        fprintf(file, ",\"cat\":\"charon\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", getpid(), event->tid, (event->start_ns - g_start.wall_ns) / 1000.0, event->elapsed.wall_ns / 1000.0);
+        fprintf(file, ",\"args\":{\"cpu_us\":%.3f", event->elapsed.cpu_ns / 1000.0);
+        if(event->peak_rss_kb != 0) fprintf(file, ",\"peak_rss_kb\":%lu", event->peak_rss_kb);
+        if(event->detail != NULL) {
+            fprintf(file, ",\"detail\":");
+            print_json_string(file, event->detail);
+        }
+        fprintf(file, "}}");
+        first = false;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
+
+static int compare_events_by_start(const void *a, const void *b) {
+    const event_t *event_a = a, *event_b = b;
+    if(event_a->start_ns != event_b->start_ns) return event_a->start_ns < event_b->start_ns ? -1 : 1;
+    if(event_a->depth != event_b->depth) return event_a->depth < event_b->depth ? -1 : 1;
+    return 0;
+}
+
+static int compare_events_by_wall(const void *a, const void *b) {
+    const event_t *event_a = *(const event_t **) a, *event_b = *(const event_t **) b;
+    if(event_a->elapsed.wall_ns == event_b->elapsed.wall_ns) return 0;
+    return event_a->elapsed.wall_ns < event_b->elapsed.wall_ns ? 1 : -1;
+}
+
+static void print_report(trace_time_t total) {
+    fprintf(stderr, "\n-- Time report\n");
+    fprintf(stderr, "%-32s %12s %12s %8s %10s %12s\n", "phase", "wall (ms)", "cpu (ms)", "wall %", "MB/s", "lines/s");
+    for(size_t i = 0; i < g_event_count; i++) {
+        event_t *event = &g_events[i];
+        if(event->detail != NULL) continue;
+        char label[64];
+        snprintf(label, sizeof(label), "%*s%s%s", (int) event->depth * 2, "", event->name, event->accumulated ? " (accumulated)" : "");
+        double seconds = event->elapsed.wall_ns / 1e9;
+        fprintf(stderr, "%-32s %12.3f %12.3f %7.1f%% %10.2f %12.0f\n",
+            label, event->elapsed.wall_ns / 1e6, event->elapsed.cpu_ns / 1e6,
+            total.wall_ns == 0 ? 0.0 : 100.0 * event->elapsed.wall_ns / total.wall_ns,
+            seconds == 0 ? 0.0 : g_input_bytes / 1e6 / seconds, seconds == 0 ? 0.0 : g_input_lines / seconds
+        );
+    }
+    double total_seconds = total.wall_ns / 1e9;
+    fprintf(stderr, "%-32s %12.3f %12.3f %8s %10.2f %12.0f\n", "total", total.wall_ns / 1e6, total.cpu_ns / 1e6, "", total_seconds == 0 ? 0.0 : g_input_bytes / 1e6 / total_seconds, total_seconds == 0 ? 0.0 : g_input_lines / total_seconds);
+    fprintf(stderr, "%-32s %lu bytes, %lu lines\n", "input", g_input_bytes, g_input_lines);
+
+    if(g_report_level < TRACE_LEVEL_FUNCTIONS) return;
+    size_t function_count = 0;
+    event_t **functions = malloc(sizeof(event_t *) * (g_event_count + 1));
+    for(size_t i = 0; i < g_event_count; i++) if(g_events[i].detail != NULL) functions[function_count++] = &g_events[i];
+    qsort(functions, function_count, sizeof(event_t *), compare_events_by_wall);
+    fprintf(stderr, "\n-- Slowest functions (%lu total)\n", function_count);
+    for(size_t i = 0; i < function_count && i < SLOWEST_FUNCTION_COUNT; i++) {
+        fprintf(stderr, "%-32s %12.3f %12.3f  %s\n", functions[i]->name, functions[i]->elapsed.wall_ns / 1e6, functions[i]->elapsed.cpu_ns / 1e6, functions[i]->detail);
+    }
+    free(functions);
+}
+
+static void print_rss_report() {
+    fprintf(stderr, "\n-- Peak RSS per phase\n");
+    fprintf(stderr, "%-32s %12s\n", "phase", "rss (KiB)");
+    for(size_t i = 0; i < g_event_count; i++) {
+        event_t *event = &g_events[i];
+        if(event->detail != NULL || event->accumulated) continue;
+        char label[64];
+        snprintf(label, sizeof(label), "%*s%s", (int) event->depth * 2, "", event->name);
+        fprintf(stderr, "%-32s %12lu\n", label, event->peak_rss_kb);
+    }
+}
+
+void trace_init(trace_level_t report_level, bool mem_report, const char *path) {
+    g_report_level = report_level;
+    g_mem_report = mem_report;
+    g_level = path != NULL ? TRACE_LEVEL_FUNCTIONS : report_level;
+    if(mem_report && g_level == TRACE_LEVEL_NONE) g_level = TRACE_LEVEL_PHASES;
+    g_path = path;
+    g_start = trace_now();
+}
+
+void trace_set_input(size_t bytes, size_t lines) {
+    g_input_bytes = bytes;
+    g_input_lines = lines;
+}
+
+void trace_finish() {
+    if(g_level == TRACE_LEVEL_NONE) return;
+    trace_time_t total = trace_since(g_start);
+    pthread_mutex_lock(&g_events_lock);
+    qsort(g_events, g_event_count, sizeof(event_t), compare_events_by_start);
+    if(g_report_level != TRACE_LEVEL_NONE) print_report(total);
+    if(g_mem_report) print_rss_report();
+    if(g_path != NULL) write_trace(g_path);
+    pthread_mutex_unlock(&g_events_lock);
+}
+
+bool trace_enabled(trace_level_t level) {
+    return level != TRACE_LEVEL_NONE && g_level >= level;
+}
+
+trace_time_t trace_now() {
+    return (trace_time_t) { .wall_ns = clock_ns(CLOCK_MONOTONIC), .cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) };
+}
+
+trace_time_t trace_since(trace_time_t start) {
+    trace_time_t now = trace_now();
+    return (trace_time_t) { .wall_ns = now.wall_ns - start.wall_ns, .cpu_ns = now.cpu_ns - start.cpu_ns };
+}
+
+void trace_begin(const char *name, const char *detail) {
+    if(!trace_enabled(detail == NULL ? TRACE_LEVEL_PHASES : TRACE_LEVEL_FUNCTIONS)) return;
+    assert(g_depth < MAX_DEPTH);
+    g_open[g_depth++] = (open_event_t) { .name = name, .detail = detail, .start = trace_now() };
+}
+
+void trace_end(const char *name, const char *detail) {
+    if(!trace_enabled(detail == NULL ? TRACE_LEVEL_PHASES : TRACE_LEVEL_FUNCTIONS)) return;
+    assert(g_depth > 0);
+    open_event_t *open = &g_open[--g_depth];
+    assert(open->name == name);
+    add_event((event_t) {
+        .name = open->name,
+        .detail = open->detail,
+        .tid = current_tid(),
+        .depth = g_depth,
+        .start_ns = open->start.wall_ns,
+        .elapsed = trace_since(open->start),
+        .peak_rss_kb = open->detail == NULL ? mem_peak_rss_kb() : 0
+    });
+}
+
+size_t trace_depth() {
+    return g_depth;
+}
+
+// Drops phases left open by an error that was recovered from
+void trace_unwind(size_t depth) {
+    if(g_depth > depth) g_depth = depth;
+}
+
+void trace_record(const char *name, trace_time_t elapsed) {
+    if(!trace_enabled(TRACE_LEVEL_PHASES)) return;
+    // Accumulated time is listed right after the innermost open phase
+    uint64_t start_ns = g_depth > 0 ? g_open[g_depth - 1].start.wall_ns : g_start.wall_ns;
+    add_event((event_t) { .name = name, .accumulated = true, .tid = current_tid(), .depth = g_depth, .start_ns = start_ns, .elapsed = elapsed });
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    TRACE_LEVEL_NONE,
+    TRACE_LEVEL_PHASES,
+    TRACE_LEVEL_FUNCTIONS
+} trace_level_t;
+
+typedef struct {
+    uint64_t wall_ns, cpu_ns;
+} trace_time_t;
+
+void trace_init(trace_level_t report_level, bool mem_report, const char *path);
+void trace_set_input(size_t bytes, size_t lines);
+void trace_finish();
+bool trace_enabled(trace_level_t level);
+
+trace_time_t trace_now();
+trace_time_t trace_since(trace_time_t start);
+
+void trace_begin(const char *name, const char *detail);
+void trace_end(const char *name, const char *detail);
+void trace_record(const char *name, trace_time_t elapsed);
+size_t trace_depth();
+void trace_unwind(size_t depth);
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "vm.h"
+#include <assert.h>
+#include <string.h>
+
+typedef uint64_t w;
+
+/*
+ * Trampolines into C. On the targets charon supports every integer and pointer argument travels in a 64 bit
+ * register or stack slot, so calling through a prototype of the right arity with word sized arguments is
+ * indistinguishable from calling through the real one. Variadic functions are called through a variadic
+ * prototype with the right number of fixed arguments, the unused trailing words are never read.
+ */
+uint64_t vm_call_extern(vm_call_site_t *site, uint64_t *arguments) {
+    w a[8] = {};
+    memcpy(a, arguments, sizeof(uint64_t) * site->argument_count);
+    void *f = site->address;
+    if(site->varargs) {
+        switch(site->fixed_count) {
+            case 0:
+            case 1: return ((w (*)(w, ...)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            case 2: return ((w (*)(w, w, ...)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            case 3: return ((w (*)(w, w, w, ...)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            case 4: return ((w (*)(w, w, w, w, ...)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            case 5: return ((w (*)(w, w, w, w, w, ...)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            case 6: return ((w (*)(w, w, w, w, w, w, ...)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            case 7: return ((w (*)(w, w, w, w, w, w, w, ...)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            case 8: return ((w (*)(w, w, w, w, w, w, w, w, ...)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            default: assert(false);
+        }
+    }
+    switch(site->argument_count) {
+        case 0: return ((w (*)()) f)();
+        case 1: return ((w (*)(w)) f)(a[0]);
+        case 2: return ((w (*)(w, w)) f)(a[0], a[1]);
+        case 3: return ((w (*)(w, w, w)) f)(a[0], a[1], a[2]);
+        case 4: return ((w (*)(w, w, w, w)) f)(a[0], a[1], a[2], a[3]);
+        case 5: return ((w (*)(w, w, w, w, w)) f)(a[0], a[1], a[2], a[3], a[4]);
+        case 6: return ((w (*)(w, w, w, w, w, w)) f)(a[0], a[1], a[2], a[3], a[4], a[5]);
+        case 7: return ((w (*)(w, w, w, w, w, w, w)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+        case 8: return ((w (*)(w, w, w, w, w, w, w, w)) f)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+        default: assert(false);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "vm.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../mem.h"
+
+#define VM_REGISTER_STACK_SIZE (1 << 20)
+#define VM_MEMORY_STACK_SIZE (1 << 24)
+#define VM_FRAME_STACK_SIZE (1 << 16)
+
+typedef struct {
+    vm_function_t *function;
+    vm_instruction_t *ip; // where the caller continues
+    uint64_t *registers;
+    uint8_t *memory;
+    uint16_t dst;
+} frame_t;
+
+[[noreturn]] static void fail(const char *msg) {
+    fflush(stdout);
+    fprintf(stderr, "ERROR(vm): %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+
+uint64_t vm_execute(vm_program_t *program, size_t function, uint64_t *arguments) {
+    // Token threaded, every handler jumps straight to the handler of the next instruction
+    static void *labels[] = {
+#define OP(NAME) &&op_##NAME,
+#include "ops.def"
+#undef OP
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == VM_OP_COUNT);
+
+    uint64_t *register_stack = mem_alloc(MEM_SUBSYSTEM_BYTECODE, sizeof(uint64_t) * VM_REGISTER_STACK_SIZE);
+    uint8_t *memory_stack = mem_alloc(MEM_SUBSYSTEM_BYTECODE, VM_MEMORY_STACK_SIZE);
+    frame_t *frame_stack = mem_alloc(MEM_SUBSYSTEM_BYTECODE, sizeof(frame_t) * VM_FRAME_STACK_SIZE);
+    uint64_t *register_end = register_stack + VM_REGISTER_STACK_SIZE;
+    uint8_t *memory_end = memory_stack + VM_MEMORY_STACK_SIZE;
+
+    vm_function_t *current = &program->functions[function];
+    if(current->register_count > VM_REGISTER_STACK_SIZE || current->memory_size > VM_MEMORY_STACK_SIZE) fail("stack overflow");
+    memcpy(register_stack, arguments, sizeof(uint64_t) * current->argument_count);
+    frame_t *frame = frame_stack;
+    uint64_t *r = register_stack;
+    uint64_t *k = current->constants;
+    uint8_t *memory = memory_stack;
+    size_t memory_size = current->memory_size;
+    vm_instruction_t *code = current->instructions;
+    vm_instruction_t *ip = code;
+    uint64_t result;
+
+#define DISPATCH() goto *labels[ip->op]
+#define NEXT() do { ip++; DISPATCH(); } while(0)
+#define BINARY(NAME, EXPR) op_##NAME: { uint64_t x = r[ip->b], y = r[ip->c]; r[ip->a] = (EXPR); NEXT(); }
+#define BINARY_K(NAME, EXPR) op_##NAME: { uint64_t x = r[ip->b], y = k[ip->c]; r[ip->a] = (EXPR); NEXT(); }
+#define UNARY(NAME, EXPR) op_##NAME: { uint64_t x = r[ip->b]; r[ip->a] = (EXPR); NEXT(); }
+#define JUMP(NAME, COND) op_##NAME: { uint64_t x = r[ip->a], y = r[ip->b]; ip = (COND) ? code + ip->c : ip + 1; DISPATCH(); }
+#define JUMP_K(NAME, COND) op_##NAME: { uint64_t x = r[ip->a], y = k[ip->b]; ip = (COND) ? code + ip->c : ip + 1; DISPATCH(); }
+#define LOAD(NAME, TYPE) op_##NAME: { TYPE value; memcpy(&value, (void *) (uintptr_t) r[ip->b], sizeof(TYPE)); r[ip->a] = (uint64_t) value; NEXT(); }
+#define STORE(NAME, TYPE) op_##NAME: { TYPE value = (TYPE) r[ip->b]; memcpy((void *) (uintptr_t) r[ip->a], &value, sizeof(TYPE)); NEXT(); }
+#define S(V) ((int64_t) (V))
+
+    DISPATCH();
+
+    op_MOV: r[ip->a] = r[ip->b]; NEXT();
+    op_LOADK: r[ip->a] = k[ip->b]; NEXT();
+    op_ADDR: r[ip->a] = (uint64_t) (uintptr_t) (memory + ip->b); NEXT();
+
+    BINARY(ADD, x + y)
+    BINARY(SUB, x - y)
+    BINARY(MUL, x * y)
+    op_DIVU: if(r[ip->c] == 0) fail("division by zero"); r[ip->a] = r[ip->b] / r[ip->c]; NEXT();
+    op_DIVS: {
+        uint64_t x = r[ip->b], y = r[ip->c];
+        if(y == 0) fail("division by zero");
+        // INT64_MIN / -1 wraps like the two's complement negation it is
+        r[ip->a] = S(y) == -1 ? -x : (uint64_t) (S(x) / S(y));
+        NEXT();
+    }
+    op_REMU: if(r[ip->c] == 0) fail("division by zero"); r[ip->a] = r[ip->b] % r[ip->c]; NEXT();
+    op_REMS: {
+        uint64_t x = r[ip->b], y = r[ip->c];
+        if(y == 0) fail("division by zero");
+        r[ip->a] = S(y) == -1 ? 0 : (uint64_t) (S(x) % S(y));
+        NEXT();
+    }
+    BINARY_K(ADDK, x + y)
+    BINARY_K(SUBK, x - y)
+    BINARY_K(MULK, x * y)
+    BINARY_K(DIVUK, x / y)
+    BINARY_K(REMUK, x % y)
+    BINARY_K(SHRUK, x >> y)
+    BINARY_K(ANDK, x & y)
+    UNARY(NEG, -x)
+    UNARY(NOT, x == 0)
+
+    BINARY(EQ, x == y)
+    BINARY(NE, x != y)
+    BINARY(LTU, x < y)
+    BINARY(LTS, S(x) < S(y))
+    BINARY(LEU, x <= y)
+    BINARY(LES, S(x) <= S(y))
+    BINARY(GTU, x > y)
+    BINARY(GTS, S(x) > S(y))
+    BINARY(GEU, x >= y)
+    BINARY(GES, S(x) >= S(y))
+
+    UNARY(ZEXT1, x & 1)
+    UNARY(ZEXT8, (uint8_t) x)
+    UNARY(ZEXT16, (uint16_t) x)
+    UNARY(ZEXT32, (uint32_t) x)
+    UNARY(SEXT1, -(x & 1))
+    UNARY(SEXT8, (uint64_t) (int8_t) x)
+    UNARY(SEXT16, (uint64_t) (int16_t) x)
+    UNARY(SEXT32, (uint64_t) (int32_t) x)
+
+    LOAD(LOADU8, uint8_t)
+    LOAD(LOADI8, int8_t)
+    LOAD(LOADU16, uint16_t)
+    LOAD(LOADI16, int16_t)
+    LOAD(LOADU32, uint32_t)
+    LOAD(LOADI32, int32_t)
+    LOAD(LOAD64, uint64_t)
+    STORE(STORE8, uint8_t)
+    STORE(STORE16, uint16_t)
+    STORE(STORE32, uint32_t)
+    STORE(STORE64, uint64_t)
+
+    op_JMP: ip = code + ip->c; DISPATCH();
+    op_JZ: ip = r[ip->a] == 0 ? code + ip->c : ip + 1; DISPATCH();
+    op_JNZ: ip = r[ip->a] != 0 ? code + ip->c : ip + 1; DISPATCH();
+    JUMP(JEQ, x == y)
+    JUMP(JNE, x != y)
+    JUMP(JLTU, x < y)
+    JUMP(JLTS, S(x) < S(y))
+    JUMP(JLEU, x <= y)
+    JUMP(JLES, S(x) <= S(y))
+    JUMP(JGTU, x > y)
+    JUMP(JGTS, S(x) > S(y))
+    JUMP(JGEU, x >= y)
+    JUMP(JGES, S(x) >= S(y))
+    JUMP_K(JEQK, x == y)
+    JUMP_K(JNEK, x != y)
+    JUMP_K(JLTUK, x < y)
+    JUMP_K(JLTSK, S(x) < S(y))
+    JUMP_K(JLEUK, x <= y)
+    JUMP_K(JLESK, S(x) <= S(y))
+    JUMP_K(JGTUK, x > y)
+    JUMP_K(JGTSK, S(x) > S(y))
+    JUMP_K(JGEUK, x >= y)
+    JUMP_K(JGESK, S(x) >= S(y))
+
+    // The arguments already sit at the bottom of the callee's registers, only the frame is pushed
+    op_CALL: {
+        vm_function_t *callee = &program->functions[ip->b];
+        uint64_t *registers = r + ip->c;
+        uint8_t *callee_memory = memory + memory_size;
+        if(frame + 1 == frame_stack + VM_FRAME_STACK_SIZE || registers + callee->register_count > register_end || callee_memory + callee->memory_size > memory_end) fail("stack overflow");
+        *frame++ = (frame_t) { .function = current, .ip = ip + 1, .registers = r, .memory = memory, .dst = ip->a };
+        current = callee;
+        r = registers;
+        k = callee->constants;
+        memory = callee_memory;
+        memory_size = callee->memory_size;
+        code = callee->instructions;
+        ip = code;
+        DISPATCH();
+    }
+    op_CALLX: r[ip->a] = vm_call_extern(&program->call_sites[ip->b], r + ip->c); NEXT();
+    op_RET: result = r[ip->a]; goto leave;
+    op_RETV: result = 0; goto leave;
+
+leave:
+    if(frame == frame_stack) {
+        mem_free(MEM_SUBSYSTEM_BYTECODE, register_stack);
+        mem_free(MEM_SUBSYSTEM_BYTECODE, memory_stack);
+        mem_free(MEM_SUBSYSTEM_BYTECODE, frame_stack);
+        return result;
+    }
+    frame--;
+    current = frame->function;
+    r = frame->registers;
+    k = current->constants;
+    memory = frame->memory;
+    memory_size = current->memory_size;
+    code = current->instructions;
+    ip = frame->ip;
+    r[frame->dst] = result;
+    DISPATCH();
+}
\ No newline at end of file
@@ -0,0 +1,889 @@
+#include "vm.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include "../ir/eval.h"
+#include "../diag.h"
+#include "../mem.h"
+#include "../trace.h"
+
+#define VM_MAX_EXTERN_ARGUMENTS 8
+#define NO_REGISTER UINT16_MAX
+
+typedef struct {
+    const char *name;
+    ir_node_t *node;
+    size_t function; // index into the program's functions, functions only
+    vm_call_site_t *site; // OPTIONAL, externs only, the resolved address is shared by every call
+    size_t offset; // into the program's data, variables only
+} global_t;
+
+typedef struct {
+    ir_type_t *type;
+    const char *name;
+    bool in_memory;
+    uint16_t location; // register, or offset into the call's memory when the address is taken
+} local_t;
+
+typedef struct {
+    ir_type_t *type;
+    uint16_t reg; // NO_REGISTER for void
+} operand_t;
+
+typedef struct {
+    operand_t left, right;
+    bool is_constant; // right has no register, it is constants[constant]
+    uint16_t constant;
+} operands_t;
+
+typedef struct {
+    vm_program_t *program;
+    size_t global_count;
+    global_t *globals; // sorted by name
+    size_t comptime_steps;
+
+    ir_node_t *node; // function being lowered
+    vm_function_t *function;
+    size_t local_count, local_capacity;
+    local_t *locals;
+    size_t addressed_count;
+    const char **addressed;
+    size_t next_register;
+} lower_t;
+
+static operand_t lower_expr(lower_t *l, ir_node_t *node, ir_type_t *type_expected, uint16_t dst);
+static operand_t lower_address(lower_t *l, ir_node_t *node);
+static void lower_stmt(lower_t *l, ir_node_t *node);
+
+static int compare_globals(const void *a, const void *b) {
+    return strcmp(((const global_t *) a)->name, ((const global_t *) b)->name);
+}
+
+static global_t *find_global(lower_t *l, const char *name) {
+    return bsearch(&(global_t) { .name = name }, l->globals, l->global_count, sizeof(global_t), compare_globals);
+}
+
+static ir_node_t *find_definition(const char *name, void *data) {
+    global_t *global = find_global(data, name);
+    return global != NULL ? global->node : NULL;
+}
+
+static void too_large(lower_t *l) {
+    diag_error(l->node->diag_loc, "'%s' is too large for the vm backend", l->node->global_function.decl.name);
+}
+
+static size_t emit(lower_t *l, vm_op_t op, uint16_t a, uint16_t b, uint16_t c) {
+    vm_function_t *function = l->function;
+    if(function->instruction_count == UINT16_MAX) too_large(l);
+    if(function->instruction_count == function->instruction_capacity) {
+        function->instruction_capacity = function->instruction_capacity == 0 ? 64 : function->instruction_capacity * 2;
+        function->instructions = mem_realloc(MEM_SUBSYSTEM_BYTECODE, function->instructions, sizeof(vm_instruction_t) * function->instruction_capacity);
+    }
+    function->instructions[function->instruction_count] = (vm_instruction_t) { .op = op, .a = a, .b = b, .c = c };
+    return function->instruction_count++;
+}
+
+static void patch(lower_t *l, size_t jump) {
+    l->function->instructions[jump].c = l->function->instruction_count;
+}
+
+static uint16_t constant(lower_t *l, uint64_t value) {
+    vm_function_t *function = l->function;
+    if(function->constant_count == UINT16_MAX) too_large(l);
+    if(function->constant_count == function->constant_capacity) {
+        function->constant_capacity = function->constant_capacity == 0 ? 16 : function->constant_capacity * 2;
+        function->constants = mem_realloc(MEM_SUBSYSTEM_BYTECODE, function->constants, sizeof(uint64_t) * function->constant_capacity);
+    }
+    function->constants[function->constant_count] = value;
+    return function->constant_count++;
+}
+
+static uint16_t new_register(lower_t *l) {
+    if(l->next_register == NO_REGISTER) too_large(l);
+    uint16_t reg = l->next_register++;
+    if(l->next_register > l->function->register_count) l->function->register_count = l->next_register;
+    return reg;
+}
+
+static uint16_t target(lower_t *l, uint16_t dst) {
+    return dst != NO_REGISTER ? dst : new_register(l);
+}
+
+// Moves the value where the caller asked for it, NO_REGISTER leaves it where it is
+static operand_t place(lower_t *l, operand_t value, uint16_t dst) {
+    if(dst == NO_REGISTER || value.reg == dst) return value;
+    emit(l, VM_OP_MOV, dst, value.reg, 0);
+    return (operand_t) { .type = value.type, .reg = dst };
+}
+
+// The register form of a value of type, narrow integers are sign or zero extended from their width
+static uint64_t canonical(ir_type_t *type, uint64_t bits) {
+    if(!ir_type_is_kind(type, IR_TYPE_KIND_INTEGER) || type->integer.bit_size == 64) return bits;
+    uint64_t mask = (UINT64_C(1) << type->integer.bit_size) - 1;
+    if(!type->integer.is_signed) return bits & mask;
+    uint64_t sign = UINT64_C(1) << (type->integer.bit_size - 1);
+    return ((bits & mask) ^ sign) - sign;
+}
+
+static vm_op_t extend_op(size_t bit_size, bool is_signed) {
+    switch(bit_size) {
+        case 1: return is_signed ? VM_OP_SEXT1 : VM_OP_ZEXT1;
+        case 8: return is_signed ? VM_OP_SEXT8 : VM_OP_ZEXT8;
+        case 16: return is_signed ? VM_OP_SEXT16 : VM_OP_ZEXT16;
+        case 32: return is_signed ? VM_OP_SEXT32 : VM_OP_ZEXT32;
+        default: assert(false);
+    }
+}
+
+// Wrapping arithmetic happens on 64 bits, the result is brought back to the width of its type
+static void normalize(lower_t *l, ir_type_t *type, uint16_t reg) {
+    if(!ir_type_is_kind(type, IR_TYPE_KIND_INTEGER) || type->integer.bit_size == 64) return;
+    emit(l, extend_op(type->integer.bit_size, type->integer.is_signed), reg, reg, 0);
+}
+
+// Registers hold a single word, vector programs run through llvm
+static void check_scalar(ir_node_t *node, ir_type_t *type) {
+    if(ir_type_is_kind(type, IR_TYPE_KIND_VECTOR)) diag_error(node->diag_loc, "vectors are not supported by the vm backend");
+}
+
+static vm_op_t load_op(lower_t *l, ir_node_t *node, ir_type_t *type) {
+    if(ir_type_is_kind(type, IR_TYPE_KIND_POINTER)) return VM_OP_LOAD64;
+    check_scalar(node, type);
+    if(ir_type_is_void(type)) diag_error(node->diag_loc, "dereference of a void pointer");
+    if(ir_type_is_kind(type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "arrays are not copied by the vm backend");
+    if(ir_type_is_kind(type, IR_TYPE_KIND_STRUCT)) diag_error(node->diag_loc, "structs are not copied by the vm backend");
+    bool is_signed = type->integer.is_signed;
+    switch(type->integer.bit_size) {
+        case 1: return VM_OP_LOADU8;
+        case 8: return is_signed ? VM_OP_LOADI8 : VM_OP_LOADU8;
+        case 16: return is_signed ? VM_OP_LOADI16 : VM_OP_LOADU16;
+        case 32: return is_signed ? VM_OP_LOADI32 : VM_OP_LOADU32;
+        default: return VM_OP_LOAD64;
+    }
+}
+
+static vm_op_t store_op(lower_t *l, ir_node_t *node, ir_type_t *type) {
+    if(ir_type_is_kind(type, IR_TYPE_KIND_POINTER)) return VM_OP_STORE64;
+    check_scalar(node, type);
+    if(ir_type_is_void(type)) diag_error(node->diag_loc, "store of a void value");
+    if(ir_type_is_kind(type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "arrays are not copied by the vm backend");
+    if(ir_type_is_kind(type, IR_TYPE_KIND_STRUCT)) diag_error(node->diag_loc, "structs are not copied by the vm backend");
+    switch(type->integer.bit_size) {
+        case 1: case 8: return VM_OP_STORE8;
+        case 16: return VM_OP_STORE16;
+        case 32: return VM_OP_STORE32;
+        default: return VM_OP_STORE64;
+    }
+}
+
+static local_t *find_local(lower_t *l, const char *name) {
+    for(size_t i = l->local_count; i > 0; i--) if(strcmp(l->locals[i - 1].name, name) == 0) return &l->locals[i - 1];
+    return NULL;
+}
+
+static global_t *get_global_variable(lower_t *l, ir_node_t *node, const char *name) {
+    global_t *global = find_global(l, name);
+    if(global == NULL || global->node->type != IR_NODE_TYPE_GLOBAL_VARIABLE) diag_error(node->diag_loc, "reference to an undefined variable '%s'", name);
+    return global;
+}
+
+static bool is_addressed(lower_t *l, const char *name) {
+    for(size_t i = 0; i < l->addressed_count; i++) if(strcmp(l->addressed[i], name) == 0) return true;
+    return false;
+}
+
+static local_t *add_local(lower_t *l, ir_type_t *type, const char *name) {
+    if(l->local_count == l->local_capacity) {
+        l->local_capacity = l->local_capacity == 0 ? 16 : l->local_capacity * 2;
+        l->locals = mem_realloc(MEM_SUBSYSTEM_BYTECODE, l->locals, sizeof(local_t) * l->local_capacity);
+    }
+    local_t *local = &l->locals[l->local_count++];
+    *local = (local_t) { .type = type, .name = name, .in_memory = is_addressed(l, name) || ir_type_is_kind(type, IR_TYPE_KIND_ARRAY) || ir_type_is_kind(type, IR_TYPE_KIND_STRUCT) };
+    if(!local->in_memory) {
+        local->location = new_register(l);
+        return local;
+    }
+    // Slots stay 8 byte aligned, whatever lives in them
+    size_t size = (ir_type_size(type) + 7) & ~(size_t) 7;
+    if(l->function->memory_size + size > UINT16_MAX) too_large(l);
+    local->location = l->function->memory_size;
+    l->function->memory_size += size;
+    return local;
+}
+
+static void collect_addressed(ir_node_t *node, void *data) {
+    lower_t *l = data;
+    if(node->type != IR_NODE_TYPE_EXPR_UNARY || node->expr_unary.operation != IR_UNARY_OPERATION_REF) return;
+    if(node->expr_unary.operand->type != IR_NODE_TYPE_EXPR_VAR || is_addressed(l, node->expr_unary.operand->expr_var.name)) return;
+    l->addressed = mem_realloc(MEM_SUBSYSTEM_BYTECODE, l->addressed, sizeof(const char *) * ++l->addressed_count);
+    l->addressed[l->addressed_count - 1] = node->expr_unary.operand->expr_var.name;
+}
+
+static void find_assignment(ir_node_t *node, void *data) {
+    if(node->type == IR_NODE_TYPE_EXPR_BINARY && node->expr_binary.operation == IR_BINARY_OPERATION_ASSIGN) *(bool *) data = true;
+}
+
+static bool is_local_register(lower_t *l, uint16_t reg) {
+    for(size_t i = 0; i < l->local_count; i++) if(!l->locals[i].in_memory && l->locals[i].location == reg) return true;
+    return false;
+}
+
+static ir_type_t *literal_type(ir_node_t *node) {
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC: return ir_type_get_u64();
+        case IR_NODE_TYPE_EXPR_LITERAL_CHAR: return ir_type_get_char();
+        case IR_NODE_TYPE_EXPR_LITERAL_BOOL: return ir_type_get_bool();
+        default: return NULL;
+    }
+}
+
+static uint64_t literal_value(ir_node_t *node) {
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC: return node->expr_literal.numeric_value;
+        case IR_NODE_TYPE_EXPR_LITERAL_CHAR: return (unsigned char) node->expr_literal.char_value;
+        case IR_NODE_TYPE_EXPR_LITERAL_BOOL: return node->expr_literal.bool_value;
+        default: assert(false);
+    }
+}
+
+// Right before left like gen_expr_binary, a literal on the right stays in the constant pool
+static operands_t lower_operands(lower_t *l, ir_node_t *node) {
+    operands_t operands = {};
+    ir_node_t *right = node->expr_binary.right;
+    ir_type_t *type = literal_type(right);
+    if(type != NULL) {
+        operands.right = (operand_t) { .type = type, .reg = NO_REGISTER };
+        operands.is_constant = true;
+        operands.constant = constant(l, literal_value(right));
+    } else {
+        operands.right = lower_expr(l, right, NULL, NO_REGISTER);
+        if(ir_type_is_void(operands.right.type)) diag_error(node->diag_loc, "rhs of binary expression is void");
+        // A variable read in place must not see an assignment the left side makes
+        bool has_assignment = false;
+        ir_node_visit(node->expr_binary.left, find_assignment, &has_assignment);
+        if(has_assignment && is_local_register(l, operands.right.reg)) operands.right = place(l, operands.right, new_register(l));
+    }
+
+    operands.left = lower_expr(l, node->expr_binary.left, NULL, NO_REGISTER);
+    if(!ir_type_is_eq(operands.right.type, operands.left.type)) diag_error(node->diag_loc, "conflicting types in binary expression");
+    if(ir_type_is_void(operands.left.type)) diag_error(node->diag_loc, "void in binary expression");
+    bool is_equality = node->expr_binary.operation == IR_BINARY_OPERATION_EQUAL || node->expr_binary.operation == IR_BINARY_OPERATION_NOT_EQUAL;
+    if(!is_equality && !ir_type_is_kind(operands.left.type, IR_TYPE_KIND_INTEGER)) diag_error(node->diag_loc, "invalid type in binary expression");
+    return operands;
+}
+
+static void materialize(lower_t *l, operands_t *operands) {
+    if(!operands->is_constant) return;
+    operands->right.reg = new_register(l);
+    emit(l, VM_OP_LOADK, operands->right.reg, operands->constant, 0);
+    operands->is_constant = false;
+}
+
+static bool is_comparison(ir_binary_operation_t operation) {
+    switch(operation) {
+        case IR_BINARY_OPERATION_GREATER:
+        case IR_BINARY_OPERATION_GREATER_EQUAL:
+        case IR_BINARY_OPERATION_LESS:
+        case IR_BINARY_OPERATION_LESS_EQUAL:
+        case IR_BINARY_OPERATION_EQUAL:
+        case IR_BINARY_OPERATION_NOT_EQUAL:
+            return true;
+        default: return false;
+    }
+}
+
+static vm_op_t compare_op(ir_binary_operation_t operation, bool is_signed) {
+    switch(operation) {
+        case IR_BINARY_OPERATION_GREATER: return is_signed ? VM_OP_GTS : VM_OP_GTU;
+        case IR_BINARY_OPERATION_GREATER_EQUAL: return is_signed ? VM_OP_GES : VM_OP_GEU;
+        case IR_BINARY_OPERATION_LESS: return is_signed ? VM_OP_LTS : VM_OP_LTU;
+        case IR_BINARY_OPERATION_LESS_EQUAL: return is_signed ? VM_OP_LES : VM_OP_LEU;
+        case IR_BINARY_OPERATION_EQUAL: return VM_OP_EQ;
+        case IR_BINARY_OPERATION_NOT_EQUAL: return VM_OP_NE;
+        default: assert(false);
+    }
+}
+
+// Jumps when the comparison does not hold, the constant forms take the right operand from the pool
+static vm_op_t jump_unless_op(ir_binary_operation_t operation, bool is_signed, bool is_constant) {
+    vm_op_t op;
+    switch(operation) {
+        case IR_BINARY_OPERATION_GREATER: op = is_signed ? VM_OP_JLES : VM_OP_JLEU; break;
+        case IR_BINARY_OPERATION_GREATER_EQUAL: op = is_signed ? VM_OP_JLTS : VM_OP_JLTU; break;
+        case IR_BINARY_OPERATION_LESS: op = is_signed ? VM_OP_JGES : VM_OP_JGEU; break;
+        case IR_BINARY_OPERATION_LESS_EQUAL: op = is_signed ? VM_OP_JGTS : VM_OP_JGTU; break;
+        case IR_BINARY_OPERATION_EQUAL: op = VM_OP_JNE; break;
+        case IR_BINARY_OPERATION_NOT_EQUAL: op = VM_OP_JEQ; break;
+        default: assert(false);
+    }
+    return is_constant ? op + (VM_OP_JEQK - VM_OP_JEQ) : op;
+}
+
+static operand_t lower_expr_binary(lower_t *l, ir_node_t *node, uint16_t dst) {
+    ir_binary_operation_t operation = node->expr_binary.operation;
+    if(operation == IR_BINARY_OPERATION_ASSIGN) {
+        ir_node_t *left = node->expr_binary.left;
+        local_t *found = left->type == IR_NODE_TYPE_EXPR_VAR ? find_local(l, left->expr_var.name) : NULL;
+        if(found != NULL && !found->in_memory) {
+            local_t local = *found;
+            // Only the last instruction of an expression writes its destination, the variable can be it
+            operand_t right = lower_expr(l, node->expr_binary.right, NULL, local.location);
+            if(ir_type_is_void(right.type)) diag_error(node->diag_loc, "rhs of binary expression is void");
+            if(!ir_type_is_eq(local.type, right.type)) diag_error(node->diag_loc, "conflicting types in assignment");
+            return place(l, right, dst);
+        }
+
+        // Everything else is stored through its address, computed after the value like in gen_expr_binary
+        operand_t value = lower_expr(l, node->expr_binary.right, NULL, NO_REGISTER);
+        if(ir_type_is_void(value.type)) diag_error(node->diag_loc, "rhs of binary expression is void");
+        bool has_assignment = false;
+        ir_node_visit(left, find_assignment, &has_assignment);
+        if(has_assignment && is_local_register(l, value.reg)) value = place(l, value, new_register(l));
+        operand_t address = lower_address(l, left);
+        if(!ir_type_is_eq(address.type, value.type)) diag_error(node->diag_loc, "conflicting types in assignment");
+        emit(l, store_op(l, node, value.type), address.reg, value.reg, 0);
+        return place(l, value, dst);
+    }
+
+    operands_t operands = lower_operands(l, node);
+    ir_type_t *type = operands.left.type;
+    bool is_signed = ir_type_is_kind(type, IR_TYPE_KIND_INTEGER) && type->integer.is_signed;
+    if(is_comparison(operation)) {
+        materialize(l, &operands);
+        uint16_t reg = target(l, dst);
+        emit(l, compare_op(operation, is_signed), reg, operands.left.reg, operands.right.reg);
+        return (operand_t) { .type = ir_type_get_bool(), .reg = reg };
+    }
+
+    vm_op_t op;
+    bool has_constant_form = true;
+    switch(operation) {
+        case IR_BINARY_OPERATION_ADDITION: op = VM_OP_ADD; break;
+        case IR_BINARY_OPERATION_SUBTRACTION: op = VM_OP_SUB; break;
+        case IR_BINARY_OPERATION_MULTIPLICATION: op = VM_OP_MUL; break;
+        case IR_BINARY_OPERATION_DIVISION:
+            op = is_signed ? VM_OP_DIVS : VM_OP_DIVU;
+            // The constant forms skip the check for a zero divisor
+            has_constant_form = !is_signed && operands.is_constant && l->function->constants[operands.constant] != 0;
+            break;
+        case IR_BINARY_OPERATION_MODULO:
+            op = is_signed ? VM_OP_REMS : VM_OP_REMU;
+            has_constant_form = !is_signed && operands.is_constant && l->function->constants[operands.constant] != 0;
+            break;
+        default: assert(false);
+    }
+    if(!has_constant_form) materialize(l, &operands);
+
+    uint16_t reg = target(l, dst);
+    if(operands.is_constant) {
+        // Unsigned division by a power of two is a shift or a mask
+        uint64_t divisor = l->function->constants[operands.constant];
+        if((op == VM_OP_DIVU || op == VM_OP_REMU) && (divisor & (divisor - 1)) == 0) {
+            operands.constant = op == VM_OP_DIVU ? constant(l, __builtin_ctzll(divisor)) : constant(l, divisor - 1);
+            op = op == VM_OP_DIVU ? VM_OP_SHRUK : VM_OP_ANDK;
+        }
+        switch(op) {
+            case VM_OP_ADD: op = VM_OP_ADDK; break;
+            case VM_OP_SUB: op = VM_OP_SUBK; break;
+            case VM_OP_MUL: op = VM_OP_MULK; break;
+            case VM_OP_DIVU: op = VM_OP_DIVUK; break;
+            case VM_OP_REMU: op = VM_OP_REMUK; break;
+            case VM_OP_SHRUK:
+            case VM_OP_ANDK:
+                break;
+            default: assert(false);
+        }
+        emit(l, op, reg, operands.left.reg, operands.constant);
+    } else {
+        emit(l, op, reg, operands.left.reg, operands.right.reg);
+    }
+    normalize(l, type, reg);
+    return (operand_t) { .type = type, .reg = reg };
+}
+
+static bool is_addressable(lower_t *l, ir_node_t *node) {
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_VAR:
+            local_t *local = find_local(l, node->expr_var.name);
+            return local == NULL || local->in_memory;
+        case IR_NODE_TYPE_EXPR_INDEX:
+        case IR_NODE_TYPE_EXPR_MEMBER:
+            return true;
+        case IR_NODE_TYPE_EXPR_UNARY: return node->expr_unary.operation == IR_UNARY_OPERATION_DEREF;
+        default: return false;
+    }
+}
+
+// Arrays are indexed where they are stored and pointers are loaded first, the element address is base + index * size
+static operand_t lower_element(lower_t *l, ir_node_t *node) {
+    ir_node_t *base = node->expr_index.value;
+    operand_t array;
+    if(is_addressable(l, base)) {
+        array = lower_address(l, base);
+        if(ir_type_is_kind(array.type, IR_TYPE_KIND_POINTER)) {
+            // The address can be the register of a pointer variable, `(*p)[i]` must not clobber it
+            uint16_t reg = new_register(l);
+            emit(l, VM_OP_LOAD64, reg, array.reg, 0);
+            array.reg = reg;
+        }
+    } else {
+        array = lower_expr(l, base, NULL, NO_REGISTER);
+        if(ir_type_is_kind(array.type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "only arrays stored in variables can be indexed");
+    }
+    bool is_array = ir_type_is_kind(array.type, IR_TYPE_KIND_ARRAY);
+    if(!is_array && !ir_type_is_kind(array.type, IR_TYPE_KIND_POINTER)) diag_error(node->diag_loc, "indexed value is neither an array nor a pointer");
+    ir_type_t *element_type = is_array ? array.type->array.base : array.type->pointer.base;
+    if(ir_type_is_void(element_type)) diag_error(node->diag_loc, "indexing a void pointer");
+    size_t size = ir_type_size(element_type);
+
+    uint16_t reg = new_register(l);
+    ir_node_t *index_node = node->expr_index.index;
+    if(index_node->type == IR_NODE_TYPE_EXPR_LITERAL_NUMERIC) {
+        uint64_t index = index_node->expr_literal.numeric_value;
+        if(is_array && index >= array.type->array.count) diag_error(index_node->diag_loc, "index %lu is out of bounds of an array of %lu", index, array.type->array.count);
+        emit(l, VM_OP_ADDK, reg, array.reg, constant(l, index * size));
+        return (operand_t) { .type = element_type, .reg = reg };
+    }
+    // Registers hold indices extended to 64 bits already
+    operand_t index = lower_expr(l, index_node, NULL, NO_REGISTER);
+    if(!ir_type_is_kind(index.type, IR_TYPE_KIND_INTEGER)) diag_error(index_node->diag_loc, "array index is not an integer");
+    uint16_t offset = index.reg;
+    if(size != 1) {
+        offset = new_register(l);
+        emit(l, VM_OP_MULK, offset, index.reg, constant(l, size));
+    }
+    emit(l, VM_OP_ADD, reg, array.reg, offset);
+    return (operand_t) { .type = element_type, .reg = reg };
+}
+
+// `.` reaches through one pointer, the field is at a constant offset from wherever the struct is
+static operand_t lower_field(lower_t *l, ir_node_t *node) {
+    ir_node_t *base = node->expr_member.value;
+    operand_t container;
+    if(is_addressable(l, base)) {
+        container = lower_address(l, base);
+        if(ir_type_is_kind(container.type, IR_TYPE_KIND_POINTER)) {
+            // Like in lower_element, the pointer variable's register must survive
+            uint16_t reg = new_register(l);
+            emit(l, VM_OP_LOAD64, reg, container.reg, 0);
+            container = (operand_t) { .type = container.type->pointer.base, .reg = reg };
+        }
+    } else {
+        container = lower_expr(l, base, NULL, NO_REGISTER);
+        if(ir_type_is_kind(container.type, IR_TYPE_KIND_STRUCT)) diag_error(node->diag_loc, "structs are not copied by the vm backend");
+        if(ir_type_is_kind(container.type, IR_TYPE_KIND_POINTER)) container.type = container.type->pointer.base;
+    }
+    ir_type_t *type = container.type;
+    if(!ir_type_is_kind(type, IR_TYPE_KIND_STRUCT)) diag_error(node->diag_loc, "member access on a value that is neither a struct nor a pointer to one");
+    if(!type->structure.is_complete) diag_error(node->diag_loc, "member access on the incomplete struct '%s'", type->structure.name);
+    ir_type_field_t *field = ir_type_find_field(type, node->expr_member.name);
+    if(field == NULL) diag_error(node->diag_loc, "struct '%s' has no field '%s'", type->structure.name, node->expr_member.name);
+    if(field->offset == 0) return (operand_t) { .type = field->type, .reg = container.reg };
+    uint16_t reg = new_register(l);
+    emit(l, VM_OP_ADDK, reg, container.reg, constant(l, field->offset));
+    return (operand_t) { .type = field->type, .reg = reg };
+}
+
+// Storage of an assignable expression, the register holds its address and the type is what is stored there
+static operand_t lower_address(lower_t *l, ir_node_t *node) {
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_VAR:
+            uint16_t reg = new_register(l);
+            local_t *local = find_local(l, node->expr_var.name);
+            if(local != NULL) {
+                assert(local->in_memory);
+                emit(l, VM_OP_ADDR, reg, local->location, 0);
+                return (operand_t) { .type = local->type, .reg = reg };
+            }
+            global_t *global = get_global_variable(l, node, node->expr_var.name);
+            emit(l, VM_OP_LOADK, reg, constant(l, (uint64_t) (uintptr_t) (l->program->data + global->offset)), 0);
+            return (operand_t) { .type = global->node->global_variable.type, .reg = reg };
+        case IR_NODE_TYPE_EXPR_INDEX: return lower_element(l, node);
+        case IR_NODE_TYPE_EXPR_MEMBER: return lower_field(l, node);
+        case IR_NODE_TYPE_EXPR_UNARY:
+            if(node->expr_unary.operation != IR_UNARY_OPERATION_DEREF) break;
+            operand_t pointer = lower_expr(l, node->expr_unary.operand, NULL, NO_REGISTER);
+            if(!ir_type_is_kind(pointer.type, IR_TYPE_KIND_POINTER)) diag_error(node->diag_loc, "cannot dereference a non-pointer");
+            return (operand_t) { .type = pointer.type->pointer.base, .reg = pointer.reg };
+        default: break;
+    }
+    diag_error(node->diag_loc, "expression is not assignable");
+}
+
+static operand_t lower_expr_unary(lower_t *l, ir_node_t *node, uint16_t dst) {
+    if(node->expr_unary.operation == IR_UNARY_OPERATION_REF) {
+        operand_t address = lower_address(l, node->expr_unary.operand);
+        return place(l, (operand_t) { .type = ir_type_make_pointer(address.type), .reg = address.reg }, dst);
+    }
+
+    operand_t operand = lower_expr(l, node->expr_unary.operand, NULL, NO_REGISTER);
+    if(ir_type_is_void(operand.type)) diag_error(node->diag_loc, "void in unary expression");
+    uint16_t reg = target(l, dst);
+    switch(node->expr_unary.operation) {
+        case IR_UNARY_OPERATION_DEREF:
+            assert(ir_type_is_kind(operand.type, IR_TYPE_KIND_POINTER));
+            ir_type_t *type = operand.type->pointer.base;
+            emit(l, load_op(l, node, type), reg, operand.reg, 0);
+            return (operand_t) { .type = type, .reg = reg };
+        case IR_UNARY_OPERATION_NOT:
+            emit(l, VM_OP_NOT, reg, operand.reg, 0);
+            return (operand_t) { .type = ir_type_get_bool(), .reg = reg };
+        case IR_UNARY_OPERATION_NEGATIVE:
+            emit(l, VM_OP_NEG, reg, operand.reg, 0);
+            normalize(l, operand.type, reg);
+            return (operand_t) { .type = operand.type, .reg = reg };
+        default: assert(false);
+    }
+}
+
+static operand_t lower_expr_var(lower_t *l, ir_node_t *node, uint16_t dst) {
+    local_t *local = find_local(l, node->expr_var.name);
+    if(local != NULL && !local->in_memory) return place(l, (operand_t) { .type = local->type, .reg = local->location }, dst);
+    operand_t address = lower_address(l, node);
+    uint16_t reg = target(l, dst);
+    emit(l, load_op(l, node, address.type), reg, address.reg, 0);
+    return (operand_t) { .type = address.type, .reg = reg };
+}
+
+static operand_t lower_expr_index(lower_t *l, ir_node_t *node, uint16_t dst) {
+    operand_t element = node->type == IR_NODE_TYPE_EXPR_INDEX ? lower_element(l, node) : lower_field(l, node);
+    uint16_t reg = target(l, dst);
+    emit(l, load_op(l, node, element.type), reg, element.reg, 0);
+    return (operand_t) { .type = element.type, .reg = reg };
+}
+
+static operand_t lower_expr_comptime(lower_t *l, ir_node_t *node, uint16_t dst) {
+    ir_eval_value_t value = ir_eval(node, &(ir_eval_options_t) { .find_global = find_definition, .data = l, .step_limit = l->comptime_steps });
+    if(ir_type_is_void(value.type)) return (operand_t) { .type = value.type, .reg = NO_REGISTER };
+    if(ir_type_is_kind(value.type, IR_TYPE_KIND_ARRAY)) diag_error(node->diag_loc, "arrays are not copied by the vm backend");
+    uint16_t reg = target(l, dst);
+    emit(l, VM_OP_LOADK, reg, constant(l, canonical(value.type, value.bits)), 0);
+    return (operand_t) { .type = value.type, .reg = reg };
+}
+
+static vm_call_site_t *resolve_extern(lower_t *l, ir_node_t *node, global_t *global) {
+    if(global->site != NULL) return global->site;
+    void *address = dlsym(RTLD_DEFAULT, global->name);
+    if(address == NULL) diag_error(node->diag_loc, "extern '%s' is not loaded in this process", global->name);
+    global->site = mem_alloc(MEM_SUBSYSTEM_BYTECODE, sizeof(vm_call_site_t));
+    *global->site = (vm_call_site_t) { .address = address, .fixed_count = global->node->global_extern.decl.argument_count, .varargs = global->node->global_extern.decl.varargs };
+    return global->site;
+}
+
+static uint16_t add_call_site(lower_t *l, vm_call_site_t site) {
+    vm_program_t *program = l->program;
+    if(program->call_site_count == UINT16_MAX) too_large(l);
+    if(program->call_site_count == program->call_site_capacity) {
+        program->call_site_capacity = program->call_site_capacity == 0 ? 16 : program->call_site_capacity * 2;
+        program->call_sites = mem_realloc(MEM_SUBSYSTEM_BYTECODE, program->call_sites, sizeof(vm_call_site_t) * program->call_site_capacity);
+    }
+    program->call_sites[program->call_site_count] = site;
+    return program->call_site_count++;
+}
+
+// Arguments go to consecutive registers at the top, which become the first registers of the callee
+static operand_t lower_expr_call(lower_t *l, ir_node_t *node, uint16_t dst) {
+    global_t *global = find_global(l, node->expr_call.name);
+    if(global == NULL || global->node->type == IR_NODE_TYPE_GLOBAL_VARIABLE) diag_error(node->diag_loc, "reference to an undefined function '%s'", node->expr_call.name);
+    bool is_extern = global->node->type == IR_NODE_TYPE_GLOBAL_EXTERN;
+    if(!is_extern && global->node->global_function.is_comptime) return lower_expr_comptime(l, node, dst);
+
+    ir_function_decl_t *decl = is_extern ? &global->node->global_extern.decl : &global->node->global_function.decl;
+    size_t argument_count = node->expr_call.argument_count;
+    if(argument_count < decl->argument_count) diag_error(node->diag_loc, "missing arguments");
+    if(!decl->varargs && argument_count > decl->argument_count) diag_error(node->diag_loc, "invalid number of arguments");
+    if(is_extern && argument_count > VM_MAX_EXTERN_ARGUMENTS) diag_error(node->diag_loc, "the vm backend passes at most %d arguments to an extern", VM_MAX_EXTERN_ARGUMENTS);
+
+    size_t base = l->next_register;
+    for(size_t i = 0; i < argument_count; i++) {
+        l->next_register = base + i;
+        lower_expr(l, node->expr_call.arguments[i], i < decl->argument_count ? decl->arguments[i].type : NULL, new_register(l));
+    }
+    if(argument_count == 0) new_register(l);
+
+    uint16_t reg = dst != NO_REGISTER ? dst : base;
+    if(is_extern) {
+        vm_call_site_t site = *resolve_extern(l, node, global);
+        site.argument_count = argument_count;
+        emit(l, VM_OP_CALLX, reg, add_call_site(l, site), base);
+        // C only defines the low bits of a narrow return value
+        normalize(l, decl->return_type, reg);
+    } else {
+        emit(l, VM_OP_CALL, reg, global->function, base);
+    }
+    l->next_register = base + 1;
+    if(ir_type_is_void(decl->return_type)) return (operand_t) { .type = decl->return_type, .reg = NO_REGISTER };
+    return (operand_t) { .type = decl->return_type, .reg = reg };
+}
+
+static operand_t lower_expr_cast(lower_t *l, ir_node_t *node, uint16_t dst) {
+    operand_t value = lower_expr(l, node->expr_cast.value, NULL, NO_REGISTER);
+    ir_type_t *to_type = node->expr_cast.type;
+    ir_type_t *from_type = value.type;
+    check_scalar(node, to_type);
+    if(to_type->kind != from_type->kind) diag_error(node->diag_loc, "cast of incompatible types");
+    if(ir_type_is_void(to_type)) diag_error(node->diag_loc, "void cast");
+    if(ir_type_is_kind(to_type, IR_TYPE_KIND_POINTER)) return place(l, (operand_t) { .type = to_type, .reg = value.reg }, dst);
+
+    // Widening extends by the signedness of the target like gen_expr_cast, from the width of the source
+    size_t from_size = from_type->integer.bit_size, to_size = to_type->integer.bit_size;
+    bool has_op = true;
+    vm_op_t op;
+    if(from_size > to_size) op = extend_op(to_size, to_type->integer.is_signed);
+    else if(from_size < to_size && to_type->integer.is_signed) op = extend_op(from_size, true);
+    else if(from_size < to_size && from_type->integer.is_signed) op = extend_op(from_size, false);
+    else if(from_size == to_size && to_size != 64 && from_type->integer.is_signed != to_type->integer.is_signed) op = extend_op(to_size, to_type->integer.is_signed);
+    else has_op = false;
+    if(!has_op) return place(l, (operand_t) { .type = to_type, .reg = value.reg }, dst);
+
+    uint16_t reg = target(l, dst);
+    emit(l, op, reg, value.reg, 0);
+    return (operand_t) { .type = to_type, .reg = reg };
+}
+
+static operand_t lower_expr(lower_t *l, ir_node_t *node, ir_type_t *type_expected, uint16_t dst) {
+    operand_t value;
+    switch(node->type) {
+        case IR_NODE_TYPE_EXPR_LITERAL_NUMERIC:
+        case IR_NODE_TYPE_EXPR_LITERAL_CHAR:
+        case IR_NODE_TYPE_EXPR_LITERAL_BOOL:
+            value = (operand_t) { .type = literal_type(node), .reg = target(l, dst) };
+            emit(l, VM_OP_LOADK, value.reg, constant(l, literal_value(node)), 0);
+            break;
+        case IR_NODE_TYPE_EXPR_LITERAL_STRING:
+            // The AST outlives the run, its strings are used in place
+            value = (operand_t) { .type = ir_type_make_pointer(ir_type_get_char()), .reg = target(l, dst) };
+            emit(l, VM_OP_LOADK, value.reg, constant(l, (uint64_t) (uintptr_t) node->expr_literal.string_value), 0);
+            break;
+        case IR_NODE_TYPE_EXPR_BINARY: value = lower_expr_binary(l, node, dst); break;
+        case IR_NODE_TYPE_EXPR_UNARY: value = lower_expr_unary(l, node, dst); break;
+        case IR_NODE_TYPE_EXPR_VAR: value = lower_expr_var(l, node, dst); break;
+        case IR_NODE_TYPE_EXPR_CALL: value = lower_expr_call(l, node, dst); break;
+        case IR_NODE_TYPE_EXPR_CAST: value = lower_expr_cast(l, node, dst); break;
+        case IR_NODE_TYPE_EXPR_COMPTIME: value = lower_expr_comptime(l, node->expr_comptime.value, dst); break;
+        case IR_NODE_TYPE_EXPR_INDEX:
+        case IR_NODE_TYPE_EXPR_MEMBER:
+            value = lower_expr_index(l, node, dst);
+            break;
+        default: assert(false);
+    }
+    if(type_expected != NULL && !ir_type_is_eq(value.type, type_expected)) diag_error(node->diag_loc, "conflicting types");
+    if(dst != NO_REGISTER && value.reg == NO_REGISTER) diag_error(node->diag_loc, "void value used");
+    check_scalar(node, value.type);
+    return value;
+}
+
+// Returns the jump taken when the condition is false, comparisons branch without materializing a bool
+static size_t lower_condition(lower_t *l, ir_node_t *node) {
+    if(node->type == IR_NODE_TYPE_EXPR_BINARY && is_comparison(node->expr_binary.operation)) {
+        operands_t operands = lower_operands(l, node);
+        ir_type_t *type = operands.left.type;
+        bool is_signed = ir_type_is_kind(type, IR_TYPE_KIND_INTEGER) && type->integer.is_signed;
+        vm_op_t op = jump_unless_op(node->expr_binary.operation, is_signed, operands.is_constant);
+        return emit(l, op, operands.left.reg, operands.is_constant ? operands.constant : operands.right.reg, 0);
+    }
+    if(node->type == IR_NODE_TYPE_EXPR_UNARY && node->expr_unary.operation == IR_UNARY_OPERATION_NOT) {
+        operand_t operand = lower_expr(l, node->expr_unary.operand, NULL, NO_REGISTER);
+        if(ir_type_is_void(operand.type)) diag_error(node->diag_loc, "void in unary expression");
+        return emit(l, VM_OP_JNZ, operand.reg, 0, 0);
+    }
+    operand_t condition = lower_expr(l, node, ir_type_get_bool(), NO_REGISTER);
+    return emit(l, VM_OP_JZ, condition.reg, 0, 0);
+}
+
+static void lower_stmt_return(lower_t *l, ir_node_t *node) {
+    ir_type_t *return_type = l->node->global_function.decl.return_type;
+    if(ir_type_is_void(return_type)) {
+        if(node->stmt_return.value != NULL) diag_error(node->diag_loc, "value returned from void function");
+        emit(l, VM_OP_RETV, 0, 0, 0);
+        return;
+    }
+    if(node->stmt_return.value == NULL) diag_error(node->diag_loc, "missing return value");
+    emit(l, VM_OP_RET, lower_expr(l, node->stmt_return.value, return_type, NO_REGISTER).reg, 0, 0);
+}
+
+static void lower_stmt_if(lower_t *l, ir_node_t *node) {
+    size_t jump_else = lower_condition(l, node->stmt_if.condition);
+    lower_stmt(l, node->stmt_if.body);
+    if(node->stmt_if.else_body == NULL) {
+        patch(l, jump_else);
+        return;
+    }
+    size_t jump_end = emit(l, VM_OP_JMP, 0, 0, 0);
+    patch(l, jump_else);
+    lower_stmt(l, node->stmt_if.else_body);
+    patch(l, jump_end);
+}
+
+static void lower_stmt_while(lower_t *l, ir_node_t *node) {
+    size_t top = l->function->instruction_count;
+    size_t jump_out = 0;
+    if(node->stmt_while.condition != NULL) jump_out = lower_condition(l, node->stmt_while.condition);
+    lower_stmt(l, node->stmt_while.body);
+    emit(l, VM_OP_JMP, 0, 0, top);
+    if(node->stmt_while.condition != NULL) patch(l, jump_out);
+}
+
+static void lower_stmt(lower_t *l, ir_node_t *node) {
+    // Temporaries die with the statement, declarations keep their register until the block ends
+    size_t next_register = l->next_register;
+    switch(node->type) {
+        case IR_NODE_TYPE_STMT_BLOCK:
+            size_t local_count = l->local_count;
+            for(size_t i = 0; i < node->stmt_block.statement_count; i++) lower_stmt(l, node->stmt_block.statements[i]);
+            l->local_count = local_count;
+            break;
+        case IR_NODE_TYPE_STMT_RETURN: lower_stmt_return(l, node); break;
+        case IR_NODE_TYPE_STMT_IF: lower_stmt_if(l, node); break;
+        case IR_NODE_TYPE_STMT_WHILE: lower_stmt_while(l, node); break;
+        case IR_NODE_TYPE_STMT_DECL:
+            // In scope before its initializer like in gen_stmt_decl
+            check_scalar(node, node->stmt_decl.type);
+            local_t local = *add_local(l, node->stmt_decl.type, node->stmt_decl.name);
+            next_register = l->next_register;
+            if(node->stmt_decl.initial == NULL) break;
+            operand_t value = lower_expr(l, node->stmt_decl.initial, node->stmt_decl.type, local.in_memory ? NO_REGISTER : local.location);
+            if(!local.in_memory) break;
+            uint16_t address = new_register(l);
+            emit(l, VM_OP_ADDR, address, local.location, 0);
+            emit(l, store_op(l, node, local.type), address, value.reg, 0);
+            break;
+        default: lower_expr(l, node, NULL, NO_REGISTER); break;
+    }
+    l->next_register = next_register;
+}
+
+static void lower_function(lower_t *l, ir_node_t *node, vm_function_t *function) {
+    trace_begin("vm_function", node->global_function.decl.name);
+    l->node = node;
+    l->function = function;
+    l->local_count = 0;
+    l->addressed_count = 0;
+    l->next_register = 0;
+    ir_node_visit(node->global_function.body, collect_addressed, l);
+
+    ir_function_decl_t *decl = &node->global_function.decl;
+    check_scalar(node, decl->return_type);
+    for(size_t i = 0; i < decl->argument_count; i++) check_scalar(node, decl->arguments[i].type);
+    function->name = decl->name;
+    function->argument_count = decl->argument_count;
+    // Arguments arrive in the first registers, those whose address is taken are copied to memory
+    for(size_t i = 0; i < decl->argument_count; i++) new_register(l);
+    for(size_t i = 0; i < decl->argument_count; i++) {
+        local_t *local = add_local(l, decl->arguments[i].type, decl->arguments[i].name);
+        if(!local->in_memory) {
+            local->location = i;
+            continue;
+        }
+        uint16_t address = new_register(l);
+        emit(l, VM_OP_ADDR, address, local->location, 0);
+        emit(l, store_op(l, node, local->type), address, i, 0);
+    }
+    lower_stmt(l, node->global_function.body);
+    // Falling off the end returns zero, a well formed function never gets here
+    emit(l, VM_OP_RETV, 0, 0, 0);
+    trace_end("vm_function", node->global_function.decl.name);
+}
+
+vm_program_t *vm_lower(ir_node_t *ast, size_t comptime_steps) {
+    assert(ast->type == IR_NODE_TYPE_PROGRAM);
+    trace_begin("vm_lower", NULL);
+    lower_t l = { .comptime_steps = comptime_steps };
+    l.program = mem_calloc(MEM_SUBSYSTEM_BYTECODE, 1, sizeof(vm_program_t));
+
+    // Definitions replace extern declarations of the same name, comptime functions are only ever evaluated
+    l.globals = mem_alloc(MEM_SUBSYSTEM_BYTECODE, sizeof(global_t) * ast->program.global_count);
+    size_t named_count = 0;
+    for(size_t i = 0; i < ast->program.global_count; i++) {
+        ir_node_t *node = ast->program.globals[i];
+        if(node->type == IR_NODE_TYPE_GLOBAL_STRUCT) continue; // resolved by the parser
+        const char *name = NULL;
+        switch(node->type) {
+            case IR_NODE_TYPE_GLOBAL_FUNCTION:
+                name = node->global_function.decl.name;
+                if(!node->global_function.is_comptime) l.global_count++;
+                break;
+            case IR_NODE_TYPE_GLOBAL_EXTERN: name = node->global_extern.decl.name; break;
+            case IR_NODE_TYPE_GLOBAL_VARIABLE: name = node->global_variable.name; break;
+            case IR_NODE_TYPE_GLOBAL_IMPORT: diag_error(node->diag_loc, "import is not supported by the vm backend");
+            default: assert(false);
+        }
+        l.globals[named_count++] = (global_t) { .name = name, .node = node };
+    }
+    l.program->function_count = l.global_count;
+    l.program->functions = mem_calloc(MEM_SUBSYSTEM_BYTECODE, l.global_count, sizeof(vm_function_t));
+    l.global_count = named_count;
+    qsort(l.globals, l.global_count, sizeof(global_t), compare_globals);
+
+    size_t kept = 0, function_count = 0;
+    for(size_t i = 0; i < l.global_count; i++) {
+        global_t global = l.globals[i];
+        bool is_function = global.node->type == IR_NODE_TYPE_GLOBAL_FUNCTION;
+        if(is_function && !global.node->global_function.is_comptime) global.function = function_count++;
+        if(kept > 0 && strcmp(l.globals[kept - 1].name, global.name) == 0) {
+            bool is_definition = global.node->type != IR_NODE_TYPE_GLOBAL_EXTERN;
+            bool was_definition = l.globals[kept - 1].node->type != IR_NODE_TYPE_GLOBAL_EXTERN;
+            if(was_definition && is_definition) diag_error(global.node->diag_loc, "redefinition of '%s'", global.name);
+            if(is_definition) l.globals[kept - 1] = global;
+            continue;
+        }
+        l.globals[kept++] = global;
+    }
+    l.global_count = kept;
+
+    // Variables live in one zeroed block for the lifetime of the program, initializers are evaluated now
+    for(size_t i = 0; i < l.global_count; i++) {
+        ir_node_t *node = l.globals[i].node;
+        if(node->type != IR_NODE_TYPE_GLOBAL_VARIABLE) continue;
+        if(ir_type_is_void(node->global_variable.type)) diag_error(node->diag_loc, "variable '%s' is void", node->global_variable.name);
+        l.globals[i].offset = l.program->data_size;
+        l.program->data_size += (ir_type_size(node->global_variable.type) + 7) & ~(size_t) 7;
+    }
+    l.program->data = mem_calloc(MEM_SUBSYSTEM_BYTECODE, l.program->data_size > 0 ? l.program->data_size : 1, 1);
+    for(size_t i = 0; i < l.global_count; i++) {
+        ir_node_t *node = l.globals[i].node;
+        if(node->type != IR_NODE_TYPE_GLOBAL_VARIABLE || node->global_variable.initial == NULL) continue;
+        ir_eval_value_t value = ir_eval(node->global_variable.initial, &(ir_eval_options_t) { .find_global = find_definition, .data = &l, .step_limit = l.comptime_steps });
+        if(!ir_type_is_eq(value.type, node->global_variable.type)) diag_error(node->global_variable.initial->diag_loc, "conflicting types");
+        // The hosts charon runs on are little endian, the low bytes of the value are the variable
+        uint8_t *data = l.program->data + l.globals[i].offset;
+        if(value.elements == NULL) {
+            memcpy(data, &value.bits, ir_type_size(value.type));
+        } else {
+            // Arrays are their integers back to back
+            ir_type_t *element_type = value.type;
+            while(ir_type_is_kind(element_type, IR_TYPE_KIND_ARRAY)) element_type = element_type->array.base;
+            size_t element_size = ir_type_size(element_type);
+            for(size_t j = 0; j < ir_type_size(value.type) / element_size; j++) memcpy(data + j * element_size, &value.elements[j], element_size);
+        }
+        ir_eval_value_free(value);
+    }
+
+    global_t *main = find_global(&l, "main");
+    if(main == NULL || main->node->type != IR_NODE_TYPE_GLOBAL_FUNCTION || main->node->global_function.is_comptime) diag_error((diag_loc_t) { .present = false }, "the program has no main function");
+    l.program->main = main->function;
+
+    for(size_t i = 0; i < l.global_count; i++) {
+        ir_node_t *node = l.globals[i].node;
+        if(node->type != IR_NODE_TYPE_GLOBAL_FUNCTION || node->global_function.is_comptime) continue;
+        lower_function(&l, node, &l.program->functions[l.globals[i].function]);
+    }
+
+    mem_free(MEM_SUBSYSTEM_BYTECODE, l.globals);
+    mem_free(MEM_SUBSYSTEM_BYTECODE, l.locals);
+    mem_free(MEM_SUBSYSTEM_BYTECODE, l.addressed);
+    trace_end("vm_lower", NULL);
+    return l.program;
+}
+
+void vm_program_free(vm_program_t *program) {
+    for(size_t i = 0; i < program->function_count; i++) {
+        mem_free(MEM_SUBSYSTEM_BYTECODE, program->functions[i].instructions);
+        mem_free(MEM_SUBSYSTEM_BYTECODE, program->functions[i].constants);
+    }
+    mem_free(MEM_SUBSYSTEM_BYTECODE, program->functions);
+    mem_free(MEM_SUBSYSTEM_BYTECODE, program->call_sites);
+    mem_free(MEM_SUBSYSTEM_BYTECODE, program->data);
+    mem_free(MEM_SUBSYSTEM_BYTECODE, program);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#include "vm.h"
+#include <stdio.h>
+#include "../trace.h"
+
+int vm_run(ir_node_t *ast, size_t comptime_steps, int argc, char **argv) {
+    vm_program_t *program = vm_lower(ast, comptime_steps);
+
+    // main is called like the jit calls it, narrower return types are already extended in the register
+    trace_begin("run", NULL);
+    uint64_t arguments[] = { (uint64_t) argc, (uint64_t) (uintptr_t) argv };
+    int result = (int) vm_execute(program, program->main, arguments);
+    fflush(stdout);
+    trace_end("run", NULL);
+
+    vm_program_free(program);
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "../ir/node.h"
+
+/*
+ * Alternative backend for `charon run`, the program is lowered to register bytecode and interpreted right away
+ * without going through LLVM. Registers hold 64 bit words, values narrower than that are kept sign or zero
+ * extended according to their type so comparisons and divisions need no extra work. Arrays and variables whose
+ * address is taken live in a per call memory area instead of a register.
+ */
+
+typedef enum {
+#define OP(NAME) VM_OP_##NAME,
+#include "ops.def"
+#undef OP
+    VM_OP_COUNT
+} vm_op_t;
+
+// Jump targets are instruction indices in c, constants are indices into the function's constant pool
+typedef struct {
+    uint8_t op;
+    uint16_t a, b, c;
+} vm_instruction_t;
+
+typedef struct {
+    const char *name;
+    size_t argument_count;
+    size_t instruction_count, instruction_capacity;
+    vm_instruction_t *instructions;
+    size_t constant_count, constant_capacity;
+    uint64_t *constants;
+    size_t register_count;
+    size_t memory_size;
+} vm_function_t;
+
+// Every call to an extern gets a site, arguments are passed to the C function as 64 bit words
+typedef struct {
+    void *address;
+    size_t argument_count;
+    size_t fixed_count;
+    bool varargs;
+} vm_call_site_t;
+
+typedef struct {
+    size_t function_count;
+    vm_function_t *functions;
+    size_t call_site_count, call_site_capacity;
+    vm_call_site_t *call_sites;
+    size_t data_size;
+    uint8_t *data; // global variables, their addresses are constants of the functions using them
+    size_t main; // index of main in functions
+} vm_program_t;
+
+vm_program_t *vm_lower(ir_node_t *ast, size_t comptime_steps);
+void vm_program_free(vm_program_t *program);
+
+uint64_t vm_call_extern(vm_call_site_t *site, uint64_t *arguments);
+uint64_t vm_execute(vm_program_t *program, size_t function, uint64_t *arguments);
+
+/* Lowers and runs `ast` in process, returns the exit code of its main. */
+int vm_run(ir_node_t *ast, size_t comptime_steps, int argc, char **argv);
\ No newline at end of file
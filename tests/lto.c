@@ -0,0 +1,8 @@
+// Hot helper called from tests/lto.charon, only inlinable when linked as bitcode
+unsigned long mix(unsigned long x) {
+    return (x ^ (x >> 29)) * 0xbf58476d1ce4e5b9ul;
+}
+
+unsigned long unused_helper(unsigned long x) {
+    return x * 31;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../src/server/protocol.h"
+
+/*
+ * Thin client for `charon --server`. Takes the same arguments as charon and forwards them, together with
+ * the working directory and the standard streams, to the server. It does not link LLVM, so it starts in
+ * a fraction of the time charon itself needs.
+ */
+
+int main(int argc, char **argv) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if(!server_socket_path(address.sun_path, sizeof(address.sun_path))) {
+        fprintf(stderr, "ERROR(client): no private place for the socket, set $XDG_RUNTIME_DIR or $CHARON_SOCKET\n");
+        return EXIT_FAILURE;
+    }
+
+    int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(connection < 0 || connect(connection, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        fprintf(stderr, "ERROR(client): no server listening on %s, start one with `charon --server`\n", address.sun_path);
+        return EXIT_FAILURE;
+    }
+    // The standard streams and the sources go to whoever listens, it has to be ourselves
+    if(!server_is_peer_trusted(connection)) {
+        fprintf(stderr, "ERROR(client): the server on %s runs as another user\n", address.sun_path);
+        return EXIT_FAILURE;
+    }
+    if(!server_send_request(connection, argc - 1, argv + 1)) {
+        fprintf(stderr, "ERROR(client): failed to send the request\n");
+        return EXIT_FAILURE;
+    }
+    int status;
+    if(!server_receive_status(connection, &status)) {
+        fprintf(stderr, "ERROR(client): the server closed the connection\n");
+        return EXIT_FAILURE;
+    }
+    close(connection);
+    return status;
+}
\ No newline at end of file
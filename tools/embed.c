@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include "../src/libcharon.h"
+
+/*
+ * Drives libcharon the way a build service would: every thread compiles every input from memory
+ * with one shared instance. Outputs have to match across threads and a broken input has to come
+ * back as an error instead of ending the process.
+ */
+
+typedef struct {
+    const char *name;
+    char *data;
+    size_t length;
+    charon_result_t expected;
+} input_t;
+
+typedef struct {
+    charon_t *charon;
+    input_t *inputs;
+    size_t input_count, runs;
+    bool failed;
+} worker_t;
+
+static const char g_broken[] = "i32 main() {\n    return nope;\n}\n";
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static char *read_file(const char *path, size_t *length) {
+    FILE *file = fopen(path, "r");
+    if(file == NULL) return NULL;
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    rewind(file);
+    char *data = malloc(*length);
+    if(fread(data, 1, *length, file) != *length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+static void *work(void *arg) {
+    worker_t *worker = arg;
+    for(size_t run = 0; run < worker->runs; run++) {
+        for(size_t i = 0; i < worker->input_count; i++) {
+            input_t *input = &worker->inputs[i];
+            charon_result_t result = charon_compile(worker->charon, input->name, input->data, input->length, CHARON_OUTPUT_OBJ);
+            if(!result.ok || result.size != input->expected.size || memcmp(result.data, input->expected.data, result.size) != 0) {
+                fprintf(stderr, "ERROR(embed): %s differs between threads\n", input->name);
+                worker->failed = true;
+            }
+            charon_result_free(&result);
+        }
+        charon_result_t result = charon_compile(worker->charon, "broken.charon", g_broken, sizeof(g_broken) - 1, CHARON_OUTPUT_OBJ);
+        if(result.ok || result.diagnostics == NULL || strstr(result.diagnostics, "nope") == NULL) {
+            fprintf(stderr, "ERROR(embed): broken input was not reported\n");
+            worker->failed = true;
+        }
+        charon_result_free(&result);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    size_t thread_count = 4, runs = 10;
+    unsigned int opt_level = 0;
+    static struct option options[] = {
+        { "threads", required_argument, NULL, 't' },
+        { "runs", required_argument, NULL, 'r' },
+        {}
+    };
+    int c;
+    while((c = getopt_long(argc, argv, "O:", options, NULL)) != -1) {
+        switch(c) {
+            case 't': thread_count = strtoul(optarg, NULL, 10); break;
+            case 'r': runs = strtoul(optarg, NULL, 10); break;
+            case 'O': opt_level = strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: embed [--threads=N] [--runs=N] [-O<level>] <source>...\n");
+                return EXIT_FAILURE;
+        }
+    }
+    if(optind >= argc || thread_count == 0) {
+        fprintf(stderr, "usage: embed [--threads=N] [--runs=N] [-O<level>] <source>...\n");
+        return EXIT_FAILURE;
+    }
+
+    charon_t *charon = charon_make((charon_options_t) { .opt_level = opt_level });
+    if(charon == NULL) {
+        fprintf(stderr, "ERROR(embed): failed to create a compiler instance\n");
+        return EXIT_FAILURE;
+    }
+
+    // A single threaded compile of every input is the reference the threads are checked against
+    size_t input_count = argc - optind;
+    input_t *inputs = calloc(input_count, sizeof(input_t));
+    for(size_t i = 0; i < input_count; i++) {
+        inputs[i].name = argv[optind + i];
+        inputs[i].data = read_file(inputs[i].name, &inputs[i].length);
+        if(inputs[i].data == NULL) {
+            fprintf(stderr, "ERROR(embed): cannot read %s\n", inputs[i].name);
+            return EXIT_FAILURE;
+        }
+        inputs[i].expected = charon_compile(charon, inputs[i].name, inputs[i].data, inputs[i].length, CHARON_OUTPUT_OBJ);
+        if(!inputs[i].expected.ok) {
+            fprintf(stderr, "%s", inputs[i].expected.diagnostics != NULL ? inputs[i].expected.diagnostics : "");
+            return EXIT_FAILURE;
+        }
+    }
+
+    pthread_t threads[thread_count];
+    worker_t workers[thread_count];
+    double start = now_ms();
+    for(size_t i = 0; i < thread_count; i++) {
+        workers[i] = (worker_t) { .charon = charon, .inputs = inputs, .input_count = input_count, .runs = runs, .failed = false };
+        pthread_create(&threads[i], NULL, work, &workers[i]);
+    }
+    bool failed = false;
+    for(size_t i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+        failed |= workers[i].failed;
+    }
+    double elapsed = now_ms() - start;
+    size_t compile_count = thread_count * runs * (input_count + 1);
+    printf("%lu compiles on %lu threads in %.1f ms, %.3f ms per compile\n", compile_count, thread_count, elapsed, elapsed / compile_count);
+
+    for(size_t i = 0; i < input_count; i++) {
+        charon_result_free(&inputs[i].expected);
+        free(inputs[i].data);
+    }
+    free(inputs);
+    charon_free(charon);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include "../src/lexer/tokenizer.h"
+#include "../src/parser/parser.h"
+#include "../src/gen/gen.h"
+#include "../src/trace.h"
+#include "../src/mem.h"
+
+/*
+ * Per-phase microbenchmarks. Every phase runs on an in-memory buffer so lexer changes
+ * can be measured without parser or LLVM noise. Results are written as JSON and can be
+ * compared against a previously stored baseline.
+ */
+
+typedef enum {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_GEN,
+    PHASE_COUNT
+} phase_t;
+
+typedef struct {
+    double min, p50, p90, p99, max;
+} stats_t;
+
+static const char *g_phase_names[] = {
+    [PHASE_LEX] = "lex",
+    [PHASE_PARSE] = "parse",
+    [PHASE_GEN] = "gen"
+};
+
+static void run_lex(source_t *source) {
+    tokenizer_t *tokenizer = tokenizer_make(source);
+    while(tokenizer_advance(tokenizer).type != TOKEN_TYPE_EOF);
+    tokenizer_free(tokenizer);
+}
+
+static ir_node_t *run_parse(source_t *source) {
+    tokenizer_t *tokenizer = tokenizer_make(source);
+    ir_node_t *ast = parser_parse(tokenizer);
+    tokenizer_free(tokenizer);
+    return ast;
+}
+
+static void run_gen(source_t *source, ir_node_t *ast) {
+    gen_options_t options = { .passes = "" };
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMModuleRef module = gen_module(ast, source, context, &options);
+    LLVMDisposeModule(module);
+    LLVMContextDispose(context);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double *) a, db = *(const double *) b;
+    return da < db ? -1 : da > db;
+}
+
+static double percentile(double *sorted, size_t count, double p) {
+    size_t index = (size_t) (p * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static stats_t measure(phase_t phase, source_t *source, ir_node_t *ast, size_t warmup, size_t runs) {
+    double *samples = malloc(sizeof(double) * runs);
+    for(size_t i = 0; i < warmup + runs; i++) {
+        // Every parsed AST goes with its arena after the timed part, so later runs do not pay for the earlier ones
+        mem_arena_t arena;
+        if(phase == PHASE_PARSE) mem_arena_begin(&arena);
+        trace_time_t start = trace_now();
+        switch(phase) {
+            case PHASE_LEX: run_lex(source); break;
+            case PHASE_PARSE: run_parse(source); break;
+            case PHASE_GEN: run_gen(source, ast); break;
+            case PHASE_COUNT: break;
+        }
+        if(i >= warmup) samples[i - warmup] = trace_since(start).wall_ns / 1e6;
+        if(phase == PHASE_PARSE) mem_arena_end(&arena);
+    }
+    qsort(samples, runs, sizeof(double), compare_doubles);
+    stats_t stats = {
+        .min = samples[0],
+        .p50 = percentile(samples, runs, 0.50),
+        .p90 = percentile(samples, runs, 0.90),
+        .p99 = percentile(samples, runs, 0.99),
+        .max = samples[runs - 1]
+    };
+    free(samples);
+    return stats;
+}
+
+static char *read_file(const char *path, size_t *length) {
+    FILE *file = fopen(path, "r");
+    if(file == NULL) return NULL;
+    struct stat s;
+    if(fstat(fileno(file), &s) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    char *data = malloc(s.st_size + 1);
+    if(fread(data, 1, s.st_size, file) != (size_t) s.st_size) {
+        fclose(file);
+        free(data);
+        return NULL;
+    }
+    fclose(file);
+    data[s.st_size] = '\0';
+    *length = s.st_size;
+    return data;
+}
+
+static bool baseline_p50(const char *baseline, phase_t phase, double *value) {
+    char key[32];
+    snprintf(key, sizeof(key), "\"%s\"", g_phase_names[phase]);
+    const char *entry = strstr(baseline, key);
+    if(entry == NULL) return false;
+    const char *field = strstr(entry, "\"p50_ms\":");
+    if(field == NULL) return false;
+    return sscanf(field + strlen("\"p50_ms\":"), "%lf", value) == 1;
+}
+
+static struct option g_options[] = {
+    { "warmup", required_argument, NULL, 'w' },
+    { "runs", required_argument, NULL, 'r' },
+    { "phase", required_argument, NULL, 'p' },
+    { "baseline", required_argument, NULL, 'b' },
+    { "output", required_argument, NULL, 'o' },
+    {}
+};
+
+int main(int argc, char **argv) {
+    size_t warmup = 3, runs = 20;
+    bool enabled[PHASE_COUNT] = { true, true, true };
+    const char *baseline_path = NULL, *output_path = NULL;
+
+    int c;
+    while((c = getopt_long(argc, argv, "", g_options, NULL)) != -1) {
+        switch(c) {
+            case 'w': warmup = strtoull(optarg, NULL, 10); break;
+            case 'r': runs = strtoull(optarg, NULL, 10); break;
+            case 'p':
+                for(size_t i = 0; i < PHASE_COUNT; i++) enabled[i] = strstr(optarg, g_phase_names[i]) != NULL;
+                break;
+            case 'b': baseline_path = optarg; break;
+            case 'o': output_path = optarg; break;
+            default:
+                fprintf(stderr, "usage: micro [--warmup=N] [--runs=N] [--phase=lex,parse,gen] [--baseline=<json>] [--output=<json>] <source>\n");
+                return EXIT_FAILURE;
+        }
+    }
+    if(optind != argc - 1 || runs == 0) {
+        fprintf(stderr, "expected exactly one source file and at least one run\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t length;
+    char *data = read_file(argv[optind], &length);
+    if(data == NULL) {
+        perror("ERROR(micro): ");
+        return EXIT_FAILURE;
+    }
+    source_t source = { .name = argv[optind], .data = data, .data_length = length };
+    // Shared state is built before any arena, like charon_make does
+    if(!tokenizer_init()) {
+        fprintf(stderr, "ERROR(micro): failed to initialize the tokenizer\n");
+        return EXIT_FAILURE;
+    }
+    ir_type_get_void();
+
+    char *baseline = NULL;
+    if(baseline_path != NULL) {
+        size_t baseline_length;
+        baseline = read_file(baseline_path, &baseline_length);
+        if(baseline == NULL) fprintf(stderr, "warning: could not read baseline %s\n", baseline_path);
+    }
+
+    ir_node_t *ast = enabled[PHASE_GEN] ? run_parse(&source) : NULL;
+
+    FILE *output = output_path != NULL ? fopen(output_path, "w") : NULL;
+    if(output_path != NULL && output == NULL) {
+        fprintf(stderr, "ERROR(micro): could not open %s: %s\n", output_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if(output != NULL) fprintf(output, "{\n  \"source\": \"%s\",\n  \"bytes\": %lu,\n  \"runs\": %lu", argv[optind], length, runs);
+
+    printf("%-8s %10s %10s %10s %10s %10s %10s %10s\n", "phase", "min (ms)", "p50 (ms)", "p90 (ms)", "p99 (ms)", "max (ms)", "MB/s", "baseline");
+    for(size_t i = 0; i < PHASE_COUNT; i++) {
+        if(!enabled[i]) continue;
+        stats_t stats = measure(i, &source, ast, warmup, runs);
+
+        char delta[32] = "-";
+        double baseline_value;
+        if(baseline != NULL && baseline_p50(baseline, i, &baseline_value) && baseline_value > 0) {
+            snprintf(delta, sizeof(delta), "%+.1f%%", 100.0 * (stats.p50 - baseline_value) / baseline_value);
+        }
+        printf("%-8s %10.3f %10.3f %10.3f %10.3f %10.3f %10.2f %10s\n", g_phase_names[i], stats.min, stats.p50, stats.p90, stats.p99, stats.max, length / 1e3 / stats.p50, delta);
+
+        if(output != NULL) {
+            fprintf(output, ",\n  \"%s\": { \"min_ms\": %.6f, \"p50_ms\": %.6f, \"p90_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f }", g_phase_names[i], stats.min, stats.p50, stats.p90, stats.p99, stats.max);
+        }
+    }
+
+    if(output != NULL) {
+        fprintf(output, "\n}\n");
+        bool is_written = !ferror(output);
+        if(fclose(output) != 0) is_written = false;
+        if(!is_written) {
+            fprintf(stderr, "ERROR(micro): could not write %s\n", output_path);
+            return EXIT_FAILURE;
+        }
+    }
+    free(baseline);
+    free(data);
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+
+/*
+ * Deterministic generator of synthetic Charon programs for compile throughput benchmarks.
+ * The same options and seed always produce the same program.
+ */
+
+typedef struct {
+    size_t functions;
+    size_t statements;
+    size_t depth;
+    size_t identifiers;
+    size_t strings;
+    uint64_t seed;
+    size_t part, parts;
+} synth_options_t;
+
+static uint64_t g_state;
+
+static uint64_t next_random() {
+    // xorshift64*
+    g_state ^= g_state >> 12;
+    g_state ^= g_state << 25;
+    g_state ^= g_state >> 27;
+    return g_state * 2685821657736338717u;
+}
+
+static size_t random_below(size_t bound) {
+    return bound == 0 ? 0 : next_random() % bound;
+}
+
+static void indent(size_t depth) {
+    printf("%*s", (int) depth * 4, "");
+}
+
+static void gen_leaf(synth_options_t *options, size_t function, size_t declared) {
+    switch(random_below(3)) {
+        case 0: printf("%lu", random_below(1000)); break;
+        case 1: printf("a"); break;
+        default:
+            if(declared == 0) printf("b"); else printf("v%lu", random_below(declared));
+            break;
+    }
+}
+
+static void gen_expression(synth_options_t *options, size_t function, size_t declared, size_t depth) {
+    if(depth == 0 || random_below(4) == 0) {
+        gen_leaf(options, function, declared);
+        return;
+    }
+    if(function > 0 && random_below(8) == 0) {
+        printf("f%lu(", random_below(function));
+        gen_expression(options, function, declared, depth - 1);
+        printf(", ");
+        gen_expression(options, function, declared, depth - 1);
+        printf(")");
+        return;
+    }
+    static const char *operators[] = { "+", "-", "*" };
+    printf("(");
+    gen_expression(options, function, declared, depth - 1);
+    printf(" %s ", operators[random_below(3)]);
+    gen_expression(options, function, declared, depth - 1);
+    printf(")");
+}
+
+static void gen_condition(synth_options_t *options, size_t function, size_t declared) {
+    static const char *operators[] = { "<", "<=", ">", ">=", "==", "!=" };
+    gen_expression(options, function, declared, options->depth / 2);
+    printf(" %s ", operators[random_below(6)]);
+    gen_expression(options, function, declared, options->depth / 2);
+}
+
+static void gen_string(size_t function, size_t index) {
+    static const char *words[] = { "lorem", "ipsum", "dolor", "sit", "amet", "charon", "styx", "obol" };
+    printf("char *s%lu = \"", index);
+    size_t word_count = 2 + random_below(8);
+    for(size_t i = 0; i < word_count; i++) printf("%s%s", i == 0 ? "" : " ", words[random_below(8)]);
+    printf(" %lu\\n\";\n", function);
+}
+
+static void gen_function(synth_options_t *options, size_t function) {
+    printf("uint f%lu(uint a, uint b) {\n", function);
+    size_t declared = 0;
+    for(size_t i = 0; i < options->strings; i++) {
+        indent(1);
+        gen_string(function, i);
+    }
+    for(size_t i = 0; i < options->statements; i++) {
+        if(declared < options->identifiers && (declared == 0 || random_below(3) == 0)) {
+            indent(1);
+            printf("uint v%lu = ", declared);
+            gen_expression(options, function, declared, options->depth);
+            printf(";\n");
+            declared++;
+            continue;
+        }
+        switch(random_below(4)) {
+            case 0:
+                indent(1);
+                printf("if(");
+                gen_condition(options, function, declared);
+                printf(") {\n");
+                indent(2);
+                printf("v%lu = ", random_below(declared));
+                gen_expression(options, function, declared, options->depth);
+                printf(";\n");
+                indent(1);
+                printf("} else {\n");
+                indent(2);
+                printf("v%lu += 1;\n", random_below(declared));
+                indent(1);
+                printf("}\n");
+                break;
+            case 1:
+                indent(1);
+                printf("{\n");
+                indent(2);
+                printf("uint i = 0;\n");
+                indent(2);
+                printf("while(i < %lu) {\n", 1 + random_below(4));
+                indent(3);
+                printf("v%lu += ", random_below(declared));
+                gen_expression(options, function, declared, options->depth);
+                printf(";\n");
+                indent(3);
+                printf("i += 1;\n");
+                indent(2);
+                printf("}\n");
+                indent(1);
+                printf("}\n");
+                break;
+            default:
+                indent(1);
+                printf("v%lu = ", random_below(declared));
+                gen_expression(options, function, declared, options->depth);
+                printf(";\n");
+                break;
+        }
+    }
+    indent(1);
+    printf("return ");
+    gen_expression(options, function, declared, options->depth);
+    printf(";\n}\n\n");
+}
+
+static struct option g_options[] = {
+    { "functions", required_argument, NULL, 'f' },
+    { "statements", required_argument, NULL, 's' },
+    { "depth", required_argument, NULL, 'd' },
+    { "identifiers", required_argument, NULL, 'i' },
+    { "strings", required_argument, NULL, 'l' },
+    { "seed", required_argument, NULL, 'r' },
+    { "part", required_argument, NULL, 'p' },
+    { "parts", required_argument, NULL, 'P' },
+    {}
+};
+
+int main(int argc, char **argv) {
+    synth_options_t options = { .functions = 100, .statements = 20, .depth = 3, .identifiers = 8, .strings = 1, .seed = 1, .part = 0, .parts = 1 };
+
+    int c;
+    while((c = getopt_long(argc, argv, "", g_options, NULL)) != -1) {
+        switch(c) {
+            case 'f': options.functions = strtoull(optarg, NULL, 10); break;
+            case 's': options.statements = strtoull(optarg, NULL, 10); break;
+            case 'd': options.depth = strtoull(optarg, NULL, 10); break;
+            case 'i': options.identifiers = strtoull(optarg, NULL, 10); break;
+            case 'l': options.strings = strtoull(optarg, NULL, 10); break;
+            case 'r': options.seed = strtoull(optarg, NULL, 10); break;
+            case 'p': options.part = strtoull(optarg, NULL, 10); break;
+            case 'P': options.parts = strtoull(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: synth [--functions=N] [--statements=N] [--depth=N] [--identifiers=N] [--strings=N] [--seed=N] [--part=K --parts=N]\n");
+                return EXIT_FAILURE;
+        }
+    }
+    if(options.identifiers == 0) options.identifiers = 1;
+    if(options.parts == 0 || options.part >= options.parts) {
+        fprintf(stderr, "invalid part\n");
+        return EXIT_FAILURE;
+    }
+    g_state = (options.seed + options.part) * 0x9E3779B97F4A7C15u + 1;
+
+    printf("// synth --functions=%lu --statements=%lu --depth=%lu --identifiers=%lu --strings=%lu --seed=%lu --part=%lu --parts=%lu\n\n", options.functions, options.statements, options.depth, options.identifiers, options.strings, options.seed, options.part, options.parts);
+    // A part holds a contiguous slice of the functions, calls into earlier parts are resolved across files
+    size_t first = options.functions * options.part / options.parts, last = options.functions * (options.part + 1) / options.parts;
+    for(size_t i = first; i < last; i++) gen_function(&options, i);
+    if(options.part != options.parts - 1) return EXIT_SUCCESS;
+    printf("i32 main() {\n");
+    if(options.functions > 0) printf("    uint result = f%lu(1, 2);\n", options.functions - 1);
+    printf("    return (i32) 0;\n}\n");
+    return EXIT_SUCCESS;
+}
\ No newline at end of file